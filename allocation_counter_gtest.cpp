@@ -0,0 +1,49 @@
+#include "allocation_counter_gtest.h"
+#include <new>
+#include <cstddef>
+#include <stdlib.h>
+
+namespace hps
+{
+
+int& AllocationCounter::Count()
+{
+  static int s_count = 0;
+  return s_count;
+}
+
+bool& AllocationCounter::Enabled()
+{
+  static bool s_enabled = false;
+  return s_enabled;
+}
+
+}
+
+// Count allocations through the global operator new. The standard array
+// and sized forms call these by default.
+void* operator new(std::size_t size)
+{
+  if (hps::AllocationCounter::Enabled())
+  {
+    ++hps::AllocationCounter::Count();
+  }
+  void* ptr = malloc((size > 0) ? size : 1);
+  if (!ptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) throw()
+{
+  free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, std::size_t) throw()
+{
+  free(ptr);
+}
+#endif
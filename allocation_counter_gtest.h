@@ -0,0 +1,22 @@
+#ifndef _HPS_AMBULANCE_ALLOCATION_COUNTER_GTEST_H_
+#define _HPS_AMBULANCE_ALLOCATION_COUNTER_GTEST_H_
+
+namespace hps
+{
+
+/// <summary> Heap allocations counted while counting is on. </summary>
+/// <remarks>
+///   <para> allocation_counter_gtest.cpp replaces the global operator new of
+///     the test binary to count through here. Counting is off unless a test
+///     turns it on.
+///   </para>
+/// </remarks>
+struct AllocationCounter
+{
+  static int& Count();
+  static bool& Enabled();
+};
+
+}
+
+#endif //_HPS_AMBULANCE_ALLOCATION_COUNTER_GTEST_H_
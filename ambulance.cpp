@@ -1,105 +1,630 @@
 #include <cstdio>
 #include <string>
+#include <sstream>
 #include <iostream>
 #include <ctime>
 #include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <omp.h>
 
 #include "ambulance_core.h"
 #include "greedy.h"
-#include "k-means.h"
+#include "local_search.h"
+#include "beam_search.h"
+#include "assignment_search.h"
+#include "site_annealing.h"
+#include "antcolony.h"
+#include "evaluation_cache.h"
+#include "k-means_manhattan.h"
+#include "k-means_mini_batch.h"
 #include "rand_bound.h"
 #include "data_file.h"
+#include "deadline.h"
 using namespace hps;
 
 void PrintUsage()
 {
-  std::cout << "Usage: ./ambulance <filename>" << std::endl;
+  std::cout << "Usage: ./ambulance [--seed <n>] [--time-limit <ms>] "
+               "[--beam-width <w>] [--urgency-weights] [--assignment-search] "
+               "[--anneal-steps <n>] [--ant-squads <n>] <filename>"
+            << std::endl;
+}
+
+/// <summary> The best solution found by one search thread. </summary>
+struct SearchResult
+{
+  SearchResult()
+    : rescued(-1),
+      iteration(std::numeric_limits<int>::max()),
+      hospitals(),
+      actionSequences()
+  {}
+  /// <summary> Order results by rescued count, then by earliest iteration. </summary>
+  inline bool IsBetterThan(const SearchResult& rhs) const
+  {
+    return (rescued > rhs.rescued) ||
+           ((rescued == rhs.rescued) && (iteration < rhs.iteration));
+  }
+  int rescued;
+  int iteration;
+  HospitalList hospitals;
+  ActionSequenceList actionSequences;
+};
+
+/// <summary> Order search results best first. </summary>
+struct SearchResultBetter
+{
+  inline bool operator()(const SearchResult& lhs, const SearchResult& rhs) const
+  {
+    return lhs.IsBetterThan(rhs);
+  }
+};
+
+/// <summary> The best results of a search, one per hospital layout. </summary>
+/// <remarks>
+///   <para> At most maxResults results are kept. When full, a better result
+///     takes the place of the worst. A layout kept already is kept once, at
+///     its better result. The results kept are the same whatever order they
+///     are offered in.
+///   </para>
+/// </remarks>
+class BestResults
+{
+public:
+  explicit BestResults(const int maxResults)
+    : m_maxResults(maxResults),
+      m_results()
+  {
+    assert(maxResults > 0);
+  }
+
+  inline bool Empty() const
+  {
+    return m_results.empty();
+  }
+
+  /// <summary> Check if a result would be kept. </summary>
+  bool Admits(const int rescued, const int iteration,
+              const HospitalList& hospitals) const
+  {
+    SearchResult offer;
+    offer.rescued = rescued;
+    offer.iteration = iteration;
+    const int slot = Slot(hospitals);
+    return (slot < 0) || offer.IsBetterThan(m_results[slot]);
+  }
+
+  /// <summary> Keep a result that Admits(), taking its hospitals and routes. </summary>
+  void Add(const int rescued, const int iteration, HospitalList* hospitals,
+           ActionSequenceList* actionSequences)
+  {
+    assert(Admits(rescued, iteration, *hospitals));
+    int slot = Slot(*hospitals);
+    if (slot < 0)
+    {
+      slot = static_cast<int>(m_results.size());
+      m_results.push_back(SearchResult());
+    }
+    SearchResult& result = m_results[slot];
+    result.rescued = rescued;
+    result.iteration = iteration;
+    result.hospitals.swap(*hospitals);
+    result.actionSequences.Swap(*actionSequences);
+  }
+
+  /// <summary> The results, best first once Sort() is called. </summary>
+  inline std::vector<SearchResult>& Results()
+  {
+    return m_results;
+  }
+
+  inline void Sort()
+  {
+    std::sort(m_results.begin(), m_results.end(), SearchResultBetter());
+  }
+
+private:
+  /// <summary> The result a new one would replace, or -1 to add one. </summary>
+  int Slot(const HospitalList& hospitals) const
+  {
+    const int numResults = static_cast<int>(m_results.size());
+    for (int resultIdx = 0; resultIdx < numResults; ++resultIdx)
+    {
+      if (EvaluationCache::SameLayout(m_results[resultIdx].hospitals,
+                                      hospitals))
+      {
+        return resultIdx;
+      }
+    }
+    if (numResults < m_maxResults)
+    {
+      return -1;
+    }
+    int worst = 0;
+    for (int resultIdx = 1; resultIdx < numResults; ++resultIdx)
+    {
+      if (m_results[worst].IsBetterThan(m_results[resultIdx]))
+      {
+        worst = resultIdx;
+      }
+    }
+    return worst;
+  }
+
+  int m_maxResults;
+  std::vector<SearchResult> m_results;
+};
+
+/// <summary> Weigh victims by how soon they die. </summary>
+/// <remarks>
+///   <para> The victim with the most time to live weighs one, and each unit
+///     less time to live adds one.
+///   </para>
+/// </remarks>
+struct UrgencyWeight
+{
+  explicit UrgencyWeight(const int maxTimeToLive_)
+    : maxTimeToLive(maxTimeToLive_)
+  {}
+
+  inline int operator()(const Victim& victim) const
+  {
+    return (maxTimeToLive + 1) - victim.timeToLive;
+  }
+
+  int maxTimeToLive;
+};
+
+/// <summary> Place hospitals at k-means cluster centers. </summary>
+/// <remarks>
+///   <para> Weights, when given, pull the centers toward heavier points.
+///     Mini-batch clustering of large inputs draws its batches in proportion
+///     to them.
+///   </para>
+/// </remarks>
+template <typename RandomEngine>
+void PlaceKMeansHospitals(const KMeans<Point>::PointList& points,
+                          const std::vector<int>* weights,
+                          const HospitalAmbulanceList& hospitalAmbulances,
+                          const int kMeansIterations,
+                          RandomEngine* rng,
+                          const Deadline& deadline,
+                          KMeans<Point>::PointList* means,
+                          KMeans<Point>::LabelList* labels,
+                          HospitalList* hospitals)
+{
+  assert(rng && means && labels && hospitals);
+  enum { MiniBatchMinPoints = 100000, };
+  enum { MiniBatchSize = 1024, };
+  enum { MiniBatches = 1000, };
+  const int k = static_cast<int>(hospitalAmbulances.size());
+  if (static_cast<int>(points.size()) >= MiniBatchMinPoints)
+  {
+    // Regional scale: cluster from random batches, then label every point
+    // once to size the clusters.
+    MiniBatchKMeans<Point>::SampleSource<RandomEngine> source(points, rng,
+                                                              weights);
+    MiniBatchKMeans<Point>::Run(k, MiniBatchSize, MiniBatches, 0,
+                                ManhattanDistanceFunc(), &source, rng, means,
+                                NULL, &deadline);
+    LloydAssignment<Point, ManhattanDistanceFunc>().Assign(points,
+                                                           ManhattanDistanceFunc(),
+                                                           *means, labels);
+  }
+  else
+  {
+    // Run k-means. Hospitals are reached by Manhattan distance, so take
+    // cluster medians. Bounds skip most distances once clusters settle.
+    typedef KMeans<Point, HamerlyAssignment> KMeansType;
+    const KMeansType::Settings settings(KMeansType::Settings::Seeding_PlusPlus,
+                                        KMeansType::Settings::Center_Median,
+                                        weights);
+    KMeansType::Run(k, kMeansIterations, 1, points,
+                    ManhattanDistanceFunc(), settings,
+                    rng, means, labels, &deadline);
+  }
+  // Sort clusters and hospitals based on size.
+  std::vector<std::pair<size_t, int> > clusterSortList(k);
+  std::vector<std::pair<int, int> > hospitalSortList(k);
+  for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx )
+  {
+    clusterSortList[clusterIdx] = std::make_pair(0, clusterIdx);
+    hospitalSortList[clusterIdx] = std::make_pair(hospitalAmbulances[clusterIdx],
+                                                  clusterIdx);
+  }
+  for (KMeans<Point>::LabelList::const_iterator label = labels->begin();
+       label != labels->end();
+       ++label)
+  {
+    ++clusterSortList[*label].first;
+  }
+  std::sort(clusterSortList.begin(), clusterSortList.end());
+  std::sort(hospitalSortList.begin(), hospitalSortList.end());
+  // reissb -- 20111018 -- Does not seem to affect solution if hospitals are
+  //   assigned in decreasing order.
+  //std::sort(hospitalSortList.begin(), hospitalSortList.end(), std::greater<std::pair<int, int> >());
+  // Make k-means hospitals giving the most abulances to the largest clusters.
+  hospitals->resize(k);
+  for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx )
+  {
+    const std::pair<size_t, int>& clusterRecord = clusterSortList[clusterIdx];
+    const std::pair<int, int>& hospitalRecord = hospitalSortList[clusterIdx];
+    const int hospitalIdx = hospitalRecord.second;
+    Hospital& hospital = (*hospitals)[hospitalIdx];
+    hospital.id = hospitalIdx + 1;
+    hospital.position = (*means)[clusterRecord.second];
+    hospital.ambulances = hospitalRecord.first;
+  }
 }
 
-void SaveVictims(const std::string& filename, const int iterations)
+/// <summary> Search hospital placements and print the best rescue found. </summary>
+/// <remarks>
+///   <para> The search stops after the given number of iterations or when the
+///     deadline expires, whichever comes first. The best solution found so
+///     far is always printed.
+///   </para>
+///   <para> With improveBest zero, every layout is improved by local search
+///     as it is found, which pays off when time is what is bounded.
+///     Otherwise layouts are rescued greedily and local search improves only
+///     the improveBest best of them once the search is done.
+///   </para>
+///   <para> With a beam width, the best hospitals are then rescued again by
+///     beam search, and the better of the two is printed.
+///   </para>
+///   <para> With urgencyWeights, k-means weighs victims by UrgencyWeight.
+///   </para>
+///   <para> With assignmentSearch, every assignment of the best hospital
+///     sites is tried before the beam search.
+///   </para>
+///   <para> With annealSteps, the best hospitals are then moved over the
+///     grid by that many steps of SiteAnnealing.
+///   </para>
+///   <para> With antSquads, an AntColony of at most that many squads then
+///     rescues the best hospitals again.
+///   </para>
+///   <para> The stages after the search share the time to postDeadline. Each
+///     takes an even part of the time left, with its local search, so time
+///     one stage leaves over goes to those after it.
+///   </para>
+/// </remarks>
+void SaveVictims(const std::string& filename, const int iterations,
+                 const unsigned long long seed, const Deadline& deadline,
+                 const int improveBest, const int beamWidth,
+                 const Deadline& postDeadline, const bool urgencyWeights,
+                 const bool assignmentSearch, const int annealSteps,
+                 const int antSquads)
 {
   enum { KMeansIterations = 1000, };
+  enum { MaxCachedLayouts = 1 << 16, };
   assert(iterations > 0);
 
   VictimList victims;
   HospitalAmbulanceList hospitalAmbulances;
   LoadDataFile(filename, &victims, &hospitalAmbulances);
-  HospitalList bestHospitals;
-  ActionSequenceList bestActionSeq;
-  int bestRescued = -1;
-  for (int iteration = 0; iteration < iterations; ++iteration)
+  // Get points.
+  KMeans<Point>::PointList points;
+  points.reserve(victims.size());
+  for (VictimList::const_iterator victim = victims.begin();
+       victim != victims.end();
+       ++victim)
   {
-    HospitalList hospitals;
-    // Get points and k.
-    KMeans<Point>::PointList points;
-    points.reserve(victims.size());
+    points.push_back(victim->position);
+  }
+  // Urgency weights did not beat plain clustering on the sample data over
+  // several seeds, so they are off by default.
+  std::vector<int> weights;
+  if (urgencyWeights && !victims.empty())
+  {
+    int maxTimeToLive = 0;
     for (VictimList::const_iterator victim = victims.begin();
          victim != victims.end();
          ++victim)
     {
-      points.push_back(victim->position);
+      maxTimeToLive = std::max(maxTimeToLive, victim->timeToLive);
     }
-    const int k = static_cast<int>(hospitalAmbulances.size());
-    // Run k-means.
+    weights.resize(victims.size());
+    std::transform(victims.begin(), victims.end(), weights.begin(),
+                   UrgencyWeight(maxTimeToLive));
+  }
+  // Iterations are independent, so spread them over all threads. Each
+  // iteration draws from its own stream of the seed, so the result does not
+  // depend on which thread ran it. Ties between threads go to the earliest
+  // iteration.
+  //
+  // Iterations are handed out from a shared counter rather than an omp for
+  // so that an anytime search can run until its deadline.
+  //
+  // k-means often lands on the same hospitals again, so rescues are cached
+  // by layout. Rescue runs are deterministic up to the deadline, so only
+  // rescues that finished before it are cached, and a cached rescue is the
+  // one the iteration would have found.
+  const int keepResults = std::max(improveBest, 1);
+  std::vector<BestResults> threadBest(omp_get_max_threads(),
+                                      BestResults(keepResults));
+  EvaluationCache cache(std::min(iterations, static_cast<int>(MaxCachedLayouts)),
+                        EvaluationCache::DefaultMaxBytes);
+  int nextIteration = 0;
+#pragma omp parallel
+  {
+    BestResults& best = threadBest[omp_get_thread_num()];
+    // Per-thread scratch space.
     KMeans<Point>::PointList means;
-    KMeans<Point>::ClusterList clusters;
-    KMeans<Point>::Run(k, KMeansIterations, 1, points,
-                       std::ptr_fun(ManhattanDistance),
-                       &means, &clusters);
-    // Sort clusters and hospitals based on size.
-    std::vector<std::pair<size_t, int> > clusterSortList(k);
-    std::vector<std::pair<int, int> > hospitalSortList(k);
-    for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx )
-    {
-      clusterSortList[clusterIdx] = std::make_pair(clusters[clusterIdx].size(),
-                                                   clusterIdx);
-      hospitalSortList[clusterIdx] = std::make_pair(hospitalAmbulances[clusterIdx],
-                                                    clusterIdx);
-    }
-    std::sort(clusterSortList.begin(), clusterSortList.end());
-    std::sort(hospitalSortList.begin(), hospitalSortList.end());
-    // reissb -- 20111018 -- Does not seem to affect solution if hospitals are
-    //   assigned in decreasing order.
-    //std::sort(hospitalSortList.begin(), hospitalSortList.end(), std::greater<std::pair<int, int> >());
-    // Make k-means hospitals giving the most abulances to the largest clusters.
-    hospitals.resize(k);
-    for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx )
-    {
-      const std::pair<size_t, int>& clusterRecord = clusterSortList[clusterIdx];
-      const std::pair<int, int>& hospitalRecord = hospitalSortList[clusterIdx];
-      const int hospitalIdx = hospitalRecord.second;
-      hospitals[hospitalIdx].id = hospitalIdx + 1;
-      hospitals[hospitalIdx].position = means[clusterRecord.second];
-      hospitals[hospitalIdx].ambulances = hospitalRecord.first;
-    }
-    // Rescue people and print output format.
+    KMeans<Point>::LabelList labels;
+    HospitalList hospitals;
+    GreedyRescue::Workspace workspace;
+    LocalSearch localSearch;
     ActionSequenceList actionSequences;
-    int rescued;
-    GreedyRescue::Run(victims, hospitals, &actionSequences, &rescued);
-    if (rescued > bestRescued)
+    for (;;)
+    {
+      // Take the next iteration. A thread sees its iterations in increasing
+      // order. The first iteration always runs so there is a solution.
+      int iteration;
+#pragma omp atomic capture
+      iteration = nextIteration++;
+      if ((iteration >= iterations) || ((iteration > 0) && deadline.Expired()))
+      {
+        break;
+      }
+      RandEngine rng(seed, iteration);
+      PlaceKMeansHospitals(points, weights.empty() ? NULL : &weights,
+                           hospitalAmbulances, KMeansIterations, &rng,
+                           deadline, &means, &labels, &hospitals);
+      // Do not start a rescue past the deadline unless this thread has
+      // nothing to report.
+      if (deadline.Expired() && !best.Empty())
+      {
+        break;
+      }
+      // Rescue people.
+      int rescued = 0;
+      const EvaluationCache::Entry* cached = cache.Find(hospitals);
+      if (cached)
+      {
+        rescued = cached->rescued;
+        if (!best.Admits(rescued, iteration, hospitals))
+        {
+          continue;
+        }
+        actionSequences = cached->actionSequences;
+      }
+      else
+      {
+        GreedyRescue::Run(victims, hospitals, &workspace,
+                          &actionSequences, &rescued);
+        if (0 == improveBest)
+        {
+          rescued = localSearch.Improve(victims, hospitals, deadline,
+                                        &actionSequences);
+        }
+        // Local search cut short by the deadline may not be done.
+        if (!deadline.Expired())
+        {
+          cache.Insert(hospitals, rescued, actionSequences);
+        }
+      }
+      // Keeping the first of equal results keeps the earliest iteration.
+      if (best.Admits(rescued, iteration, hospitals))
+      {
+        best.Add(rescued, iteration, &hospitals, &actionSequences);
+      }
+    }
+  }
+  // Reduce thread results.
+  BestResults searchBest(keepResults);
+  for (std::vector<BestResults>::iterator threadResults = threadBest.begin();
+       threadResults != threadBest.end();
+       ++threadResults)
+  {
+    std::vector<SearchResult>& results = threadResults->Results();
+    for (std::vector<SearchResult>::iterator result = results.begin();
+         result != results.end();
+         ++result)
+    {
+      if (searchBest.Admits(result->rescued, result->iteration,
+                            result->hospitals))
+      {
+        searchBest.Add(result->rescued, result->iteration,
+                       &result->hospitals, &result->actionSequences);
+      }
+    }
+  }
+  searchBest.Sort();
+  std::vector<SearchResult>& searchResults = searchBest.Results();
+  // Improve the best few layouts, each on its own.
+  if (improveBest > 0)
+  {
+    const int numResults = static_cast<int>(searchResults.size());
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int resultIdx = 0; resultIdx < numResults; ++resultIdx)
+    {
+      SearchResult& result = searchResults[resultIdx];
+      LocalSearch localSearch;
+      result.rescued = localSearch.Improve(victims, result.hospitals, deadline,
+                                           &result.actionSequences);
+    }
+    searchBest.Sort();
+  }
+  const SearchResult* best = &searchResults.front();
+  int postStages = (assignmentSearch ? 1 : 0) + ((annealSteps > 0) ? 1 : 0) +
+                   ((antSquads > 0) ? 1 : 0) + ((beamWidth > 0) ? 1 : 0);
+  // Place the best hospitals at their sites by trying every assignment.
+  SearchResult assignmentResult;
+  if (assignmentSearch)
+  {
+    const Deadline stageDeadline = postDeadline.Share(postStages--);
+    assignmentResult.hospitals = best->hospitals;
+    AssignmentSearch search;
+    search.Run(victims, stageDeadline, &assignmentResult.hospitals);
+    int rescued = 0;
+    GreedyRescue::Run(victims, assignmentResult.hospitals,
+                      &assignmentResult.actionSequences, &rescued);
+    LocalSearch localSearch;
+    assignmentResult.rescued = localSearch.Improve(victims,
+                                                   assignmentResult.hospitals,
+                                                   stageDeadline,
+                                                   &assignmentResult.actionSequences);
+    if (assignmentResult.rescued > best->rescued)
+    {
+      assignmentResult.iteration = best->iteration;
+      best = &assignmentResult;
+    }
+  }
+  // Search around the best hospitals.
+  SearchResult annealResult;
+  if (annealSteps > 0)
+  {
+    const Deadline stageDeadline = postDeadline.Share(postStages--);
+    // The winning iteration's stream, jumped clear of the iterations.
+    RandEngine rng(seed, best->iteration);
+    rng.Jump();
+    annealResult.hospitals = best->hospitals;
+    SiteAnnealing annealing;
+    annealing.Run(victims, annealSteps, stageDeadline, &rng,
+                  &annealResult.hospitals);
+    int rescued = 0;
+    GreedyRescue::Run(victims, annealResult.hospitals,
+                      &annealResult.actionSequences, &rescued);
+    LocalSearch localSearch;
+    annealResult.rescued = localSearch.Improve(victims, annealResult.hospitals,
+                                               stageDeadline,
+                                               &annealResult.actionSequences);
+    if (annealResult.rescued > best->rescued)
+    {
+      annealResult.iteration = best->iteration;
+      best = &annealResult;
+    }
+  }
+  // Rescue the best hospitals again with an ant colony.
+  SearchResult antResult;
+  if (antSquads > 0)
+  {
+    const Deadline stageDeadline = postDeadline.Share(postStages--);
+    // Ants draw from streams of their own seed, clear of the iterations.
+    const unsigned long long antSeed = SplitMix64(seed).Next();
+    AntColony::Settings settings;
+    settings.maxSquads = antSquads;
+    AntColony antColony;
+    antColony.Run(victims, best->hospitals, settings, antSeed, stageDeadline,
+                  &antResult.actionSequences);
+    LocalSearch localSearch;
+    antResult.rescued = localSearch.Improve(victims, best->hospitals,
+                                            stageDeadline,
+                                            &antResult.actionSequences);
+    if (antResult.rescued > best->rescued)
     {
-      bestRescued = rescued;
-      bestActionSeq = actionSequences;
-      bestHospitals = hospitals;
-      //std::cout << "New best " << bestRescued << "." << std::endl;
+      antResult.hospitals = best->hospitals;
+      antResult.iteration = best->iteration;
+      best = &antResult;
     }
   }
-  std::cout << ActionSequenceListFormatter(victims, bestHospitals, bestActionSeq)
+  // Trade time for rescues on the best hospitals.
+  SearchResult beamResult;
+  if (beamWidth > 0)
+  {
+    const Deadline stageDeadline = postDeadline.Share(postStages--);
+    BeamSearch beamSearch;
+    beamSearch.Run(victims, best->hospitals, beamWidth, stageDeadline,
+                   &beamResult.actionSequences);
+    LocalSearch localSearch;
+    beamResult.rescued = localSearch.Improve(victims, best->hospitals,
+                                             stageDeadline,
+                                             &beamResult.actionSequences);
+    if (beamResult.rescued > best->rescued)
+    {
+      beamResult.hospitals = best->hospitals;
+      best = &beamResult;
+    }
+  }
+  // Print output format.
+  std::cout << ActionSequenceListFormatter(victims, best->hospitals,
+                                           best->actionSequences)
             << std::endl;
 }
 
 int main(int argc, char* argv[])
 {
-  srand(static_cast<unsigned int>(time(NULL)));
-  if(argc != 2)
+  std::string filename;
+  unsigned long long seed = static_cast<unsigned long long>(time(NULL));
+  int timeLimitMs = 0;
+  int beamWidth = 0;
+  bool urgencyWeights = false;
+  bool assignmentSearch = false;
+  int annealSteps = 0;
+  int antSquads = 0;
+  bool argsValid = true;
+  for (int argIdx = 1; argIdx < argc; ++argIdx)
+  {
+    const std::string arg(argv[argIdx]);
+    if (("--seed" == arg) && ((argIdx + 1) < argc))
+    {
+      std::stringstream ssSeed(argv[++argIdx]);
+      argsValid &= !(ssSeed >> seed).fail();
+    }
+    else if (("--time-limit" == arg) && ((argIdx + 1) < argc))
+    {
+      std::stringstream ssTimeLimit(argv[++argIdx]);
+      argsValid &= !(ssTimeLimit >> timeLimitMs).fail() && (timeLimitMs > 0);
+    }
+    else if (("--beam-width" == arg) && ((argIdx + 1) < argc))
+    {
+      std::stringstream ssBeamWidth(argv[++argIdx]);
+      argsValid &= !(ssBeamWidth >> beamWidth).fail() && (beamWidth > 0);
+    }
+    else if ("--urgency-weights" == arg)
+    {
+      urgencyWeights = true;
+    }
+    else if ("--assignment-search" == arg)
+    {
+      assignmentSearch = true;
+    }
+    else if (("--anneal-steps" == arg) && ((argIdx + 1) < argc))
+    {
+      std::stringstream ssAnnealSteps(argv[++argIdx]);
+      argsValid &= !(ssAnnealSteps >> annealSteps).fail() && (annealSteps > 0);
+    }
+    else if (("--ant-squads" == arg) && ((argIdx + 1) < argc))
+    {
+      std::stringstream ssAntSquads(argv[++argIdx]);
+      argsValid &= !(ssAntSquads >> antSquads).fail() && (antSquads > 0);
+    }
+    else if (filename.empty() && (0 != arg.compare(0, 2, "--")))
+    {
+      filename = arg;
+    }
+    else
+    {
+      argsValid = false;
+    }
+  }
+  if (!argsValid || filename.empty())
   {
     PrintUsage();
   }
   else
   {
     enum { GreedyIterations = 500, };
-    std::string filename(argv[1]);
-    SaveVictims(filename, GreedyIterations);
+    enum { ImprovedLayouts = 8, };
+    // Print the best solution so far when interrupted.
+    InstallInterruptHandlers();
+    if (timeLimitMs > 0)
+    {
+      // Anytime mode: improve until the deadline. The stages after the
+      // search share the second half of the time.
+      const bool postSearch = assignmentSearch || (annealSteps > 0) ||
+                              (antSquads > 0) || (beamWidth > 0);
+      const int searchMs = postSearch ? (timeLimitMs / 2) : timeLimitMs;
+      SaveVictims(filename, std::numeric_limits<int>::max(), seed,
+                  Deadline(searchMs), 0, beamWidth, Deadline(timeLimitMs),
+                  urgencyWeights, assignmentSearch, annealSteps, antSquads);
+    }
+    else
+    {
+      SaveVictims(filename, GreedyIterations, seed, Deadline(),
+                  ImprovedLayouts, beamWidth, Deadline(), urgencyWeights,
+                  assignmentSearch, annealSteps, antSquads);
+    }
   }
   return 0;
 }
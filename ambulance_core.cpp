@@ -1,5 +1,7 @@
 #include "ambulance_core.h"
 #include <fstream>
+#include <limits>
+#include <omp.h>
 
 namespace hps
 {
@@ -38,12 +40,88 @@ void BuildSimVictimGraph(SimVictimList* simVictims, SimVictimGraph* graph)
   }
 }
 
+void SimVictimStore::Assign(const VictimList& victims)
+{
+  const int numVictims = static_cast<int>(victims.size());
+  x.resize(numVictims);
+  y.resize(numVictims);
+  timeToLive.resize(numVictims);
+  status.assign(numVictims,
+                static_cast<unsigned char>(SimVictim::Status_Bleeding));
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    const Victim& victim = victims[victimIdx];
+    x[victimIdx] = victim.position.x;
+    y[victimIdx] = victim.position.y;
+    timeToLive[victimIdx] = victim.timeToLive;
+  }
+}
+
+void NearestHospitalTable::Build(const VictimList& victims,
+                                 const HospitalList& hospitals)
+{
+  // Only split large tables across threads.
+  enum { MinParallelVictims = 4096, };
+  assert(!hospitals.empty());
+  const int numVictims = static_cast<int>(victims.size());
+  const int numHospitals = static_cast<int>(hospitals.size());
+  m_entries.resize(numVictims);
+#pragma omp parallel for schedule(static) if (numVictims >= MinParallelVictims)
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    const Point& position = victims[victimIdx].position;
+    Entry nearest;
+    nearest.hospitalIdx = -1;
+    nearest.distance = std::numeric_limits<int>::max();
+    for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+    {
+      const int distance = ManhattanDistance(position,
+                                             hospitals[hospitalIdx].position);
+      if (distance < nearest.distance)
+      {
+        nearest.hospitalIdx = hospitalIdx;
+        nearest.distance = distance;
+      }
+    }
+    m_entries[victimIdx] = nearest;
+  }
+}
+
 inline std::ostream& operator<<(std::ostream& stream, const Point& point)
 {
   stream << "(" << point.x << "," << point.y << ")";
   return stream;
 }
 
+void ActionSequenceBuilder::Build(ActionSequenceList* actionSequences) const
+{
+  assert(actionSequences);
+  // Counting sort stops by route. Offsets first hold each route's next slot.
+  std::vector<int>& offsets = actionSequences->m_offsets;
+  offsets.assign(m_numRoutes + 1, 0);
+  const int numStops = static_cast<int>(m_nodes.size());
+  for (int stopIdx = 0; stopIdx < numStops; ++stopIdx)
+  {
+    ++offsets[m_routeIdx[stopIdx] + 1];
+  }
+  for (int routeIdx = 0; routeIdx < m_numRoutes; ++routeIdx)
+  {
+    offsets[routeIdx + 1] += offsets[routeIdx];
+  }
+  std::vector<ActionNode>& nodes = actionSequences->m_nodes;
+  nodes.resize(numStops);
+  for (int stopIdx = 0; stopIdx < numStops; ++stopIdx)
+  {
+    nodes[offsets[m_routeIdx[stopIdx]]++] = m_nodes[stopIdx];
+  }
+  // Shift back so that offsets hold each route's first slot.
+  for (int routeIdx = m_numRoutes; routeIdx > 0; --routeIdx)
+  {
+    offsets[routeIdx] = offsets[routeIdx - 1];
+  }
+  offsets[0] = 0;
+}
+
 void FormatActionSequenceList(const VictimList& victims,
                               const HospitalList& hospitals,
                               const ActionSequenceList& actionSequences,
@@ -62,33 +140,32 @@ void FormatActionSequenceList(const VictimList& victims,
   stream << std::endl << "Ambulances";
   // Print action sequences.
   int ambulanceIdx = 0;
-  for (ActionSequenceList::const_iterator seq = actionSequences.begin();
-       seq != actionSequences.end();
-       ++seq)
+  for (int routeIdx = 0; routeIdx < actionSequences.Size(); ++routeIdx)
   {
+    const ActionSequence seq = actionSequences[routeIdx];
     // Did this ambulance do no pickups?
-    if (seq->size() <= 1)
+    if (seq.Size() <= 1)
     {
       continue;
     }
     ++ambulanceIdx;
     stream << std::endl << ambulanceIdx << ":";
-    for (ActionSequence::const_iterator node = seq->begin();
-         node != seq->end();
+    for (ActionSequence::const_iterator node = seq.begin();
+         node != seq.end();
          ++node)
     {
-      switch (node->stopType)
+      switch (node->Type())
       {
       case ActionNode::StopType_Hospital:
         {
-          const Hospital& hospital = hospitals[node->id - 1];
+          const Hospital& hospital = hospitals[node->Id() - 1];
           stream << " H" << hospital.id << hospital.position;
         }
         break;
       case ActionNode::StopType_Victim:
         {
-          const Victim& victim = victims[node->id - 1];
-          stream << " P" << node->id << "(" << victim.position.x << ","
+          const Victim& victim = victims[node->Id() - 1];
+          stream << " P" << node->Id() << "(" << victim.position.x << ","
                  << victim.position.x << "," << victim.timeToLive << ")";
         }
         break;
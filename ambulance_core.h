@@ -5,6 +5,7 @@
 #include <math.h>
 #include <iosfwd>
 #include <cstdlib>
+#include <assert.h>
 
 namespace hps
 {
@@ -79,12 +80,96 @@ typedef std::vector<Hospital> HospitalList;
 typedef std::vector<SimVictim> SimVictimList;
 typedef std::vector<SimAmbulance> SimAmbulanceList;
 
+/// <summary> A run of victims laid out for batch scoring. </summary>
+/// <remarks>
+///   <para> Arrays hold count entries each. victimIdx maps an entry back to
+///     its victim.
+///   </para>
+/// </remarks>
+struct VictimBlock
+{
+  const int* x;
+  const int* y;
+  const int* timeToLive;
+  const int* victimIdx;
+  int count;
+};
+
+/// <summary> Victims during simulation stored as parallel arrays. </summary>
+/// <remarks>
+///   <para> The structure of arrays lets scoring kernels stream coordinates
+///     and times to live for many victims at once. Victim i has id i + 1 and
+///     its status is a SimVictim::Status.
+///   </para>
+/// </remarks>
+struct SimVictimStore
+{
+  /// <summary> Load the victims, all bleeding. </summary>
+  void Assign(const VictimList& victims);
+
+  inline int Size() const
+  {
+    return static_cast<int>(x.size());
+  }
+
+  inline Point Position(const int victimIdx) const
+  {
+    return Point(x[victimIdx], y[victimIdx]);
+  }
+
+  inline bool IsBleeding(const int victimIdx) const
+  {
+    return SimVictim::Status_Bleeding == status[victimIdx];
+  }
+
+  std::vector<int> x;
+  std::vector<int> y;
+  std::vector<int> timeToLive;
+  std::vector<unsigned char> status;
+};
+
 /// <summary> Compute Manhattan distance between points. </summary>
 inline int ManhattanDistance(const Point& a, const Point& b)
 {
   return abs(a.x - b.x) + abs(a.y - b.y);
 }
 
+/// <summary> The hospital nearest to each victim. </summary>
+/// <remarks>
+///   <para> Hospitals do not move during a simulation, so the nearest one to
+///     each victim is found once up front. Entries are indexed by victim id
+///     minus one. Ties go to the hospital earliest in the list. Rebuilding
+///     reuses the table's storage.
+///   </para>
+/// </remarks>
+class NearestHospitalTable
+{
+public:
+  struct Entry
+  {
+    int hospitalIdx;
+    int distance;
+  };
+
+  NearestHospitalTable() : m_entries() {}
+
+  /// <summary> Find the nearest hospital for every victim. </summary>
+  void Build(const VictimList& victims, const HospitalList& hospitals);
+
+  inline const Entry& operator[](const int victimIdx) const
+  {
+    return m_entries[victimIdx];
+  }
+
+  inline int Size() const
+  {
+    return static_cast<int>(m_entries.size());
+  }
+
+private:
+  std::vector<Entry> m_entries;
+};
+
 // reissb -- 20111015 -- The graph functions are not needed after all.
 //   I will leave them in here in case someone else needs them.
 /// <summary> Graph structure to hold simulation victims. </summary>
@@ -97,20 +182,190 @@ enum { VictimUnloadTime = 1, };
 enum { DriveOneBlockTime = 1, };
 
 /// <summary> Ambulance action step. </summary>
-struct ActionNode
+/// <remarks>
+///   <para> Packed into 32 bits. The top bit marks a hospital stop and the
+///     rest hold the 1-based id. A zero id is an undefined stop.
+///   </para>
+/// </remarks>
+class ActionNode
 {
+public:
   enum StopType { StopType_Undef, StopType_Victim, StopType_Hospital, };
-  ActionNode() : id(0), stopType(StopType_Undef) {}
-  ActionNode(const int id_, const StopType stopType_)
-    : id(id_),
-      stopType(stopType_)
+
+  ActionNode() : m_packed(0) {}
+  ActionNode(const int id, const StopType stopType)
+    : m_packed(static_cast<unsigned int>(id) |
+               ((StopType_Hospital == stopType) ? HospitalBit : 0U))
+  {
+    assert(id >= 0);
+    assert((StopType_Undef == stopType) == (0 == id));
+  }
+
+  inline int Id() const
+  {
+    return static_cast<int>(m_packed & ~HospitalBit);
+  }
+
+  inline StopType Type() const
+  {
+    if (0 != (m_packed & HospitalBit))
+    {
+      return StopType_Hospital;
+    }
+    return (0 == m_packed) ? StopType_Undef : StopType_Victim;
+  }
+
+  inline bool operator==(const ActionNode& rhs) const
+  {
+    return m_packed == rhs.m_packed;
+  }
+
+private:
+  static const unsigned int HospitalBit = 0x80000000U;
+
+  unsigned int m_packed;
+};
+
+/// <summary> One ambulance route, viewed in an ActionSequenceList. </summary>
+class ActionSequence
+{
+public:
+  typedef const ActionNode* const_iterator;
+
+  ActionSequence(const ActionNode* first, const ActionNode* last)
+    : m_first(first),
+      m_last(last)
   {}
-  int id;
-  StopType stopType;
+
+  inline const_iterator begin() const
+  {
+    return m_first;
+  }
+
+  inline const_iterator end() const
+  {
+    return m_last;
+  }
+
+  inline int Size() const
+  {
+    return static_cast<int>(m_last - m_first);
+  }
+
+  inline const ActionNode& operator[](const int nodeIdx) const
+  {
+    assert(nodeIdx < Size());
+    return m_first[nodeIdx];
+  }
+
+private:
+  const ActionNode* m_first;
+  const ActionNode* m_last;
+};
+
+/// <summary> The routes of all ambulances stored back to back. </summary>
+/// <remarks>
+///   <para> Stops of route r are nodes [offsets[r], offsets[r + 1]). Copies
+///     cost two flat arrays, and Swap() trades them without copying.
+///   </para>
+///   <para> Routes are appended in order with AddRoute() and AddStop(), or
+///     built out of order by an ActionSequenceBuilder.
+///   </para>
+/// </remarks>
+class ActionSequenceList
+{
+public:
+  ActionSequenceList() : m_offsets(1, 0), m_nodes() {}
+
+  /// <summary> Number of routes. </summary>
+  inline int Size() const
+  {
+    return static_cast<int>(m_offsets.size()) - 1;
+  }
+
+  /// <summary> Number of stops across all routes. </summary>
+  inline int NumStops() const
+  {
+    return static_cast<int>(m_nodes.size());
+  }
+
+  inline ActionSequence operator[](const int routeIdx) const
+  {
+    assert(routeIdx < Size());
+    const ActionNode* nodes = m_nodes.empty() ? NULL : &m_nodes[0];
+    return ActionSequence(nodes + m_offsets[routeIdx],
+                          nodes + m_offsets[routeIdx + 1]);
+  }
+
+  inline void Clear()
+  {
+    m_offsets.resize(1);
+    m_nodes.clear();
+  }
+
+  /// <summary> Start a new, empty route at the end. </summary>
+  inline void AddRoute()
+  {
+    m_offsets.push_back(m_offsets.back());
+  }
+
+  /// <summary> Add a stop to the end of the last route. </summary>
+  inline void AddStop(const ActionNode& node)
+  {
+    assert(Size() > 0);
+    m_nodes.push_back(node);
+    ++m_offsets.back();
+  }
+
+  inline void Swap(ActionSequenceList& other)
+  {
+    m_offsets.swap(other.m_offsets);
+    m_nodes.swap(other.m_nodes);
+  }
+
+private:
+  friend class ActionSequenceBuilder;
+
+  std::vector<int> m_offsets;
+  std::vector<ActionNode> m_nodes;
 };
 
-typedef std::vector<ActionNode> ActionSequence;
-typedef std::vector<ActionSequence> ActionSequenceList;
+/// <summary> Collect stops for many routes in any order. </summary>
+/// <remarks>
+///   <para> Stops are logged as they are made and sorted into routes by
+///     Build(). The stops of each route keep the order they were added in.
+///     Buffers are kept between uses.
+///   </para>
+/// </remarks>
+class ActionSequenceBuilder
+{
+public:
+  ActionSequenceBuilder() : m_numRoutes(0), m_routeIdx(), m_nodes() {}
+
+  /// <summary> Forget all stops and set the number of routes. </summary>
+  inline void Reset(const int numRoutes)
+  {
+    assert(numRoutes >= 0);
+    m_numRoutes = numRoutes;
+    m_routeIdx.clear();
+    m_nodes.clear();
+  }
+
+  inline void AddStop(const int routeIdx, const ActionNode& node)
+  {
+    assert((routeIdx >= 0) && (routeIdx < m_numRoutes));
+    m_routeIdx.push_back(routeIdx);
+    m_nodes.push_back(node);
+  }
+
+  /// <summary> Replace the routes in actionSequences with those logged. </summary>
+  void Build(ActionSequenceList* actionSequences) const;
+
+private:
+  int m_numRoutes;
+  std::vector<int> m_routeIdx;
+  std::vector<ActionNode> m_nodes;
+};
 
 /// <summary> Output action sequence list. </summary>
 void FormatActionSequenceList(const VictimList& victims,
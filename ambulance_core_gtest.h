@@ -65,6 +65,76 @@ TEST(LoadDataFile, ambulance_core)
   }
 }
 
+TEST(NearestHospitalTable, ambulance_core)
+{
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  ASSERT_TRUE(LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances));
+  // Hospitals with a tie at the first two.
+  HospitalList hospitals(3);
+  hospitals[0].position = Point(10, 10);
+  hospitals[1].position = Point(10, 10);
+  hospitals[2].position = Point(60, 40);
+  NearestHospitalTable nearestHospitals;
+  nearestHospitals.Build(victims, hospitals);
+  ASSERT_EQ(static_cast<int>(victims.size()), nearestHospitals.Size());
+  for (int victimIdx = 0; victimIdx < nearestHospitals.Size(); ++victimIdx)
+  {
+    const Point& position = victims[victimIdx].position;
+    const int dist0 = ManhattanDistance(position, hospitals[0].position);
+    const int dist2 = ManhattanDistance(position, hospitals[2].position);
+    const NearestHospitalTable::Entry& entry = nearestHospitals[victimIdx];
+    EXPECT_EQ(std::min(dist0, dist2), entry.distance);
+    EXPECT_EQ((dist2 < dist0) ? 2 : 0, entry.hospitalIdx);
+  }
+}
+
+TEST(ActionSequenceList, ambulance_core)
+{
+  // Packed nodes keep their id and type.
+  const ActionNode hospital(7, ActionNode::StopType_Hospital);
+  const ActionNode victim(0x7FFFFFFF, ActionNode::StopType_Victim);
+  EXPECT_EQ(7, hospital.Id());
+  EXPECT_EQ(ActionNode::StopType_Hospital, hospital.Type());
+  EXPECT_EQ(0x7FFFFFFF, victim.Id());
+  EXPECT_EQ(ActionNode::StopType_Victim, victim.Type());
+  EXPECT_EQ(ActionNode::StopType_Undef, ActionNode().Type());
+  // Stops added out of order land in their routes in order.
+  enum { NumRoutes = 4, };
+  ActionSequenceBuilder builder;
+  builder.Reset(NumRoutes);
+  ActionSequenceList expected;
+  for (int routeIdx = 0; routeIdx < NumRoutes; ++routeIdx)
+  {
+    expected.AddRoute();
+  }
+  const int stops[][2] = { {2, 1}, {0, 2}, {2, 3}, {3, 4}, {0, 5}, {2, 6}, };
+  for (int stopIdx = 0; stopIdx < 6; ++stopIdx)
+  {
+    builder.AddStop(stops[stopIdx][0],
+                    ActionNode(stops[stopIdx][1], ActionNode::StopType_Victim));
+  }
+  ActionSequenceList built;
+  builder.Build(&built);
+  ASSERT_EQ(static_cast<int>(NumRoutes), built.Size());
+  EXPECT_EQ(6, built.NumStops());
+  const int routeIds[NumRoutes][3] = { {2, 5, 0}, {0, 0, 0}, {1, 3, 6}, {4, 0, 0}, };
+  const int routeSizes[NumRoutes] = { 2, 0, 3, 1, };
+  for (int routeIdx = 0; routeIdx < NumRoutes; ++routeIdx)
+  {
+    const ActionSequence route = built[routeIdx];
+    ASSERT_EQ(routeSizes[routeIdx], route.Size());
+    for (int nodeIdx = 0; nodeIdx < route.Size(); ++nodeIdx)
+    {
+      EXPECT_EQ(routeIds[routeIdx][nodeIdx], route[nodeIdx].Id());
+    }
+  }
+  // Swap trades whole lists.
+  expected.Swap(built);
+  EXPECT_EQ(0, built.NumStops());
+  EXPECT_EQ(6, expected.NumStops());
+}
+
 }
 
 #endif //_HPS_AMBULANCE_AMBULANCE_CORE_GTEST_H_
@@ -2,8 +2,17 @@
 #include "rand_bound_gtest.h"
 #include "k-means_gtest.h"
 #include "process_gtest.h"
+#include "score_kernels_gtest.h"
+#include "sim_timeline_gtest.h"
+#include "victim_grid_gtest.h"
 #include "greedy_gtest.h"
+#include "local_search_gtest.h"
+#include "beam_search_gtest.h"
+#include "assignment_search_gtest.h"
+#include "site_annealing_gtest.h"
+#include "evaluation_cache_gtest.h"
 #include "antcolony_gtest.h"
+#include "distance_oracle_gtest.h"
 #include "gtest/gtest.h"
 #ifdef WIN32
 #include <time.h>
@@ -16,6 +25,7 @@
 int main(int argc, char** argv)
 {
   srand(static_cast<unsigned int>(time(NULL)));
+  hps::SeedThreadRandEngine(static_cast<unsigned long long>(time(NULL)));
   testing::InitGoogleTest(&argc, argv);
   testing::FLAGS_gtest_catch_exceptions = false;
   return RUN_ALL_TESTS();
@@ -0,0 +1,289 @@
+#include "antcolony.h"
+#include "victim_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+#include <omp.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+const float AntColony::InitialPheromone = 1.0f;
+const float AntColony::MinPheromone = 0.05f;
+const float AntColony::MaxPheromone = 4.0f;
+const float AntColony::Evaporation = 0.1f;
+const float AntColony::EliteDeposit = 1.0f;
+const float AntColony::Exploitation = 0.98f;
+
+void AntColony::Score::ScoreBlock(const Point& a, const VictimBlock& block,
+                                  float* scores)
+{
+  // Scores of victims off the candidate list start above any on it.
+  static const float OffListScore = 1.0e30f;
+  assert(m_colony && m_rng);
+  const int place = m_colony->PlaceAt(a);
+  // Exploit the best score outright, else explore with random draws.
+  const bool explore = m_rng->Uniform() >= Exploitation;
+  for (int entry = 0; entry < block.count; ++entry)
+  {
+    const int edge = m_colony->CandidateEntry(place, block.victimIdx[entry]);
+    if (edge < 0)
+    {
+      scores[entry] = OffListScore;
+      continue;
+    }
+    const int distance = abs(a.x - block.x[entry]) + abs(a.y - block.y[entry]);
+    const float heuristic = Heuristic(distance, block.timeToLive[entry]);
+    scores[entry] = (heuristic * heuristic) / m_colony->m_pheromone[edge];
+    if (explore)
+    {
+      // Uniform() may be zero, so draw from (0, 1].
+      scores[entry] *= static_cast<float>(-std::log(1.0 - m_rng->Uniform()));
+    }
+  }
+}
+
+AntColony::AntColony()
+: m_victims(NULL),
+  m_hospitals(NULL),
+  m_numPlaces(0),
+  m_numCandidates(0),
+  m_placeAt(),
+  m_hospitalPlace(),
+  m_candidates(),
+  m_pheromone(),
+  m_deltas(),
+  m_workspaces(),
+  m_antSequences(),
+  m_squadBest(),
+  m_squads(0)
+{}
+
+void AntColony::BuildPlaces(const VictimList& victims,
+                            const HospitalList& hospitals)
+{
+  const int numVictims = static_cast<int>(victims.size());
+  const int numHospitals = static_cast<int>(hospitals.size());
+  m_numPlaces = numVictims + numHospitals;
+  // Hospitals claim their places first, then the first victim at a place.
+  m_placeAt.clear();
+  m_placeAt.reserve(m_numPlaces);
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    m_placeAt.push_back(PlaceKey(hospitals[hospitalIdx].position,
+                                 numVictims + hospitalIdx));
+  }
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    m_placeAt.push_back(PlaceKey(victims[victimIdx].position, victimIdx));
+  }
+  std::stable_sort(m_placeAt.begin(), m_placeAt.end());
+  std::vector<PlaceKey>::iterator last = m_placeAt.begin();
+  for (std::vector<PlaceKey>::const_iterator key = m_placeAt.begin() + 1;
+       key != m_placeAt.end();
+       ++key)
+  {
+    if (!(key->position == last->position))
+    {
+      *++last = *key;
+    }
+  }
+  m_placeAt.erase(last + 1, m_placeAt.end());
+  m_hospitalPlace.resize(numHospitals);
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    m_hospitalPlace[hospitalIdx] = PlaceAt(hospitals[hospitalIdx].position);
+  }
+}
+
+void AntColony::BuildCandidates(const VictimList& victims, const int candidates)
+{
+  const int numVictims = static_cast<int>(victims.size());
+  m_numCandidates = std::min(candidates, numVictims);
+  SimVictimStore simVictims;
+  simVictims.Assign(victims);
+  VictimGrid grid;
+  grid.Build(simVictims);
+  m_candidates.resize(static_cast<size_t>(m_numPlaces) * m_numCandidates);
+  std::vector<int> nearest;
+  for (int place = 0; place < m_numPlaces; ++place)
+  {
+    const Point& from = (place < numVictims) ?
+      victims[place].position :
+      (*m_hospitals)[place - numVictims].position;
+    grid.KNearest(from, m_numCandidates, &nearest);
+    assert(static_cast<int>(nearest.size()) == m_numCandidates);
+    // Rows are in victim order for CandidateEntry().
+    int* row = &m_candidates[static_cast<size_t>(place) * m_numCandidates];
+    std::copy(nearest.begin(), nearest.end(), row);
+    std::sort(row, row + m_numCandidates);
+  }
+}
+
+template <typename WeightType>
+void AntColony::Deposit(const ActionSequenceList& actionSequences,
+                        const WeightType amount,
+                        std::vector<WeightType>* edges) const
+{
+  const VictimList& victims = *m_victims;
+  for (int routeIdx = 0; routeIdx < actionSequences.Size(); ++routeIdx)
+  {
+    const ActionSequence route = actionSequences[routeIdx];
+    int from = -1;
+    for (ActionSequence::const_iterator stop = route.begin();
+         stop != route.end();
+         ++stop)
+    {
+      if (ActionNode::StopType_Hospital == stop->Type())
+      {
+        // Routes name hospitals by 1-based id, which is their index + 1.
+        from = m_hospitalPlace[stop->Id() - 1];
+      }
+      else
+      {
+        const int victimIdx = stop->Id() - 1;
+        assert(from >= 0);
+        const int edge = CandidateEntry(from, victimIdx);
+        if (edge >= 0)
+        {
+          (*edges)[edge] += amount;
+        }
+        from = PlaceAt(victims[victimIdx].position);
+      }
+    }
+  }
+}
+
+void AntColony::UpdatePheromone(const int squadSize, const int bestRescued,
+                                const ActionSequenceList& bestSequences)
+{
+  const int numEdges = static_cast<int>(m_pheromone.size());
+  const int numThreads = static_cast<int>(m_deltas.size());
+  // A route as good as the best so far, taken by every ant, lays down one.
+  const float squadScale = Evaporation /
+    static_cast<float>(squadSize * std::max(bestRescued, 1));
+#pragma omp parallel for schedule(static)
+  for (int edge = 0; edge < numEdges; ++edge)
+  {
+    int delta = 0;
+    for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+    {
+      int& threadDelta = m_deltas[threadIdx][edge];
+      delta += threadDelta;
+      threadDelta = 0;
+    }
+    m_pheromone[edge] = ((1.0f - Evaporation) * m_pheromone[edge]) +
+                        (squadScale * static_cast<float>(delta));
+  }
+  Deposit(bestSequences, Evaporation * EliteDeposit, &m_pheromone);
+  for (int edge = 0; edge < numEdges; ++edge)
+  {
+    m_pheromone[edge] = std::min(std::max(m_pheromone[edge], MinPheromone),
+                                 MaxPheromone);
+  }
+}
+
+int AntColony::Run(const VictimList& victims,
+                   const HospitalList& hospitals,
+                   const Settings& settings,
+                   const unsigned long long seed,
+                   const Deadline& deadline,
+                   ActionSequenceList* actionSequences)
+{
+  assert(actionSequences);
+  assert((settings.squadSize > 0) && (settings.candidates > 0));
+  m_squads = 0;
+  actionSequences->Clear();
+  if (victims.empty() || hospitals.empty())
+  {
+    return 0;
+  }
+  m_victims = &victims;
+  m_hospitals = &hospitals;
+  BuildPlaces(victims, hospitals);
+  BuildCandidates(victims, settings.candidates);
+  m_pheromone.assign(m_candidates.size(), InitialPheromone);
+  const int numThreads = omp_get_max_threads();
+  m_deltas.resize(numThreads);
+  for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+  {
+    m_deltas[threadIdx].assign(m_candidates.size(), 0);
+  }
+  m_workspaces.resize(numThreads);
+  m_antSequences.resize(numThreads);
+  m_squadBest.resize(numThreads);
+  const int squadSize = settings.squadSize;
+  int bestRescued = -1;
+  int stalled = 0;
+  while ((m_squads < settings.maxSquads) && (stalled < settings.stallSquads) &&
+         ((0 == m_squads) || !deadline.Expired()))
+  {
+    for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+    {
+      m_squadBest[threadIdx].rescued = -1;
+    }
+    const long long firstAnt = static_cast<long long>(m_squads) * squadSize;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int antIdx = 0; antIdx < squadSize; ++antIdx)
+    {
+      // Ants past the deadline are skipped, though the first always runs.
+      if (((m_squads > 0) || (antIdx > 0)) && deadline.Expired())
+      {
+        continue;
+      }
+      const int threadIdx = omp_get_thread_num();
+      RandEngine rng(seed, static_cast<unsigned long long>(firstAnt + antIdx));
+      Score score(this, &rng);
+      ActionSequenceList& antSequences = m_antSequences[threadIdx];
+      int rescued = 0;
+      detail::GreedyBase::Run(victims, hospitals, &score,
+                              &m_workspaces[threadIdx], &antSequences,
+                              &rescued);
+      Deposit(antSequences, rescued, &m_deltas[threadIdx]);
+      // Ants come in increasing order per thread, so keep the first.
+      AntResult& squadBest = m_squadBest[threadIdx];
+      if (rescued > squadBest.rescued)
+      {
+        squadBest.rescued = rescued;
+        squadBest.antIdx = antIdx;
+        squadBest.actionSequences.Swap(antSequences);
+      }
+    }
+    // The best of the squad is the earliest ant with the most rescued.
+    const AntResult* squadBest = NULL;
+    for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+    {
+      const AntResult& result = m_squadBest[threadIdx];
+      if ((result.rescued >= 0) &&
+          (!squadBest || (result.rescued > squadBest->rescued) ||
+           ((result.rescued == squadBest->rescued) &&
+            (result.antIdx < squadBest->antIdx))))
+      {
+        squadBest = &result;
+      }
+    }
+    if (!squadBest)
+    {
+      // The deadline expired before any ant of the squad ran.
+      break;
+    }
+    ++m_squads;
+    if (squadBest->rescued > bestRescued)
+    {
+      bestRescued = squadBest->rescued;
+      *actionSequences = squadBest->actionSequences;
+      stalled = 0;
+    }
+    else
+    {
+      ++stalled;
+    }
+    UpdatePheromone(squadSize, bestRescued, *actionSequences);
+  }
+  return bestRescued;
+}
+
+}
+}
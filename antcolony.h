@@ -1,92 +1,243 @@
-#ifndef _ANT_COLONY_H_
-#define _ANT_COLONY_H_
-
+#ifndef _HPS_AMBULANCE_ANT_COLONY_H_
+#define _HPS_AMBULANCE_ANT_COLONY_H_
+#include "ambulance_core.h"
+#include "greedy_base.h"
+#include "rand_bound.h"
+#include "deadline.h"
 #include <vector>
-//#include <omp.h>
-
-template<typename FitnessType, typename PathType>
-struct AntColony {
-  AntColony()
-  : maxIterations(1000),
-    iterations(0),
-    antSquadSize(4),
-    bestPath(NULL),
-    bestPathReward(10),
-    evaporationAmount(1),
-    explorationPreference(3)
-  {};
-
-  AntColony(int maxIterations_, int squadSize)
-  : maxIterations(maxIterations_),
-    iterations(0),
-    antSquadSize(squadSize),
-    bestPath(NULL)
-  {};
-  
-  ~AntColony()
-  {};
-
-  PathType runAnt(){
-    //Run an ant on the graph and return the ant's path for examination.
-  }
-  void adjustPheremones(PathType path, FitnessType amount)
+#include <algorithm>
+#include <assert.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Dispatch ambulances by ant colony optimization. </summary>
+/// <remarks>
+///   <para> Each ant is a run of GreedyBase with a random score. From a place
+///     p the score of victim v is
+///       E * h(p, v)^2 / tau(p, v)
+///     where E is a unit exponential draw, h is the GreedyRescue score
+///     (distance times time to live squared) and tau is the pheromone on the
+///     edge. The least score of a set of such draws falls on v with chance in
+///     proportion to tau / h^2, so taking the first feasible pickup in score
+///     order is the usual random proportional rule of ant systems. As in ant
+///     colony systems, a pickup skips the draw with chance Exploitation and
+///     takes the least h^2 / tau. Ants that draw at every pickup fall far
+///     short of GreedyRescue.
+///   </para>
+///   <para> Places have a row for every victim and hospital. Ambulances are
+///     matched to rows by where they stand, so victims at one place share a
+///     row. Each row has a candidate list of its nearest victims, and
+///     pheromone is kept only on the edges to them, so memory grows with
+///     places times candidates. Victims off the list score above all on it,
+///     so they are taken only when no candidate may be saved, and their
+///     edges carry no pheromone.
+///   </para>
+///   <para> Ants run in squads. Ants of a squad run in parallel and each
+///     thread adds the rescued count of its ants to the edges they took in
+///     its own integer deltas. After the squad the deltas are summed,
+///     pheromone evaporates, and the squad deposit plus an elite deposit on
+///     the best routes so far are added within [MinPheromone, MaxPheromone].
+///     Integer deltas sum the same in any order, and each ant draws from its
+///     own stream of the seed, so the result does not depend on the number
+///     of threads.
+///   </para>
+///   <para> The colony has converged when the best count has not risen for
+///     stallSquads squads in a row.
+///   </para>
+/// </remarks>
+class AntColony
+{
+public:
+  enum { DefaultSquadSize = 8, };
+  enum { DefaultMaxSquads = 200, };
+  enum { DefaultStallSquads = 25, };
+  enum { DefaultCandidates = 64, };
+  static const float InitialPheromone;
+  static const float MinPheromone;
+  static const float MaxPheromone;
+  static const float Evaporation;
+  static const float EliteDeposit;
+  static const float Exploitation;
+
+  struct Settings
   {
-    // Adjust the pheremone count on every edge in the path.
-    // Should be parallelizable
-  }
+    Settings()
+      : squadSize(DefaultSquadSize),
+        maxSquads(DefaultMaxSquads),
+        stallSquads(DefaultStallSquads),
+        candidates(DefaultCandidates)
+    {}
+
+    int squadSize;
+    int maxSquads;
+    int stallSquads;
+    int candidates;
+  };
+
+  /// <summary> Pheromone-aware random score for GreedyBase. </summary>
+  /// <remarks>
+  ///   <para> ScoreBlock() draws new scores on every call and looks up
+  ///     pheromone by the victim indices of the block. A lone Victim carries
+  ///     no index, so there is no operator() and the score is ranked only.
+  ///   </para>
+  /// </remarks>
+  class Score
+  {
+  public:
+    typedef float result_type;
+    enum { HasLowerBound = 0, };
+
+    Score() : m_colony(NULL), m_rng(NULL) {}
+    Score(const AntColony* colony, RandEngine* rng)
+      : m_colony(colony),
+        m_rng(rng)
+    {}
+
+    void ScoreBlock(const Point& a, const VictimBlock& block, float* scores);
+
+    /// <summary> The GreedyRescue score, kept above zero. </summary>
+    inline static float Heuristic(const int distance, const int timeToLive)
+    {
+      const float timeMult = static_cast<float>(timeToLive);
+      return (static_cast<float>(distance) * timeMult * timeMult) + 1.0f;
+    }
+
+  private:
+    const AntColony* m_colony;
+    RandEngine* m_rng;
+  };
+
+  typedef GreedyWorkspace<Score> Workspace;
+
+  AntColony();
 
-  void decreasePheremones(PathType path)
+  /// <summary> Rescue victims with the best ant of the colony. </summary>
+  /// <remarks>
+  ///   <para> Squads run until maxSquads, until the colony converges or
+  ///     until the deadline expires. Ants that would start past the deadline
+  ///     are skipped, but the first ant always runs.
+  ///   </para>
+  /// </remarks>
+  /// <returns> The number of victims rescued. </returns>
+  int Run(const VictimList& victims,
+          const HospitalList& hospitals,
+          const Settings& settings,
+          const unsigned long long seed,
+          const Deadline& deadline,
+          ActionSequenceList* actionSequences);
+
+  /// <summary> The number of squads run by the last call. </summary>
+  inline int Squads() const
   {
-    adjustPheremones(path, explorationPreference);
+    return m_squads;
   }
-  void increasePheremones(PathType path)
+
+  /// <summary> The length of the candidate lists of the last call. </summary>
+  inline int Candidates() const
   {
-    adjustPheremones(path, bestPathReward);
+    return m_numCandidates;
   }
 
-  void evaporatePheremones(){
-    // reduce the pheremone count on every edge by evaporationAmount
-    // should be parallelizable
+  /// <summary> The pheromone left by the last call. </summary>
+  /// <remarks>
+  ///   <para> Row p holds Candidates() entries, one for each candidate of
+  ///     place p in increasing victim order.
+  ///   </para>
+  /// </remarks>
+  inline const std::vector<float>& Pheromone() const
+  {
+    return m_pheromone;
   }
 
-  void iterate(){
-    PathType currentAnt;
-    PathType localBestPath;
-    FitnessType localBestFitness = 0;
+  /// <summary> The row of the place a point is at. </summary>
+  inline int PlaceAt(const Point& point) const
+  {
+    const PlaceKey key(point, -1);
+    const std::vector<PlaceKey>::const_iterator found =
+      std::lower_bound(m_placeAt.begin(), m_placeAt.end(), key);
+    assert((found != m_placeAt.end()) && (found->position == point));
+    return found->place;
+  }
 
-    for(int i = 0; i < antSquadSize; i++)
+  /// <summary> The entry of the edge from place to victimIdx, or -1 if the
+  ///   victim is not a candidate of the place.
+  /// </summary>
+  inline int CandidateEntry(const int place, const int victimIdx) const
+  {
+    const int* row = &m_candidates[static_cast<size_t>(place) *
+                                   m_numCandidates];
+    const int* found = std::lower_bound(row, row + m_numCandidates, victimIdx);
+    if ((found == (row + m_numCandidates)) || (*found != victimIdx))
     {
-      currentAnt = runAnt();
-      reducePheremones(currentAnt);
-      if(currentAnt.fitness >= localBestFitness)
-      {
-        localBestPath = currentAnt;
-      }
+      return -1;
     }
-    increasePheremones(localBestPath);
-    evaporatePheremones();
+    return static_cast<int>((static_cast<size_t>(place) * m_numCandidates) +
+                            (found - row));
   }
 
-  void run(){
-    FitnessType previousBest;
-    while(iterations < maxIterations)
+private:
+  /// <summary> The best ant of a thread in the current squad. </summary>
+  struct AntResult
+  {
+    int rescued;
+    int antIdx;
+    ActionSequenceList actionSequences;
+  };
+
+  /// <summary> A place row by position, ordered by y then x. </summary>
+  struct PlaceKey
+  {
+    PlaceKey(const Point& position_, const int place_)
+      : position(position_),
+        place(place_)
+    {}
+
+    inline bool operator<(const PlaceKey& rhs) const
     {
-      previousBest = bestPath.fitness;
-      iterate();
-      if(previousBest == bestPath.fitness)
-      {
-        return; // We have converged.
-      }
+      return (position.y < rhs.position.y) ||
+             ((position.y == rhs.position.y) && (position.x < rhs.position.x));
     }
-  }
 
-  PathType bestPath;
-  int maxIterations;
-  int iterations;
-  int antSquadSize; // The number of ants that are run before picking the best of them and increasing the pheremone count on that path.
-  FitnessType explorationPreference; // The amount to reduce the pheremones on an edge after it has been traversed in order to prioritize exploration.
-  FitnessType bestPathReward; // The amount to increase the pheremones on a path in order to prefer previous best paths.
-  FitnessType evaporationAmount; //The amount to reduce every edge's pheremone count by during evaporation.
+    Point position;
+    int place;
+  };
+
+  /// <summary> Give each victim and hospital place a row. </summary>
+  void BuildPlaces(const VictimList& victims, const HospitalList& hospitals);
+
+  /// <summary> List the nearest victims of every row. </summary>
+  void BuildCandidates(const VictimList& victims, const int candidates);
+
+  /// <summary> Add amount to every edge of the routes. </summary>
+  template <typename WeightType>
+  void Deposit(const ActionSequenceList& actionSequences,
+               const WeightType amount,
+               std::vector<WeightType>* edges) const;
+
+  /// <summary> Evaporate and lay down the squad's pheromone. </summary>
+  void UpdatePheromone(const int squadSize, const int bestRescued,
+                       const ActionSequenceList& bestSequences);
+
+  const VictimList* m_victims;
+  const HospitalList* m_hospitals;
+  int m_numPlaces;
+  int m_numCandidates;
+  std::vector<PlaceKey> m_placeAt;
+  std::vector<int> m_hospitalPlace;
+  std::vector<int> m_candidates;
+  std::vector<float> m_pheromone;
+  std::vector<std::vector<int> > m_deltas;
+  std::vector<Workspace> m_workspaces;
+  std::vector<ActionSequenceList> m_antSequences;
+  std::vector<AntResult> m_squadBest;
+  int m_squads;
 };
 
-#endif //_ANT_COLONY_H_
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_ANT_COLONY_H_
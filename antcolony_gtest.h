@@ -2,6 +2,75 @@
 #define _ANT_COLONY_GTEST_H
 
 #include "antcolony.h"
+#include "greedy.h"
+#include "validate_gtest.h"
+#include "data_file.h"
+#include "gtest/gtest.h"
+#include <omp.h>
 
+namespace _hps_ambulance_antcolony_gtest_h_
+{
+using namespace hps;
+
+TEST(RandomHospitals, antcolony)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { Seed = 17, };
+
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  RandEngine rng(16ULL);
+  HospitalList hospitals;
+  RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &hospitals);
+  AntColony::Settings settings;
+  settings.maxSquads = 6;
+  AntColony antColony;
+  ActionSequenceList actionSequences;
+  const int rescued = antColony.Run(victims, hospitals, settings, Seed,
+                                    Deadline(), &actionSequences);
+  int numRescued;
+  ASSERT_TRUE(ValidateAmbulance(victims, hospitals, actionSequences,
+                                &numRescued));
+  EXPECT_EQ(rescued, numRescued);
+  EXPECT_EQ(settings.maxSquads, antColony.Squads());
+  // Pheromone stays within its bounds.
+  // Only the edges to candidates carry it.
+  const std::vector<float>& pheromone = antColony.Pheromone();
+  EXPECT_EQ(static_cast<int>(settings.candidates), antColony.Candidates());
+  EXPECT_EQ((victims.size() + hospitals.size()) * settings.candidates,
+            pheromone.size());
+  for (size_t edgeIdx = 0; edgeIdx < pheromone.size(); ++edgeIdx)
+  {
+    EXPECT_LE(AntColony::MinPheromone, pheromone[edgeIdx]);
+    EXPECT_GE(AntColony::MaxPheromone, pheromone[edgeIdx]);
+  }
+  // Every place lists its own victim.
+  for (int victimIdx = 0; victimIdx < static_cast<int>(victims.size());
+       ++victimIdx)
+  {
+    const int place = antColony.PlaceAt(victims[victimIdx].position);
+    EXPECT_LE(0, antColony.CandidateEntry(place, victimIdx));
+  }
+  // The colony keeps the best of its squads.
+  settings.maxSquads = 1;
+  ActionSequenceList firstSequences;
+  const int firstRescued = AntColonyRescue::Run(victims, hospitals, settings,
+                                                Seed, Deadline(),
+                                                &firstSequences);
+  EXPECT_GE(rescued, firstRescued);
+  // The result must not depend on the number of threads.
+  settings.maxSquads = 6;
+  const int numThreads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  ActionSequenceList serialSequences;
+  const int serialRescued = antColony.Run(victims, hospitals, settings, Seed,
+                                          Deadline(), &serialSequences);
+  omp_set_num_threads(numThreads);
+  EXPECT_EQ(rescued, serialRescued);
+  ExpectSameActionSequences(actionSequences, serialSequences);
+}
+
+}
 
 #endif //_ANT_COLONY_GTEST_H
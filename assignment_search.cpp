@@ -0,0 +1,132 @@
+#include "assignment_search.h"
+#include "combination.h"
+#include <algorithm>
+#include <utility>
+#include <assert.h>
+#include <omp.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+AssignmentSearch::AssignmentSearch()
+: m_sites(),
+  m_ambulances(),
+  m_workspaces(),
+  m_actionSequences(),
+  m_hospitals()
+{}
+
+bool AssignmentSearch::IsCanonical(const unsigned char* permutation) const
+{
+  const int numHospitals = static_cast<int>(m_ambulances.size());
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    for (int otherIdx = hospitalIdx + 1; otherIdx < numHospitals; ++otherIdx)
+    {
+      if ((m_ambulances[hospitalIdx] == m_ambulances[otherIdx]) &&
+          (permutation[hospitalIdx] > permutation[otherIdx]))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void AssignmentSearch::PlaceHospitals(const unsigned char* permutation,
+                                      HospitalList* hospitals) const
+{
+  const int numHospitals = static_cast<int>(hospitals->size());
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    (*hospitals)[hospitalIdx].position = m_sites[permutation[hospitalIdx]];
+  }
+}
+
+int AssignmentSearch::Run(const VictimList& victims,
+                          const Deadline& deadline,
+                          HospitalList* hospitals)
+{
+  assert(hospitals);
+  const int numThreads = omp_get_max_threads();
+  m_workspaces.resize(numThreads);
+  m_actionSequences.resize(numThreads);
+  m_hospitals.assign(numThreads, *hospitals);
+  // Score the given assignment first. Orders must beat it to replace it.
+  int bestRescued = 0;
+  GreedyRescue::Run(victims, *hospitals, &m_workspaces.front(),
+                    &m_actionSequences.front(), &bestRescued);
+  const int numHospitals = static_cast<int>(hospitals->size());
+  if ((numHospitals < 2) || (numHospitals > MaxHospitals))
+  {
+    return bestRescued;
+  }
+  m_sites.resize(numHospitals);
+  m_ambulances.resize(numHospitals);
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    m_sites[hospitalIdx] = (*hospitals)[hospitalIdx].position;
+    m_ambulances[hospitalIdx] = (*hospitals)[hospitalIdx].ambulances;
+  }
+  const PermutationTable permutations(numHospitals);
+  const long long numPermutations =
+    static_cast<long long>(permutations.GetPermutationCount());
+  // Best order of each thread.
+  std::vector<std::pair<int, long long> > threadBest(
+    numThreads, std::make_pair(bestRescued, -1LL));
+  int sharedBest = bestRescued;
+#pragma omp parallel
+  {
+    const int threadIdx = omp_get_thread_num();
+    GreedyRescue::Workspace* workspace = &m_workspaces[threadIdx];
+    ActionSequenceList* actionSequences = &m_actionSequences[threadIdx];
+    HospitalList* candidate = &m_hospitals[threadIdx];
+    std::pair<int, long long>& best = threadBest[threadIdx];
+#pragma omp for schedule(dynamic, 4)
+    for (long long m = 0; m < numPermutations; ++m)
+    {
+      const unsigned char* permutation = permutations[m];
+      if (!IsCanonical(permutation) || deadline.Expired())
+      {
+        continue;
+      }
+      PlaceHospitals(permutation, candidate);
+      int bound;
+#pragma omp critical(AssignmentSearchBest)
+      bound = sharedBest;
+      // Abandon runs that cannot tie the best so far.
+      int rescued = 0;
+      GreedyRescue::Run(victims, *candidate, workspace, actionSequences,
+                        &rescued, bound - 1);
+      // Orders come in increasing order per thread, so keep the first.
+      if (rescued > best.first)
+      {
+        best = std::make_pair(rescued, m);
+#pragma omp critical(AssignmentSearchBest)
+        sharedBest = std::max(sharedBest, rescued);
+      }
+    }
+  }
+  // Reduce thread results.
+  std::pair<int, long long> best = std::make_pair(bestRescued, -1LL);
+  for (std::vector<std::pair<int, long long> >::const_iterator result = threadBest.begin();
+       result != threadBest.end();
+       ++result)
+  {
+    if ((result->first > best.first) ||
+        ((result->first == best.first) && (result->second < best.second)))
+    {
+      best = *result;
+    }
+  }
+  if (best.second >= 0)
+  {
+    PlaceHospitals(permutations[best.second], hospitals);
+  }
+  return best.first;
+}
+
+}
+}
@@ -0,0 +1,67 @@
+#ifndef _HPS_AMBULANCE_ASSIGNMENT_SEARCH_H_
+#define _HPS_AMBULANCE_ASSIGNMENT_SEARCH_H_
+#include "ambulance_core.h"
+#include "greedy.h"
+#include "deadline.h"
+#include <vector>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Place hospitals at given sites by trying every assignment. </summary>
+/// <remarks>
+///   <para> Each hospital keeps its id and its ambulances, and the sites are
+///     given out to the hospitals in every order. There are at most
+///     MaxHospitals! orders, each looked up by index from a PermutationTable
+///     so threads may take any part of the index space. Orders that only
+///     swap the sites of hospitals with as many ambulances are skipped.
+///   </para>
+///   <para> Each order is scored by GreedyRescue with its own workspace per
+///     thread. A run is abandoned once it cannot reach the best count found
+///     by any thread so far. Runs that may tie always finish, so the result
+///     does not depend on the number of threads: the most rescued wins, then
+///     the given assignment, then the earliest order.
+///   </para>
+/// </remarks>
+class AssignmentSearch
+{
+public:
+  enum { MaxHospitals = 8, };
+
+  AssignmentSearch();
+
+  /// <summary> Move the hospitals to their best assignment of sites. </summary>
+  /// <remarks>
+  ///   <para> The sites are the positions the hospitals start at. Orders
+  ///     left when the deadline expires are skipped.
+  ///   </para>
+  /// </remarks>
+  /// <returns> The number of victims rescued greedily. </returns>
+  int Run(const VictimList& victims,
+          const Deadline& deadline,
+          HospitalList* hospitals);
+
+private:
+  /// <summary> Check that hospitals with as many ambulances take sites in
+  ///   increasing order.
+  /// </summary>
+  bool IsCanonical(const unsigned char* permutation) const;
+
+  /// <summary> Place each hospital at the site the permutation gives it. </summary>
+  void PlaceHospitals(const unsigned char* permutation,
+                      HospitalList* hospitals) const;
+
+  std::vector<Point> m_sites;
+  std::vector<int> m_ambulances;
+  std::vector<GreedyRescue::Workspace> m_workspaces;
+  std::vector<ActionSequenceList> m_actionSequences;
+  std::vector<HospitalList> m_hospitals;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_ASSIGNMENT_SEARCH_H_
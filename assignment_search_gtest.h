@@ -0,0 +1,124 @@
+#ifndef _HPS_AMBULANCE_ASSIGNMENT_SEARCH_GTEST_H_
+#define _HPS_AMBULANCE_ASSIGNMENT_SEARCH_GTEST_H_
+#include "assignment_search.h"
+#include "data_file.h"
+#include "validate_gtest.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <omp.h>
+
+namespace _hps_ambulance_assignment_search_gtest_h_
+{
+using namespace hps;
+
+TEST(AbandonGreedy, assignment_search)
+{
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  const int numHospitals = static_cast<int>(hospitalAmbulances.size());
+  HospitalList hospitals(numHospitals);
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    hospitals[hospitalIdx].id = hospitalIdx + 1;
+    hospitals[hospitalIdx].position = Point(20 * (hospitalIdx + 1),
+                                            20 * (hospitalIdx + 1));
+    hospitals[hospitalIdx].ambulances = hospitalAmbulances[hospitalIdx];
+  }
+  GreedyRescue::Workspace workspace;
+  ActionSequenceList actionSequences;
+  int rescued = 0;
+  GreedyRescue::Run(victims, hospitals, &workspace, &actionSequences, &rescued);
+  // A run that may still reach the bound finishes as usual.
+  int boundRescued = 0;
+  GreedyRescue::Run(victims, hospitals, &workspace, &actionSequences,
+                    &boundRescued, rescued - 1);
+  EXPECT_EQ(rescued, boundRescued);
+  // A run that cannot beat the bound stops at or below it.
+  int abandonedRescued = 0;
+  GreedyRescue::Run(victims, hospitals, &workspace, &actionSequences,
+                    &abandonedRescued, rescued);
+  EXPECT_LE(abandonedRescued, rescued);
+}
+
+TEST(RandomHospitals, assignment_search)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { NumTrials = 2, };
+
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  const int numHospitals = static_cast<int>(hospitalAmbulances.size());
+  ASSERT_LE(numHospitals, static_cast<int>(AssignmentSearch::MaxHospitals));
+  RandEngine rng(12ULL);
+  AssignmentSearch assignmentSearch;
+  GreedyRescue::Workspace workspace;
+  ActionSequenceList actionSequences;
+  for (int trial = 0; trial < NumTrials; ++trial)
+  {
+    HospitalList hospitals;
+    RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &hospitals);
+    // Try every order of the sites in full.
+    int mostRescued = 0;
+    HospitalList candidate = hospitals;
+    std::vector<int> siteIdx(numHospitals);
+    for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+    {
+      siteIdx[hospitalIdx] = hospitalIdx;
+    }
+    do
+    {
+      for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+      {
+        candidate[hospitalIdx].position = hospitals[siteIdx[hospitalIdx]].position;
+      }
+      int rescued = 0;
+      GreedyRescue::Run(victims, candidate, &workspace, &actionSequences,
+                        &rescued);
+      mostRescued = std::max(mostRescued, rescued);
+    } while (std::next_permutation(siteIdx.begin(), siteIdx.end()));
+    HospitalList best = hospitals;
+    const int rescued = assignmentSearch.Run(victims, Deadline(), &best);
+    EXPECT_EQ(mostRescued, rescued);
+    // Hospitals keep their ambulances and take each site once.
+    std::vector<int> bestSites;
+    for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+    {
+      EXPECT_EQ(hospitals[hospitalIdx].id, best[hospitalIdx].id);
+      EXPECT_EQ(hospitals[hospitalIdx].ambulances, best[hospitalIdx].ambulances);
+      for (int otherIdx = 0; otherIdx < numHospitals; ++otherIdx)
+      {
+        if ((hospitals[otherIdx].position.x == best[hospitalIdx].position.x) &&
+            (hospitals[otherIdx].position.y == best[hospitalIdx].position.y))
+        {
+          bestSites.push_back(otherIdx);
+          break;
+        }
+      }
+    }
+    std::sort(bestSites.begin(), bestSites.end());
+    EXPECT_TRUE(siteIdx == bestSites);
+    int bestRescued = 0;
+    GreedyRescue::Run(victims, best, &workspace, &actionSequences,
+                      &bestRescued);
+    EXPECT_EQ(rescued, bestRescued);
+    // The result must not depend on the number of threads.
+    const int numThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    HospitalList serialBest = hospitals;
+    const int serialRescued = assignmentSearch.Run(victims, Deadline(),
+                                                   &serialBest);
+    omp_set_num_threads(numThreads);
+    EXPECT_EQ(rescued, serialRescued);
+    for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+    {
+      EXPECT_EQ(best[hospitalIdx].position.x, serialBest[hospitalIdx].position.x);
+      EXPECT_EQ(best[hospitalIdx].position.y, serialBest[hospitalIdx].position.y);
+    }
+  }
+}
+
+}
+
+#endif //_HPS_AMBULANCE_ASSIGNMENT_SEARCH_GTEST_H_
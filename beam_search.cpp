@@ -0,0 +1,401 @@
+#include "beam_search.h"
+#include "rand_bound.h"
+#include "score_kernels.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+#include <omp.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+BeamSearch::BeamSearch()
+: m_victims(NULL),
+  m_hospitals(NULL),
+  m_simVictims(),
+  m_victimIdx(),
+  m_nearestHospitals(),
+  m_homeHospital(),
+  m_victimKeys(),
+  m_trips(),
+  m_states(),
+  m_nextStates(),
+  m_expansions(),
+  m_ranked(),
+  m_keptHashes(),
+  m_routes()
+{}
+
+unsigned long long BeamSearch::AmbulanceKey(const int time, const int at)
+{
+  const unsigned long long word =
+    (static_cast<unsigned long long>(static_cast<unsigned int>(time)) << 32) |
+    static_cast<unsigned int>(at + 1);
+  return SplitMix64(word).Next();
+}
+
+int BeamSearch::Run(const VictimList& victims,
+                    const HospitalList& hospitals,
+                    const int width,
+                    const Deadline& deadline,
+                    ActionSequenceList* actionSequences)
+{
+  assert(actionSequences && (width > 0));
+  m_victims = &victims;
+  m_hospitals = &hospitals;
+  actionSequences->Clear();
+  if (victims.empty() || hospitals.empty())
+  {
+    return 0;
+  }
+  const int numVictims = static_cast<int>(victims.size());
+  m_simVictims.Assign(victims);
+  m_victimIdx.resize(numVictims);
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    m_victimIdx[victimIdx] = victimIdx;
+  }
+  m_nearestHospitals.Build(victims, hospitals);
+  m_homeHospital.clear();
+  for (int hospitalIdx = 0;
+       hospitalIdx < static_cast<int>(hospitals.size());
+       ++hospitalIdx)
+  {
+    m_homeHospital.insert(m_homeHospital.end(),
+                          hospitals[hospitalIdx].ambulances, hospitalIdx);
+  }
+  const int numAmbulances = static_cast<int>(m_homeHospital.size());
+  // Hash a rescued set as the sum of its victims' keys.
+  {
+    SplitMix64 keys(static_cast<unsigned long long>(numVictims));
+    m_victimKeys.resize(numVictims);
+    for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+    {
+      m_victimKeys[victimIdx] = keys.Next();
+    }
+  }
+  // Start from every ambulance waiting at home.
+  m_trips.clear();
+  m_states.resize(1);
+  {
+    State& root = m_states.front();
+    root.ambulanceTime.assign(numAmbulances, 0);
+    root.ambulanceAt = m_homeHospital;
+    root.rescuedBits.assign((numVictims + 63) / 64, 0ULL);
+    root.lastTrip = -1;
+    root.rescued = 0;
+    root.busyTime = 0;
+    root.hash = 0;
+    for (int ambulanceIdx = 0; ambulanceIdx < numAmbulances; ++ambulanceIdx)
+    {
+      root.hash += AmbulanceKey(0, m_homeHospital[ambulanceIdx]);
+    }
+  }
+  int numStates = 1;
+  int beamWidth = width;
+  int branch = MaxBranch;
+  for (;;)
+  {
+    // Past the deadline, finish the best state greedily.
+    if ((beamWidth > 1) && deadline.Expired())
+    {
+      beamWidth = 1;
+      branch = 1;
+    }
+    if (static_cast<int>(m_expansions.size()) < numStates)
+    {
+      m_expansions.resize(numStates);
+    }
+#pragma omp parallel if (numStates > 1)
+    {
+      std::vector<float> scores;
+#pragma omp for schedule(dynamic)
+      for (int stateIdx = 0; stateIdx < numStates; ++stateIdx)
+      {
+        Expand(stateIdx, branch, &scores, &m_expansions[stateIdx]);
+      }
+    }
+    // Rank the children.
+    m_ranked.clear();
+    bool growing = false;
+    for (int stateIdx = 0; stateIdx < numStates; ++stateIdx)
+    {
+      const std::vector<Expansion>& expansions = m_expansions[stateIdx];
+      for (std::vector<Expansion>::const_iterator expansion = expansions.begin();
+           expansion != expansions.end();
+           ++expansion)
+      {
+        m_ranked.push_back(&*expansion);
+        growing |= (expansion->ambulanceIdx >= 0);
+      }
+    }
+    if (!growing)
+    {
+      break;
+    }
+    std::sort(m_ranked.begin(), m_ranked.end(), ExpansionBetter());
+    // Keep the best child of each hash.
+    m_keptHashes.clear();
+    int numNext = 0;
+    for (std::vector<const Expansion*>::const_iterator ranked = m_ranked.begin();
+         (ranked != m_ranked.end()) && (numNext < beamWidth);
+         ++ranked)
+    {
+      const Expansion& expansion = **ranked;
+      if (std::find(m_keptHashes.begin(), m_keptHashes.end(),
+                    expansion.hash) != m_keptHashes.end())
+      {
+        continue;
+      }
+      m_keptHashes.push_back(expansion.hash);
+      if (static_cast<int>(m_nextStates.size()) <= numNext)
+      {
+        m_nextStates.push_back(State());
+      }
+      State& next = m_nextStates[numNext++];
+      next = m_states[expansion.stateIdx];
+      const int ambulanceIdx = expansion.ambulanceIdx;
+      if (ambulanceIdx < 0)
+      {
+        continue;
+      }
+      if (expansion.trip.numStops > 0)
+      {
+        m_trips.push_back(expansion.trip);
+        m_trips.back().parent = next.lastTrip;
+        next.lastTrip = static_cast<int>(m_trips.size()) - 1;
+        for (int stop = 0; stop < expansion.trip.numStops; ++stop)
+        {
+          const int victimIdx = expansion.trip.stops[stop];
+          next.rescuedBits[victimIdx >> 6] |= (1ULL << (victimIdx & 63));
+        }
+        next.ambulanceTime[ambulanceIdx] = expansion.newTime;
+        next.ambulanceAt[ambulanceIdx] = expansion.trip.hospitalIdx;
+      }
+      else
+      {
+        next.ambulanceAt[ambulanceIdx] = -1;
+      }
+      next.rescued = expansion.rescued;
+      next.busyTime = expansion.busyTime;
+      next.hash = expansion.hash;
+    }
+    m_states.swap(m_nextStates);
+    numStates = numNext;
+  }
+  // Every state is finished. Take the one rescuing the most.
+  int bestIdx = 0;
+  for (int stateIdx = 1; stateIdx < numStates; ++stateIdx)
+  {
+    if (m_states[stateIdx].rescued > m_states[bestIdx].rescued)
+    {
+      bestIdx = stateIdx;
+    }
+  }
+  BuildRoutes(m_states[bestIdx], actionSequences);
+  return m_states[bestIdx].rescued;
+}
+
+void BeamSearch::Expand(const int stateIdx, const int branch,
+                        std::vector<float>* scores,
+                        std::vector<Expansion>* expansions) const
+{
+  assert(scores && expansions && (branch > 0) && (branch <= MaxBranch));
+  const State& state = m_states[stateIdx];
+  expansions->clear();
+  Expansion carry;
+  carry.stateIdx = stateIdx;
+  carry.ambulanceIdx = -1;
+  carry.newTime = 0;
+  carry.rescued = state.rescued;
+  carry.busyTime = state.busyTime;
+  carry.hash = state.hash;
+  carry.trip.numStops = 0;
+  // Free the earliest ambulance.
+  int ambulanceIdx = -1;
+  const int numAmbulances = static_cast<int>(state.ambulanceAt.size());
+  for (int idx = 0; idx < numAmbulances; ++idx)
+  {
+    if ((state.ambulanceAt[idx] >= 0) &&
+        ((ambulanceIdx < 0) ||
+         (state.ambulanceTime[idx] < state.ambulanceTime[ambulanceIdx])))
+    {
+      ambulanceIdx = idx;
+    }
+  }
+  if (ambulanceIdx < 0)
+  {
+    expansions->push_back(carry);
+    return;
+  }
+  const int startTime = state.ambulanceTime[ambulanceIdx];
+  const int startAt = state.ambulanceAt[ambulanceIdx];
+  const Point start = (*m_hospitals)[startAt].position;
+  const unsigned long long startKey = AmbulanceKey(startTime, startAt);
+  // Find the best first pickups that may make it to a hospital.
+  const int numVictims = m_simVictims.Size();
+  scores->resize(numVictims);
+  DistanceTimeSquaredKernel(start, AllVictims(), &(*scores)[0]);
+  int first[MaxBranch];
+  int numFirst = 0;
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    if (IsRescued(state, victimIdx))
+    {
+      continue;
+    }
+    const int routeTime = startTime + VictimLoadTime + VictimUnloadTime +
+                          ((ManhattanDistance(start,
+                                              m_simVictims.Position(victimIdx)) +
+                            m_nearestHospitals[victimIdx].distance) *
+                           DriveOneBlockTime);
+    if (routeTime > m_simVictims.timeToLive[victimIdx])
+    {
+      continue;
+    }
+    // Insert by score; earlier victims win ties.
+    const float score = (*scores)[victimIdx];
+    int slot = numFirst;
+    while ((slot > 0) && (score < (*scores)[first[slot - 1]]))
+    {
+      --slot;
+    }
+    if (slot < branch)
+    {
+      numFirst = std::min(numFirst + 1, branch);
+      for (int move = numFirst - 1; move > slot; --move)
+      {
+        first[move] = first[move - 1];
+      }
+      first[slot] = victimIdx;
+    }
+  }
+  // Nobody may be rescued by this ambulance any more.
+  if (0 == numFirst)
+  {
+    Expansion retire = carry;
+    retire.ambulanceIdx = ambulanceIdx;
+    retire.hash = state.hash - startKey + AmbulanceKey(startTime, -1);
+    expansions->push_back(retire);
+    return;
+  }
+  for (int firstIdx = 0; firstIdx < numFirst; ++firstIdx)
+  {
+    Expansion expansion = carry;
+    expansion.ambulanceIdx = ambulanceIdx;
+    Trip& trip = expansion.trip;
+    trip.parent = -1;
+    trip.ambulanceIdx = ambulanceIdx;
+    trip.stops[0] = first[firstIdx];
+    trip.numStops = 1;
+    CompleteTrip(state, start, startTime, scores, &trip);
+    const int tripTime = TripOrder::Run(m_simVictims, m_nearestHospitals, start,
+                                        trip.numStops, trip.stops);
+    trip.hospitalIdx = m_nearestHospitals[trip.stops[trip.numStops - 1]].hospitalIdx;
+    expansion.newTime = startTime + tripTime;
+    expansion.rescued = state.rescued + trip.numStops;
+    expansion.busyTime = state.busyTime + tripTime;
+    expansion.hash = state.hash - startKey +
+                     AmbulanceKey(expansion.newTime, trip.hospitalIdx);
+    for (int stop = 0; stop < trip.numStops; ++stop)
+    {
+      expansion.hash += m_victimKeys[trip.stops[stop]];
+    }
+    expansions->push_back(expansion);
+  }
+}
+
+void BeamSearch::CompleteTrip(const State& state, const Point& start,
+                              const int startTime, std::vector<float>* scores,
+                              Trip* trip) const
+{
+  assert(scores && trip && (1 == trip->numStops));
+  // Same rule as GreedyBase: each pickup must keep the trip, returning from
+  // the last pickup to its nearest hospital, within every deadline aboard.
+  Point position = m_simVictims.Position(trip->stops[0]);
+  int pickupTime = startTime + VictimLoadTime +
+                   (ManhattanDistance(start, position) * DriveOneBlockTime);
+  int mostCriticalTime = m_simVictims.timeToLive[trip->stops[0]];
+  const int numVictims = m_simVictims.Size();
+  while (trip->numStops < TripOrder::MaxStops)
+  {
+    DistanceTimeSquaredKernel(position, AllVictims(), &(*scores)[0]);
+    int bestIdx = -1;
+    int bestPickupTime = 0;
+    for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+    {
+      if (IsRescued(state, victimIdx) ||
+          (std::find(trip->stops, trip->stops + trip->numStops, victimIdx) !=
+           trip->stops + trip->numStops))
+      {
+        continue;
+      }
+      if ((bestIdx >= 0) && ((*scores)[victimIdx] >= (*scores)[bestIdx]))
+      {
+        continue;
+      }
+      const int pickupVictimTime =
+        VictimLoadTime +
+        (ManhattanDistance(position, m_simVictims.Position(victimIdx)) *
+         DriveOneBlockTime);
+      const int routeTime = pickupTime + pickupVictimTime + VictimUnloadTime +
+                            (m_nearestHospitals[victimIdx].distance *
+                             DriveOneBlockTime);
+      if ((routeTime <= m_simVictims.timeToLive[victimIdx]) &&
+          (routeTime <= mostCriticalTime))
+      {
+        bestIdx = victimIdx;
+        bestPickupTime = pickupVictimTime;
+      }
+    }
+    if (bestIdx < 0)
+    {
+      break;
+    }
+    trip->stops[trip->numStops++] = bestIdx;
+    pickupTime += bestPickupTime;
+    mostCriticalTime = std::min(mostCriticalTime,
+                                m_simVictims.timeToLive[bestIdx]);
+    position = m_simVictims.Position(bestIdx);
+  }
+}
+
+void BeamSearch::BuildRoutes(const State& state,
+                             ActionSequenceList* actionSequences)
+{
+  const int numAmbulances = static_cast<int>(m_homeHospital.size());
+  m_routes.Reset(numAmbulances);
+  for (int ambulanceIdx = 0; ambulanceIdx < numAmbulances; ++ambulanceIdx)
+  {
+    m_routes.AddStop(ambulanceIdx,
+                     ActionNode(m_homeHospital[ambulanceIdx] + 1,
+                                ActionNode::StopType_Hospital));
+  }
+  // Walk the trips back from the last, then add them first to last.
+  std::vector<int> tripIdx;
+  for (int trip = state.lastTrip; trip >= 0; trip = m_trips[trip].parent)
+  {
+    tripIdx.push_back(trip);
+  }
+  for (std::vector<int>::const_reverse_iterator idx = tripIdx.rbegin();
+       idx != tripIdx.rend();
+       ++idx)
+  {
+    const Trip& trip = m_trips[*idx];
+    for (int stop = 0; stop < trip.numStops; ++stop)
+    {
+      m_routes.AddStop(trip.ambulanceIdx,
+                       ActionNode(trip.stops[stop] + 1,
+                                  ActionNode::StopType_Victim));
+    }
+    m_routes.AddStop(trip.ambulanceIdx,
+                     ActionNode((*m_hospitals)[trip.hospitalIdx].id,
+                                ActionNode::StopType_Hospital));
+  }
+  m_routes.Build(actionSequences);
+}
+
+}
+}
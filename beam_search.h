@@ -0,0 +1,162 @@
+#ifndef _HPS_AMBULANCE_BEAM_SEARCH_H_
+#define _HPS_AMBULANCE_BEAM_SEARCH_H_
+#include "ambulance_core.h"
+#include "greedy_base.h"
+#include "deadline.h"
+#include <vector>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Dispatch ambulances by beam search over partial simulations. </summary>
+/// <remarks>
+///   <para> GreedyRescue commits to one trip each time an ambulance is free.
+///     The beam keeps the best width partial simulations instead. Each step
+///     frees the earliest ambulance of every state and tries a trip from
+///     each of the best few first pickups, completing it greedily and
+///     visiting it in the best order. Children are ranked by rescued count,
+///     then by least ambulance time, and children with the same hash are
+///     kept once. States expand in parallel.
+///   </para>
+///   <para> A state holds only ambulance clocks and places, a rescued bit set
+///     and the index of its last trip. Trips are kept once in a shared list
+///     where each trip points to the one before it, so children share their
+///     routes with their parents and nothing is copied as routes grow.
+///   </para>
+///   <para> Once the deadline expires the beam narrows to the single best
+///     state and finishes it greedily, so a solution is always made.
+///   </para>
+/// </remarks>
+class BeamSearch
+{
+public:
+  enum { DefaultWidth = 16, };
+  enum { MaxBranch = 4, };
+
+  BeamSearch();
+
+  /// <summary> Rescue victims with a beam of the given width. </summary>
+  /// <returns> The number of victims rescued. </returns>
+  int Run(const VictimList& victims,
+          const HospitalList& hospitals,
+          const int width,
+          const Deadline& deadline,
+          ActionSequenceList* actionSequences);
+
+private:
+  typedef detail::TripOrder TripOrder;
+
+  /// <summary> One trip, shared by every state descending from its maker. </summary>
+  struct Trip
+  {
+    int parent;
+    int ambulanceIdx;
+    int hospitalIdx;
+    int numStops;
+    int stops[TripOrder::MaxStops];
+  };
+
+  /// <summary> A partial simulation. </summary>
+  /// <remarks>
+  ///   <para> ambulanceAt is the hospital an ambulance waits at, or -1 once
+  ///     it may rescue nobody else.
+  ///   </para>
+  /// </remarks>
+  struct State
+  {
+    std::vector<int> ambulanceTime;
+    std::vector<int> ambulanceAt;
+    std::vector<unsigned long long> rescuedBits;
+    int lastTrip;
+    int rescued;
+    long long busyTime;
+    unsigned long long hash;
+  };
+
+  /// <summary> A state grown by one trip. </summary>
+  /// <remarks>
+  ///   <para> An ambulanceIdx of -1 carries a finished state over as is. </para>
+  /// </remarks>
+  struct Expansion
+  {
+    int stateIdx;
+    int ambulanceIdx;
+    int newTime;
+    int rescued;
+    long long busyTime;
+    unsigned long long hash;
+    Trip trip;
+  };
+
+  /// <summary> Order expansions best first. </summary>
+  struct ExpansionBetter
+  {
+    inline bool operator()(const Expansion* lhs, const Expansion* rhs) const
+    {
+      if (lhs->rescued != rhs->rescued)
+      {
+        return lhs->rescued > rhs->rescued;
+      }
+      if (lhs->busyTime != rhs->busyTime)
+      {
+        return lhs->busyTime < rhs->busyTime;
+      }
+      return lhs->hash < rhs->hash;
+    }
+  };
+
+  inline static bool IsRescued(const State& state, const int victimIdx)
+  {
+    return 0 != (state.rescuedBits[victimIdx >> 6] &
+                 (1ULL << (victimIdx & 63)));
+  }
+
+  /// <summary> Every victim as one block for batch scoring. </summary>
+  inline VictimBlock AllVictims() const
+  {
+    VictimBlock block;
+    block.x = &m_simVictims.x[0];
+    block.y = &m_simVictims.y[0];
+    block.timeToLive = &m_simVictims.timeToLive[0];
+    block.victimIdx = &m_victimIdx[0];
+    block.count = m_simVictims.Size();
+    return block;
+  }
+
+  /// <summary> Hash of an ambulance's clock and place. </summary>
+  static unsigned long long AmbulanceKey(const int time, const int at);
+
+  /// <summary> Make the children of a state. </summary>
+  void Expand(const int stateIdx, const int branch, std::vector<float>* scores,
+              std::vector<Expansion>* expansions) const;
+
+  /// <summary> Complete a trip greedily after its first pickup. </summary>
+  void CompleteTrip(const State& state, const Point& start, const int startTime,
+                    std::vector<float>* scores, Trip* trip) const;
+
+  /// <summary> Write the routes of a finished state. </summary>
+  void BuildRoutes(const State& state, ActionSequenceList* actionSequences);
+
+  const VictimList* m_victims;
+  const HospitalList* m_hospitals;
+  SimVictimStore m_simVictims;
+  std::vector<int> m_victimIdx;
+  NearestHospitalTable m_nearestHospitals;
+  std::vector<int> m_homeHospital;
+  std::vector<unsigned long long> m_victimKeys;
+  std::vector<Trip> m_trips;
+  std::vector<State> m_states;
+  std::vector<State> m_nextStates;
+  std::vector<std::vector<Expansion> > m_expansions;
+  std::vector<const Expansion*> m_ranked;
+  std::vector<unsigned long long> m_keptHashes;
+  ActionSequenceBuilder m_routes;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_BEAM_SEARCH_H_
@@ -0,0 +1,53 @@
+#ifndef _HPS_AMBULANCE_BEAM_SEARCH_GTEST_H_
+#define _HPS_AMBULANCE_BEAM_SEARCH_GTEST_H_
+#include "beam_search.h"
+#include "data_file.h"
+#include "validate_gtest.h"
+#include "gtest/gtest.h"
+#include <omp.h>
+
+namespace _hps_ambulance_beam_search_gtest_h_
+{
+using namespace hps;
+
+TEST(RandomHospitals, beam_search)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { NumTrials = 4, };
+
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  RandEngine rng(11ULL);
+  BeamSearch beamSearch;
+  const int widths[] = { 1, BeamSearch::DefaultWidth, };
+  for (int trial = 0; trial < NumTrials; ++trial)
+  {
+    HospitalList hospitals;
+    RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &hospitals);
+    for (int widthIdx = 0; widthIdx < 2; ++widthIdx)
+    {
+      ActionSequenceList actionSequences;
+      const int rescued = beamSearch.Run(victims, hospitals, widths[widthIdx],
+                                         Deadline(), &actionSequences);
+      int numRescued;
+      ASSERT_TRUE(ValidateAmbulance(victims, hospitals, actionSequences,
+                                    &numRescued));
+      EXPECT_EQ(rescued, numRescued);
+      // The result must not depend on how many threads expand the beam.
+      const int numThreads = omp_get_max_threads();
+      omp_set_num_threads(1);
+      ActionSequenceList serialSequences;
+      const int serialRescued = beamSearch.Run(victims, hospitals,
+                                               widths[widthIdx], Deadline(),
+                                               &serialSequences);
+      omp_set_num_threads(numThreads);
+      EXPECT_EQ(rescued, serialRescued);
+      ExpectSameActionSequences(actionSequences, serialSequences);
+    }
+  }
+}
+
+}
+
+#endif //_HPS_AMBULANCE_BEAM_SEARCH_GTEST_H_
@@ -198,5 +198,25 @@ Next(unsigned long long* const m, Combination* const combination)
   *combination = m_combination;
 }
 
+PermutationTable::PermutationTable(const unsigned int n)
+: m_n(n),
+  m_count(Factorial(n)),
+  m_indices()
+{
+  // Indices are stored in bytes.
+  enum { MaxN = 8, };
+  assert(n <= MaxN);
+  m_indices.reserve(static_cast<size_t>(m_count * n));
+  std::vector<unsigned char> permutation(n);
+  for (unsigned int idx = 0; idx < n; ++idx)
+  {
+    permutation[idx] = static_cast<unsigned char>(idx);
+  }
+  do
+  {
+    m_indices.insert(m_indices.end(), permutation.begin(), permutation.end());
+  } while (std::next_permutation(permutation.begin(), permutation.end()));
+}
+
 }
 }
@@ -136,6 +136,40 @@ private:
   Combination m_combination;
 };
 
+/// <summary> All permutations of n indices in lexicographic order. </summary>
+/// <remarks>
+///   <para> The permutations are stored end to end so that small searches,
+///     such as the order to visit a handful of stops, may walk the table
+///     without generating anything.
+///   </para>
+/// </remarks>
+class PermutationTable
+{
+public:
+  explicit PermutationTable(const unsigned int n);
+
+  inline unsigned int GetN() const
+  {
+    return m_n;
+  }
+  inline unsigned long long GetPermutationCount() const
+  {
+    return m_count;
+  }
+
+  /// <summary> Get the mth permutation as n indices. </summary>
+  inline const unsigned char* operator[](const unsigned long long m) const
+  {
+    assert(m < m_count);
+    return &m_indices[static_cast<size_t>(m * m_n)];
+  }
+
+private:
+  unsigned int m_n;
+  unsigned long long m_count;
+  std::vector<unsigned char> m_indices;
+};
+
 }
 using namespace math;
 }
@@ -0,0 +1,95 @@
+#ifndef _HPS_SYS_DEADLINE_H_
+#define _HPS_SYS_DEADLINE_H_
+#include <signal.h>
+#include <assert.h>
+#include <algorithm>
+#include <limits>
+#include <omp.h>
+
+namespace hps
+{
+namespace sys
+{
+
+/// <summary> Flag raised when the process is asked to stop. </summary>
+inline volatile sig_atomic_t& InterruptRequested()
+{
+  static volatile sig_atomic_t s_interrupted = 0;
+  return s_interrupted;
+}
+
+namespace detail
+{
+extern "C" inline void InterruptSignalHandler(int)
+{
+  InterruptRequested() = 1;
+}
+}
+
+/// <summary> Raise InterruptRequested() on SIGINT and SIGTERM. </summary>
+/// <remarks>
+///   <para> The handler only sets a flag. Searches see it through
+///     Deadline::Expired() and unwind so that the caller may still report
+///     the best solution found so far.
+///   </para>
+/// </remarks>
+inline void InstallInterruptHandlers()
+{
+  signal(SIGINT, detail::InterruptSignalHandler);
+  signal(SIGTERM, detail::InterruptSignalHandler);
+}
+
+/// <summary> A wall-clock deadline for anytime searches. </summary>
+/// <remarks>
+///   <para> Checking the deadline reads the OpenMP wall clock, which is cheap
+///     enough to call once per iteration of any loop that does real work.
+///     An interrupt expires every deadline.
+///   </para>
+/// </remarks>
+class Deadline
+{
+public:
+  /// <summary> A deadline that expires only on interrupt. </summary>
+  Deadline() : m_end(std::numeric_limits<double>::max()) {}
+
+  /// <summary> A deadline the given number of milliseconds from now. </summary>
+  explicit Deadline(const int milliseconds)
+    : m_end(omp_get_wtime() + (static_cast<double>(milliseconds) / 1000.0))
+  {}
+
+  inline bool Expired() const
+  {
+    return (0 != InterruptRequested()) || (omp_get_wtime() >= m_end);
+  }
+
+  /// <summary> A deadline one part of the way from now to this one. </summary>
+  /// <remarks>
+  ///   <para> Stages run one after another may each take Share(stagesLeft),
+  ///     so that the time left is split evenly and time a stage does not use
+  ///     goes to the stages after it. A deadline that expires only on
+  ///     interrupt is shared as itself.
+  ///   </para>
+  /// </remarks>
+  inline Deadline Share(const int parts) const
+  {
+    assert(parts > 0);
+    if (std::numeric_limits<double>::max() == m_end)
+    {
+      return *this;
+    }
+    const double now = omp_get_wtime();
+    return Deadline(now + (std::max(m_end - now, 0.0) / parts), EndTag());
+  }
+
+private:
+  struct EndTag {};
+  Deadline(const double end, EndTag) : m_end(end) {}
+
+  double m_end;
+};
+
+}
+using namespace sys;
+}
+
+#endif //_HPS_SYS_DEADLINE_H_
@@ -0,0 +1,110 @@
+#include "distance_oracle.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+DistanceOracle::DistanceOracle()
+: m_victimPositions(),
+  m_positions(),
+  m_distances(),
+  m_useTable(false)
+{}
+
+bool DistanceOracle::Assign(const VictimList& victims,
+                            const HospitalList& hospitals)
+{
+  const int numVictims = static_cast<int>(victims.size());
+  const int numPlaces = numVictims + static_cast<int>(hospitals.size());
+  bool sameVictims = (numPlaces == NumPlaces()) &&
+                     (numVictims == NumVictims());
+  for (int victimIdx = 0; sameVictims && (victimIdx < numVictims); ++victimIdx)
+  {
+    sameVictims = (victims[victimIdx].position == m_victimPositions[victimIdx]);
+  }
+  m_positions.resize(numPlaces);
+  for (int hospitalIdx = 0; hospitalIdx < (numPlaces - numVictims); ++hospitalIdx)
+  {
+    m_positions[numVictims + hospitalIdx] = hospitals[hospitalIdx].position;
+  }
+  if (!sameVictims)
+  {
+    m_victimPositions.resize(numVictims);
+    for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+    {
+      m_victimPositions[victimIdx] = victims[victimIdx].position;
+      m_positions[victimIdx] = victims[victimIdx].position;
+    }
+  }
+  // The victim distances of the table are kept only if it was in use.
+  const bool keepVictims = sameVictims && m_useTable;
+  m_useTable = (numPlaces <= MaxTablePlaces) && FitsTable();
+  if (!m_useTable)
+  {
+    m_distances.Reallocate(0);
+  }
+  else if (keepVictims)
+  {
+    Build(numVictims);
+  }
+  else
+  {
+    m_distances.Reallocate(numPlaces);
+    Build(0);
+  }
+  return !sameVictims;
+}
+
+bool DistanceOracle::FitsTable() const
+{
+  if (m_positions.empty())
+  {
+    return true;
+  }
+  // No distance is longer than the span of the bounding box.
+  Point minCorner(std::numeric_limits<int>::max(),
+                  std::numeric_limits<int>::max());
+  Point maxCorner(std::numeric_limits<int>::min(),
+                  std::numeric_limits<int>::min());
+  for (std::vector<Point>::const_iterator position = m_positions.begin();
+       position != m_positions.end();
+       ++position)
+  {
+    minCorner.x = std::min(minCorner.x, position->x);
+    minCorner.y = std::min(minCorner.y, position->y);
+    maxCorner.x = std::max(maxCorner.x, position->x);
+    maxCorner.y = std::max(maxCorner.y, position->y);
+  }
+  const long long span =
+    (static_cast<long long>(maxCorner.x) - minCorner.x) +
+    (static_cast<long long>(maxCorner.y) - minCorner.y);
+  return span <= MaxDistance;
+}
+
+void DistanceOracle::Build(const int firstPlace)
+{
+  // Only split large tables across threads.
+  enum { MinParallelPlaces = 1024, };
+  const int numPlaces = NumPlaces();
+#pragma omp parallel for schedule(dynamic, 16) \
+                         if (numPlaces >= MinParallelPlaces)
+  for (int row = 0; row < numPlaces; ++row)
+  {
+    const Point& from = m_positions[row];
+    DistanceType* distances = m_distances[row];
+    // Rows before firstPlace only change in the columns from it on.
+    for (int col = (row < firstPlace) ? firstPlace : 0; col < numPlaces; ++col)
+    {
+      const int distance = PlaceDistance(from, m_positions[col]);
+      assert((distance >= 0) && (distance <= MaxDistance));
+      distances[col] = static_cast<DistanceType>(distance);
+    }
+  }
+}
+
+}
+}
@@ -0,0 +1,113 @@
+#ifndef _HPS_AMBULANCE_DISTANCE_ORACLE_H_
+#define _HPS_AMBULANCE_DISTANCE_ORACLE_H_
+#include "ambulance_core.h"
+#include "edgematrix.h"
+#include <vector>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Precomputed distances between victims and hospitals. </summary>
+/// <remarks>
+///   <para> Places are the victims in order, then the hospitals in order, so
+///     victim i is place i and hospital h is place numVictims + h. Distances
+///     are kept as 16-bit values in an AlignedEdgeMatrix, so the table for
+///     the sample inputs is about 0.2 MB.
+///   </para>
+///   <para> The table grows with the square of the places. Past
+///     MaxTablePlaces places, or when the victims and hospitals span more
+///     blocks than a 16-bit value holds, no table is kept and every lookup
+///     computes the distance from the positions instead.
+///   </para>
+///   <para> Both halves of the matrix are kept. A lower triangle takes half
+///     the memory, but ordering the places before each lookup made local
+///     search slower than computing the distance, while the full matrix
+///     made it faster.
+///   </para>
+///   <para> Victims rarely change between calls while hospitals move on
+///     every one. Assign() rebuilds the victim to victim distances only
+///     when the victims differ from the last call, and always rebuilds the
+///     hospital rows and columns, which are last. Large builds are split
+///     across threads by row.
+///   </para>
+///   <para> Every travel cost comes from PlaceDistance(), so costs other
+///     than blocks driven need change only that.
+///   </para>
+/// </remarks>
+class DistanceOracle
+{
+public:
+  typedef unsigned short DistanceType;
+  enum { MaxDistance = 0xFFFF, };
+  /// <summary> The most places given a table, which is then 32 MB. </summary>
+  enum { MaxTablePlaces = 4096, };
+
+  DistanceOracle();
+
+  /// <summary> Make the table for the victims and hospitals. </summary>
+  /// <returns> True when the victims differ from the last call. </returns>
+  bool Assign(const VictimList& victims, const HospitalList& hospitals);
+
+  inline int NumVictims() const
+  {
+    return static_cast<int>(m_victimPositions.size());
+  }
+
+  inline int NumPlaces() const
+  {
+    return static_cast<int>(m_positions.size());
+  }
+
+  /// <summary> Whether lookups read the table or compute distances. </summary>
+  inline bool UsesTable() const
+  {
+    return m_useTable;
+  }
+
+  inline int HospitalPlace(const int hospitalIdx) const
+  {
+    return NumVictims() + hospitalIdx;
+  }
+
+  /// <summary> Distance between two places. </summary>
+  inline int operator()(const int fromPlace, const int toPlace) const
+  {
+    if (m_useTable)
+    {
+      return m_distances[fromPlace][toPlace];
+    }
+    return PlaceDistance(m_positions[fromPlace], m_positions[toPlace]);
+  }
+
+  /// <summary> Bytes held by the table. </summary>
+  inline size_t Bytes() const
+  {
+    return m_distances.Bytes();
+  }
+
+  /// <summary> The travel cost between two points. </summary>
+  inline static int PlaceDistance(const Point& a, const Point& b)
+  {
+    return ManhattanDistance(a, b);
+  }
+
+private:
+  /// <summary> Check that every distance fits in DistanceType. </summary>
+  bool FitsTable() const;
+
+  /// <summary> Fill every distance to or from places firstPlace on. </summary>
+  void Build(const int firstPlace);
+
+  std::vector<Point> m_victimPositions;
+  std::vector<Point> m_positions;
+  tsp::AlignedEdgeMatrix<DistanceType> m_distances;
+  bool m_useTable;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_DISTANCE_ORACLE_H_
@@ -0,0 +1,126 @@
+#ifndef _HPS_AMBULANCE_DISTANCE_ORACLE_GTEST_H_
+#define _HPS_AMBULANCE_DISTANCE_ORACLE_GTEST_H_
+#include "distance_oracle.h"
+#include "data_file.h"
+#include "validate_gtest.h"
+#include "gtest/gtest.h"
+
+namespace _hps_ambulance_distance_oracle_gtest_h_
+{
+using namespace hps;
+
+TEST(MatchesManhattan, distance_oracle)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { NumLayouts = 3, };
+
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  const int numVictims = static_cast<int>(victims.size());
+  const int numHospitals = static_cast<int>(hospitalAmbulances.size());
+  RandEngine rng(18ULL);
+  DistanceOracle oracle;
+  // Moving the hospitals must update their rows and columns.
+  for (int layout = 0; layout < NumLayouts; ++layout)
+  {
+    HospitalList hospitals;
+    RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &hospitals);
+    // Only the first layout brings new victims.
+    EXPECT_EQ(0 == layout, oracle.Assign(victims, hospitals));
+    ASSERT_EQ(numVictims + numHospitals, oracle.NumPlaces());
+    EXPECT_TRUE(oracle.UsesTable());
+    std::vector<Point> positions;
+    for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+    {
+      positions.push_back(victims[victimIdx].position);
+    }
+    for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+    {
+      EXPECT_EQ(numVictims + hospitalIdx, oracle.HospitalPlace(hospitalIdx));
+      positions.push_back(hospitals[hospitalIdx].position);
+    }
+    for (int from = 0; from < oracle.NumPlaces(); ++from)
+    {
+      for (int to = 0; to < oracle.NumPlaces(); ++to)
+      {
+        ASSERT_EQ(ManhattanDistance(positions[from], positions[to]),
+                  oracle(from, to));
+      }
+    }
+  }
+  // New victims rebuild everything.
+  victims.resize(numVictims / 2);
+  HospitalList hospitals(1);
+  hospitals[0].id = 1;
+  hospitals[0].ambulances = 1;
+  EXPECT_TRUE(oracle.Assign(victims, hospitals));
+  ASSERT_EQ(static_cast<int>(victims.size()) + 1, oracle.NumPlaces());
+  for (int victimIdx = 0; victimIdx < static_cast<int>(victims.size()); ++victimIdx)
+  {
+    EXPECT_EQ(ManhattanDistance(victims[victimIdx].position, Point()),
+              oracle(victimIdx, oracle.HospitalPlace(0)));
+  }
+}
+
+TEST(Fallback, distance_oracle)
+{
+  enum { NumHospitals = 3, };
+
+  HospitalAmbulanceList hospitalAmbulances(NumHospitals, 1);
+  RandEngine rng(19ULL);
+  HospitalList hospitals;
+  RandomLayout(hospitalAmbulances, 100, &rng, &hospitals);
+  DistanceOracle oracle;
+  // Too many places for a table.
+  const int numVictims = DistanceOracle::MaxTablePlaces;
+  VictimList victims(numVictims);
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(1 + RandBound(&rng, 1000),
+                                        1 + RandBound(&rng, 1000));
+    victims[victimIdx].timeToLive = 100;
+  }
+  oracle.Assign(victims, hospitals);
+  EXPECT_FALSE(oracle.UsesTable());
+  EXPECT_EQ(numVictims + NumHospitals, oracle.NumPlaces());
+  for (int victimIdx = 0; victimIdx < 100; ++victimIdx)
+  {
+    const int hospitalIdx = victimIdx % NumHospitals;
+    EXPECT_EQ(ManhattanDistance(victims[victimIdx].position,
+                                hospitals[hospitalIdx].position),
+              oracle(victimIdx, oracle.HospitalPlace(hospitalIdx)));
+  }
+  // Distances too long for 16 bits.
+  victims.resize(2);
+  victims[1].position = Point(DistanceOracle::MaxDistance, 10);
+  oracle.Assign(victims, hospitals);
+  EXPECT_FALSE(oracle.UsesTable());
+  EXPECT_EQ(ManhattanDistance(victims[0].position, victims[1].position),
+            oracle(0, 1));
+  // A table again once it fits.
+  victims[1].position = Point(100, 10);
+  oracle.Assign(victims, hospitals);
+  EXPECT_TRUE(oracle.UsesTable());
+  EXPECT_EQ(ManhattanDistance(victims[0].position, victims[1].position),
+            oracle(0, 1));
+}
+
+TEST(RowAlignment, distance_oracle)
+{
+  tsp::AlignedEdgeMatrix<unsigned short> edges;
+  const size_t sizes[] = { 1, 31, 32, 33, 1005, };
+  for (int sizeIdx = 0; sizeIdx < 5; ++sizeIdx)
+  {
+    edges.Reallocate(sizes[sizeIdx]);
+    for (size_t row = 0; row < edges.Size(); ++row)
+    {
+      EXPECT_EQ(0U, reinterpret_cast<size_t>(edges[row]) %
+                    tsp::AlignedEdgeMatrix<unsigned short>::RowAlignment);
+    }
+  }
+}
+
+}
+
+#endif //_HPS_AMBULANCE_DISTANCE_ORACLE_GTEST_H_
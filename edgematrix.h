@@ -1,8 +1,8 @@
 #ifndef _02_TSP_DISTANCE_MATRIX_H_
 #define _02_TSP_DISTANCE_MATRIX_H_
-#include "data_file.h"
-#include <functional>
+#include <algorithm>
 #include <cstdlib>
+#include <assert.h>
 
 namespace hps
 {
@@ -24,11 +24,28 @@ struct EdgeMatrix
     edgeArray(new WeightType[nodeCount * nodeCount])
   {};
 
+  EdgeMatrix(const EdgeMatrix& rhs)
+  : nodeCount(rhs.nodeCount),
+    edgeArray(new WeightType[rhs.nodeCount * rhs.nodeCount])
+  {
+    std::copy(rhs.edgeArray, rhs.edgeArray + (nodeCount * nodeCount), edgeArray);
+  }
+
   ~EdgeMatrix()
   {
     delete [] edgeArray;
   }
 
+  EdgeMatrix& operator=(const EdgeMatrix& rhs)
+  {
+    if (this != &rhs)
+    {
+      Reallocate(rhs.nodeCount);
+      std::copy(rhs.edgeArray, rhs.edgeArray + (nodeCount * nodeCount), edgeArray);
+    }
+    return *this;
+  }
+
   inline void Reallocate(const size_t nodeCount_)
   {
     if (nodeCount_ != nodeCount)
@@ -44,6 +61,12 @@ struct EdgeMatrix
     return nodeCount;
   }
 
+  /// <summary> Set every edge to value. </summary>
+  inline void Fill(const WeightType& value)
+  {
+    std::fill(edgeArray, edgeArray + (nodeCount * nodeCount), value);
+  }
+
   inline WeightType* Data()
   {
     return edgeArray;
@@ -88,56 +111,117 @@ struct EdgeMatrix
   WeightType* edgeArray;
 };
 
-template <typename NumericType>
-inline NumericType AbsSubtract(const NumericType& lhs, const NumericType& rhs)
+/// <summary> Edge matrix with every row on a cache line boundary. </summary>
+/// <remarks>
+///   <para> Rows are padded to a whole number of RowAlignment bytes, so that
+///     each row, and any block of columns in it that starts on a boundary,
+///     begins on a cache line. The padding is never read.
+///   </para>
+/// </remarks>
+template <typename WeightType>
+class AlignedEdgeMatrix
 {
-  if (lhs >= rhs)
+public:
+  typedef WeightType value_type;
+  enum { RowAlignment = 64, };
+  enum { RowStride = RowAlignment / sizeof(WeightType), };
+
+  AlignedEdgeMatrix()
+  : m_nodeCount(0),
+    m_stride(0),
+    m_capacity(0),
+    m_buffer(NULL),
+    m_edges(NULL)
+  {}
+
+  ~AlignedEdgeMatrix()
   {
-    return lhs - rhs;
+    delete [] m_buffer;
   }
-  else
+
+  /// <summary> Resize for nodeCount nodes. Edges are left undefined. </summary>
+  void Reallocate(const size_t nodeCount)
   {
-    return rhs - lhs;
+    m_nodeCount = nodeCount;
+    m_stride = ((nodeCount + RowStride - 1) / RowStride) * RowStride;
+    const size_t numEdges = m_stride * nodeCount;
+    // Reuse the buffer when it is large enough.
+    if (numEdges > m_capacity)
+    {
+      delete [] m_buffer;
+      m_capacity = numEdges;
+      m_buffer = new char[(numEdges * sizeof(WeightType)) + RowAlignment];
+      const size_t misalign = reinterpret_cast<size_t>(m_buffer) %
+                              RowAlignment;
+      m_edges = reinterpret_cast<WeightType*>(
+        m_buffer + ((RowAlignment - misalign) % RowAlignment));
+    }
   }
-}
 
-/// <summary> Compute the edge length between two nodes. </summary>
-template <typename WeightType, typename SqrtType>
-struct EdgeDistanceCalculator
-  : public std::binary_function<DataFile::Location, DataFile::Location, WeightType>
-{
-  inline WeightType operator()(const DataFile::Location& from,
-                               const DataFile::Location& to) const
+  inline size_t Size() const
   {
-    const WeightType dx = static_cast<WeightType>(AbsSubtract(from.x, to.x));
-    const WeightType dy = static_cast<WeightType>(AbsSubtract(from.y, to.y));
-    const WeightType dz = static_cast<WeightType>(AbsSubtract(from.z, to.z));
-    const WeightType distSq = (dx*dx) + (dy*dy) + (dz*dz);
-    return static_cast<WeightType>(sqrt(static_cast<SqrtType>(distSq)));
+    return m_nodeCount;
   }
+
+  /// <summary> Bytes held by the edges, padding included. </summary>
+  inline size_t Bytes() const
+  {
+    return m_capacity * sizeof(WeightType);
+  }
+
+  inline WeightType* GetRow(const size_t i)
+  {
+    assert(i < m_nodeCount);
+    return m_edges + (i * m_stride);
+  }
+
+  inline const WeightType* GetRow(const size_t i) const
+  {
+    assert(i < m_nodeCount);
+    return m_edges + (i * m_stride);
+  }
+
+  inline const WeightType& GetEdge(const size_t i, const size_t j) const
+  {
+    return GetRow(i)[j];
+  }
+
+  inline void SetEdge(const size_t i, const size_t j, const WeightType& value)
+  {
+    GetRow(i)[j] = value;
+  }
+
+  inline WeightType* operator[](const size_t i)
+  {
+    return GetRow(i);
+  }
+
+  inline const WeightType* operator[](const size_t i) const
+  {
+    return GetRow(i);
+  }
+
+private:
+  AlignedEdgeMatrix(const AlignedEdgeMatrix&);
+  AlignedEdgeMatrix& operator=(const AlignedEdgeMatrix&);
+
+  size_t m_nodeCount;
+  size_t m_stride;
+  size_t m_capacity;
+  char* m_buffer;
+  WeightType* m_edges;
 };
 
-/// <summary> Compute the edge weights from the data file. </summary>
-template <typename BinaryOperator, typename WeightType>
-void EdgeMatrixFromDataFile(const DataFile& data,
-                            BinaryOperator func,
-                            EdgeMatrix<WeightType>* matrix)
+template <typename NumericType>
+inline NumericType AbsSubtract(const NumericType& lhs, const NumericType& rhs)
 {
-  assert(matrix);
-  matrix->Reallocate(data.nodes.size());
-  // Only iterate lower triangle since upper triangle is a copy.
-  const std::vector<DataFile::Location>& nodes = data.nodes;
-  const size_t nodeCount = matrix->nodeCount;
-  for (size_t row = 0; row < nodeCount; ++row)
-  {
-    for (size_t col = 0; col <= row; ++col)
-    {
-      const WeightType edgeCost = func(nodes[row], nodes[col]);
-      // Set (i, j).
-      matrix->SetEdge(row, col, edgeCost);
-      // Set (j, i).
-      matrix->SetEdge(col, row, edgeCost);
-    }
+  if (lhs >= rhs)
+  {
+    return lhs - rhs;
+  }
+  else
+  {
+    return rhs - lhs;
   }
 }
 
@@ -0,0 +1,152 @@
+#include "evaluation_cache.h"
+#include "rand_bound.h"
+#include <assert.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+EvaluationCache::EvaluationCache(const int maxEntries, const size_t maxBytes)
+: m_slots(),
+  m_slotMask(0ULL),
+  m_maxEntries(maxEntries),
+  m_maxBytes(maxBytes),
+  m_size(0),
+  m_bytes(0)
+{
+  assert(maxEntries >= 0);
+  // Keep the table at most half full so that probes stay short.
+  size_t numSlots = 2;
+  while (numSlots < (2 * static_cast<size_t>(maxEntries)))
+  {
+    numSlots <<= 1;
+  }
+  Slot empty;
+  empty.ready = 0;
+  empty.hash = 0ULL;
+  empty.entry = NULL;
+  m_slots.assign(numSlots, empty);
+  m_slotMask = numSlots - 1;
+}
+
+EvaluationCache::~EvaluationCache()
+{
+  for (std::vector<Slot>::iterator slot = m_slots.begin();
+       slot != m_slots.end();
+       ++slot)
+  {
+    delete slot->entry;
+  }
+}
+
+unsigned long long EvaluationCache::LayoutHash(const HospitalList& hospitals)
+{
+  unsigned long long hash = 0ULL;
+  for (HospitalList::const_iterator hospital = hospitals.begin();
+       hospital != hospitals.end();
+       ++hospital)
+  {
+    const unsigned long long place =
+      (static_cast<unsigned long long>(static_cast<unsigned int>(hospital->position.x)) << 32) |
+      static_cast<unsigned int>(hospital->position.y);
+    const unsigned long long fleet =
+      (static_cast<unsigned long long>(static_cast<unsigned int>(hospital->id)) << 32) |
+      static_cast<unsigned int>(hospital->ambulances);
+    hash = SplitMix64(hash ^ place).Next();
+    hash = SplitMix64(hash ^ fleet).Next();
+  }
+  return hash;
+}
+
+bool EvaluationCache::SameLayout(const HospitalList& lhs, const HospitalList& rhs)
+{
+  if (lhs.size() != rhs.size())
+  {
+    return false;
+  }
+  for (size_t hospitalIdx = 0; hospitalIdx < lhs.size(); ++hospitalIdx)
+  {
+    const Hospital& a = lhs[hospitalIdx];
+    const Hospital& b = rhs[hospitalIdx];
+    if ((a.id != b.id) || (a.position.x != b.position.x) ||
+        (a.position.y != b.position.y) || (a.ambulances != b.ambulances))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+const EvaluationCache::Entry* EvaluationCache::Find(const HospitalList& hospitals) const
+{
+  const unsigned long long hash = LayoutHash(hospitals);
+  for (unsigned long long slotIdx = hash & m_slotMask; ;
+       slotIdx = (slotIdx + 1) & m_slotMask)
+  {
+    const Slot& slot = m_slots[static_cast<size_t>(slotIdx)];
+    int ready;
+#pragma omp atomic read
+    ready = slot.ready;
+    // Slots fill in probe order, so an empty slot ends the search.
+    if (!ready)
+    {
+      return NULL;
+    }
+#pragma omp flush
+    if ((slot.hash == hash) && SameLayout(slot.entry->hospitals, hospitals))
+    {
+      return slot.entry;
+    }
+  }
+}
+
+bool EvaluationCache::Insert(const HospitalList& hospitals, const int rescued,
+                             const ActionSequenceList& actionSequences)
+{
+  const unsigned long long hash = LayoutHash(hospitals);
+  const size_t entryBytes = sizeof(Entry) +
+                            (hospitals.size() * sizeof(Hospital)) +
+                            ((actionSequences.Size() + 1) * sizeof(int)) +
+                            (actionSequences.NumStops() * sizeof(ActionNode));
+  bool inserted = false;
+#pragma omp critical(EvaluationCacheInsert)
+  {
+    if ((m_size < m_maxEntries) && ((m_bytes + entryBytes) <= m_maxBytes))
+    {
+      unsigned long long slotIdx = hash & m_slotMask;
+      bool found = false;
+      for (; m_slots[static_cast<size_t>(slotIdx)].ready;
+           slotIdx = (slotIdx + 1) & m_slotMask)
+      {
+        const Slot& slot = m_slots[static_cast<size_t>(slotIdx)];
+        if ((slot.hash == hash) && SameLayout(slot.entry->hospitals, hospitals))
+        {
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+      {
+        Slot& slot = m_slots[static_cast<size_t>(slotIdx)];
+        Entry* entry = new Entry;
+        entry->hospitals = hospitals;
+        entry->rescued = rescued;
+        entry->actionSequences = actionSequences;
+        slot.hash = hash;
+        slot.entry = entry;
+        // Publish the entry only once it is written.
+#pragma omp flush
+#pragma omp atomic write
+        slot.ready = 1;
+        ++m_size;
+        m_bytes += entryBytes;
+        inserted = true;
+      }
+    }
+  }
+  return inserted;
+}
+
+}
+}
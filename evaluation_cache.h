@@ -0,0 +1,99 @@
+#ifndef _HPS_AMBULANCE_EVALUATION_CACHE_H_
+#define _HPS_AMBULANCE_EVALUATION_CACHE_H_
+#include "ambulance_core.h"
+#include <vector>
+#include <cstddef>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Rescues already found for hospital layouts. </summary>
+/// <remarks>
+///   <para> A layout is the id, position and ambulances of each hospital in
+///     order. Each entry keeps the rescued count and the routes found for a
+///     layout, so a search that meets the layout again may take them without
+///     running anything.
+///   </para>
+///   <para> Entries live in an open addressing table that is made once and
+///     never grows, and an entry never changes once it is in. Find() takes
+///     no lock: a slot is read only after its ready flag is seen, and the
+///     flag is set after the entry is written. Insert() takes a lock, which
+///     is cheap since each insert follows a full rescue run.
+///   </para>
+///   <para> The table holds at most maxEntries entries of at most maxBytes
+///     in all. Inserts past either bound are dropped, so the first layouts
+///     found stay.
+///   </para>
+/// </remarks>
+class EvaluationCache
+{
+public:
+  enum { DefaultMaxBytes = 64 << 20, };
+
+  /// <summary> An immutable result for one layout. </summary>
+  struct Entry
+  {
+    HospitalList hospitals;
+    int rescued;
+    ActionSequenceList actionSequences;
+  };
+
+  EvaluationCache(const int maxEntries, const size_t maxBytes);
+  ~EvaluationCache();
+
+  /// <summary> Get the entry for a layout, or NULL. </summary>
+  /// <remarks>
+  ///   <para> May be called by any thread at any time. The entry lives as
+  ///     long as the cache.
+  ///   </para>
+  /// </remarks>
+  const Entry* Find(const HospitalList& hospitals) const;
+
+  /// <summary> Keep the result of a layout. </summary>
+  /// <returns> True when the entry was added. </returns>
+  bool Insert(const HospitalList& hospitals, const int rescued,
+              const ActionSequenceList& actionSequences);
+
+  inline int Size() const
+  {
+    return m_size;
+  }
+
+  inline size_t Bytes() const
+  {
+    return m_bytes;
+  }
+
+  /// <summary> Hash of hospital ids, places and ambulances in order. </summary>
+  static unsigned long long LayoutHash(const HospitalList& hospitals);
+
+  /// <summary> Check if two lists of hospitals are the same layout. </summary>
+  static bool SameLayout(const HospitalList& lhs, const HospitalList& rhs);
+
+private:
+  struct Slot
+  {
+    int ready;
+    unsigned long long hash;
+    Entry* entry;
+  };
+
+  // Not copyable.
+  EvaluationCache(const EvaluationCache&);
+  EvaluationCache& operator=(const EvaluationCache&);
+
+  std::vector<Slot> m_slots;
+  unsigned long long m_slotMask;
+  int m_maxEntries;
+  size_t m_maxBytes;
+  int m_size;
+  size_t m_bytes;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_EVALUATION_CACHE_H_
@@ -0,0 +1,106 @@
+#ifndef _HPS_AMBULANCE_EVALUATION_CACHE_GTEST_H_
+#define _HPS_AMBULANCE_EVALUATION_CACHE_GTEST_H_
+#include "evaluation_cache.h"
+#include "greedy.h"
+#include "data_file.h"
+#include "validate_gtest.h"
+#include "gtest/gtest.h"
+#include <omp.h>
+
+namespace _hps_ambulance_evaluation_cache_gtest_h_
+{
+using namespace hps;
+
+TEST(FindInsert, evaluation_cache)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { NumLayouts = 8, };
+
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  RandEngine rng(15ULL);
+  std::vector<HospitalList> layouts(NumLayouts);
+  std::vector<int> rescued(NumLayouts);
+  std::vector<ActionSequenceList> routes(NumLayouts);
+  for (int layoutIdx = 0; layoutIdx < NumLayouts; ++layoutIdx)
+  {
+    RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng,
+                 &layouts[layoutIdx]);
+    GreedyRescue::Run(victims, layouts[layoutIdx], &routes[layoutIdx],
+                      &rescued[layoutIdx]);
+  }
+  EvaluationCache cache(NumLayouts, EvaluationCache::DefaultMaxBytes);
+  EXPECT_TRUE(NULL == cache.Find(layouts.front()));
+  // Threads insert and read at once. Each layout goes in once.
+  int numInserted = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:numInserted)
+  for (int insertIdx = 0; insertIdx < 4 * NumLayouts; ++insertIdx)
+  {
+    const int layoutIdx = insertIdx % NumLayouts;
+    numInserted += cache.Insert(layouts[layoutIdx], rescued[layoutIdx],
+                                routes[layoutIdx]) ? 1 : 0;
+    const EvaluationCache::Entry* entry = cache.Find(layouts[layoutIdx]);
+    EXPECT_TRUE(NULL != entry);
+    if (entry)
+    {
+      EXPECT_EQ(rescued[layoutIdx], entry->rescued);
+    }
+  }
+  EXPECT_EQ(static_cast<int>(NumLayouts), numInserted);
+  EXPECT_EQ(static_cast<int>(NumLayouts), cache.Size());
+  for (int layoutIdx = 0; layoutIdx < NumLayouts; ++layoutIdx)
+  {
+    const EvaluationCache::Entry* entry = cache.Find(layouts[layoutIdx]);
+    ASSERT_TRUE(NULL != entry);
+    EXPECT_EQ(rescued[layoutIdx], entry->rescued);
+    ASSERT_EQ(routes[layoutIdx].NumStops(), entry->actionSequences.NumStops());
+    ASSERT_EQ(routes[layoutIdx].Size(), entry->actionSequences.Size());
+  }
+  // Any change to a hospital makes another layout.
+  HospitalList moved = layouts.front();
+  ++moved.front().position.x;
+  EXPECT_TRUE(NULL == cache.Find(moved));
+  HospitalList refleeted = layouts.front();
+  ++refleeted.back().ambulances;
+  EXPECT_TRUE(NULL == cache.Find(refleeted));
+  // The cache is full.
+  EXPECT_FALSE(cache.Insert(moved, 0, routes.front()));
+}
+
+TEST(MaxBytes, evaluation_cache)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { MaxEntries = 16, };
+
+  HospitalAmbulanceList hospitalAmbulances(5, 3);
+  RandEngine rng(16ULL);
+  ActionSequenceList routes;
+  routes.AddRoute();
+  for (int stop = 0; stop < 100; ++stop)
+  {
+    routes.AddStop(ActionNode(1, ActionNode::StopType_Hospital));
+  }
+  HospitalList layout;
+  RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &layout);
+  // Find the size of one entry, then allow two.
+  size_t entryBytes;
+  {
+    EvaluationCache cache(MaxEntries, EvaluationCache::DefaultMaxBytes);
+    ASSERT_TRUE(cache.Insert(layout, 1, routes));
+    entryBytes = cache.Bytes();
+  }
+  EvaluationCache cache(MaxEntries, 2 * entryBytes);
+  int numInserted = 0;
+  for (int layoutIdx = 0; layoutIdx < MaxEntries; ++layoutIdx)
+  {
+    RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &layout);
+    numInserted += cache.Insert(layout, layoutIdx, routes) ? 1 : 0;
+  }
+  EXPECT_EQ(2, numInserted);
+  EXPECT_LE(cache.Bytes(), 2 * entryBytes);
+}
+
+}
+
+#endif //_HPS_AMBULANCE_EVALUATION_CACHE_GTEST_H_
@@ -1,6 +1,7 @@
 #ifndef _HPS_ABULANCE_GREEDY_H_
 #define _HPS_ABULANCE_GREEDY_H_
 #include "greedy_base.h"
+#include "antcolony.h"
 #include "ambulance_core.h"
 #include <vector>
 #include <algorithm>
@@ -16,6 +17,7 @@ struct GreedyRescue
   struct ManhattanDistInverseTTLScore
   {
     typedef float result_type;
+    enum { HasLowerBound = 1, };
     inline float operator()(const Point& a, const Victim& b)
     {
 //      const float dist = static_cast<float>(ManhattanDistance(a, b.position));
@@ -24,6 +26,17 @@ struct GreedyRescue
       const float timeMult = static_cast<float>(b.timeToLive);
       return dist * timeMult * timeMult;
     }
+    inline float LowerBound(const int distance, const int minTimeToLive) const
+    {
+      const float dist = static_cast<float>(distance);
+      const float timeMult = static_cast<float>(minTimeToLive);
+      return dist * timeMult * timeMult;
+    }
+    inline void ScoreBlock(const Point& a, const VictimBlock& block,
+                           float* scores) const
+    {
+      DistanceTimeSquaredKernel(a, block, scores);
+    }
   };
   inline static void Run(const VictimList& victims,
                          const HospitalList& hospitals,
@@ -35,38 +48,44 @@ struct GreedyRescue
     detail::GreedyBase::Run(victims, hospitals, &scoreFunc,
                             actionSequences, rescued);
   }
+  typedef GreedyWorkspace<ManhattanDistInverseTTLScore> Workspace;
+  /// <summary> Run using the caller's workspace. </summary>
+  /// <remarks>
+  ///   <para> See detail::GreedyBase::Run() for abandonAtMost. </para>
+  /// </remarks>
+  inline static void Run(const VictimList& victims,
+                         const HospitalList& hospitals,
+                         Workspace* workspace,
+                         ActionSequenceList* actionSequences,
+                         int* rescued,
+                         const int abandonAtMost = -1)
+  {
+    ManhattanDistInverseTTLScore scoreFunc;
+    detail::GreedyBase::Run(victims, hospitals, &scoreFunc, workspace,
+                            actionSequences, rescued, abandonAtMost);
+  }
 };
 
 /// <summary> Ant colony optimization using greedy backend. </summary>
+/// <remarks>
+///   <para> See AntColony. Callers that run the colony many times or want
+///     its pheromone should keep an AntColony of their own.
+///   </para>
+/// </remarks>
 struct AntColonyRescue
 {
-  /// <summary> Score using implicit interface of ScoreFunc. </summary>
-  struct AntColonyScore
-  {
-    typedef float result_type;
-    inline float operator()(const Point& a, const Victim& b)
-    {
-      return 1.0f;
-    }
-    // reissb -- 20111018 -- Place pointers to edge matrices, etc in here.
-    //   These may be input params to Run() if you think that the client
-    //   would like to inspect them.
-  };
+  typedef AntColony::Score AntColonyScore;
 
-  static void Run(const VictimList& victims,
-                  const HospitalList& hospitals,
-                  ActionSequenceList* actionSequences)
+  static int Run(const VictimList& victims,
+                 const HospitalList& hospitals,
+                 const AntColony::Settings& settings,
+                 const unsigned long long seed,
+                 const Deadline& deadline,
+                 ActionSequenceList* actionSequences)
   {
-    // reissb -- 20111018 -- Place special logic wrapping greedy here.
-    //   This should call greedy to run the ants using the proper
-    //   scoring function.
-    //
-    //   This should go into greedy.cpp.
-    //
-    //   1) Initialize weights.
-    //   2) Run greedy (ants) for N ants.
-    //   3) Find best ant and update scoring.
-    //   4) While there are still iterations, repeat 2-3.
+    AntColony antColony;
+    return antColony.Run(victims, hospitals, settings, seed, deadline,
+                         actionSequences);
   }
 };
 
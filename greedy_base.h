@@ -1,5 +1,9 @@
 #ifndef _HPS_AMBULANCE_GREEDY_BASE_H_
 #define _HPS_AMBULANCE_GREEDY_BASE_H_
+#include "victim_grid.h"
+#include "score_kernels.h"
+#include "sim_timeline.h"
+#include "combination.h"
 #include <limits>
 #include <algorithm>
 
@@ -12,17 +16,71 @@ namespace ambulance
 struct ManhattanDistanceScore
 {
   typedef int result_type;
+  enum { HasLowerBound = 1, };
   template <typename HasPositionType>
   inline int operator()(const Point& a, const HasPositionType& b) const
   {
     return ManhattanDistance(a, b.position);
   }
+  inline int LowerBound(const int distance, const int) const
+  {
+    return distance;
+  }
+  inline void ScoreBlock(const Point& a, const VictimBlock& block,
+                         int* scores) const
+  {
+    ManhattanDistanceKernel(a, block, scores);
+  }
 };
 
+/// <summary> Score a block one victim at a time through operator(). </summary>
+/// <remarks>
+///   <para> For score functions without a batch kernel. </para>
+/// </remarks>
+template <typename ScoreFunc>
+inline void ScoreBlockEach(ScoreFunc* scoreFunc, const Point& from,
+                           const VictimBlock& block,
+                           typename ScoreFunc::result_type* scores)
+{
+  Victim victim;
+  for (int entry = 0; entry < block.count; ++entry)
+  {
+    victim.position = Point(block.x[entry], block.y[entry]);
+    victim.timeToLive = block.timeToLive[entry];
+    scores[entry] = (*scoreFunc)(from, victim);
+  }
+}
+
+template <typename ScoreFunc>
+struct GreedyWorkspace;
+
 namespace detail
 {
 
 /// <summary> The core logic for greedy algorithms. </summary>
+/// <remarks>
+///   <para> Each dispatch picks the bleeding victim with the least score that
+///     may still be saved. The implicit interface of ScoreFunc is:
+///       typedef result_type;
+///       result_type operator()(const Point& from, const Victim& victim);
+///       void ScoreBlock(const Point& from, const VictimBlock& block,
+///                       result_type* scores);
+///       enum { HasLowerBound = 0 or 1, };
+///     ScoreBlock() must give the same scores as operator(). Score functions
+///     without a batch kernel may use ScoreBlockEach().
+///   </para>
+///   <para> GreedyBase itself scores only through ScoreBlock(). A score with
+///     HasLowerBound = 0 that needs the block's victim indices or draws
+///     random scores, such as AntColony::Score, may leave out operator()
+///     rather than give one that disagrees with ScoreBlock().
+///   </para>
+///   <para> Score functions with HasLowerBound = 1 also provide
+///       result_type LowerBound(int distance, int minTimeToLive) const;
+///     which is the least score of any victim at least distance away that
+///     lives at least until minTimeToLive. Candidates for these are found
+///     through a VictimGrid by distance instead of by ranking every victim.
+///   </para>
+/// </remarks>
 struct GreedyBase
 {
   template <typename ScoreFunc>
@@ -31,29 +89,27 @@ struct GreedyBase
                   ScoreFunc* scoreFunc,
                   ActionSequenceList* actionSequences,
                   int* rescued);
-};
 
-/// <summary> Records for sorting ambulances by simulation time. </summary>
-struct AmbulanceMinHeapRecord
-{
-  AmbulanceMinHeapRecord() : ambulance(NULL), actionSequence(NULL) {}
-  AmbulanceMinHeapRecord(SimAmbulance* ambulance_,
-                         ActionSequence* actionSequence_)
-   : ambulance(ambulance_),
-     actionSequence(actionSequence_)
-  {}
-  SimAmbulance* ambulance;
-  ActionSequence* actionSequence;
-};
-
-/// <summary> Sort order for ambulance min heap. </summary>
-struct AmbulanceMinHeapOrder
-{
-  inline bool operator()(const AmbulanceMinHeapRecord& lhs,
-                         const AmbulanceMinHeapRecord& rhs) const
-  {
-    return lhs.ambulance->simTime > rhs.ambulance->simTime;
-  }
+  /// <summary> Run using the caller's workspace. </summary>
+  /// <remarks>
+  ///   <para> Callers that run many hospital configurations keep one
+  ///     workspace per thread. Once its buffers and those of actionSequences
+  ///     have grown to fit, a run makes no heap allocations.
+  ///   </para>
+  ///   <para> The run is abandoned once the rescued count plus the victims
+  ///     still bleeding is at most abandonAtMost, since it can then rescue
+  ///     no more than that. An abandoned run leaves partial routes and a
+  ///     rescued count of at most abandonAtMost.
+  ///   </para>
+  /// </remarks>
+  template <typename ScoreFunc>
+  static void Run(const VictimList& victims,
+                  const HospitalList& hospitals,
+                  ScoreFunc* scoreFunc,
+                  GreedyWorkspace<ScoreFunc>* workspace,
+                  ActionSequenceList* actionSequences,
+                  int* rescued,
+                  const int abandonAtMost = -1);
 };
 
 /// <summary> Remove edges to non-bleeding victims. </summary>
@@ -79,37 +135,6 @@ struct MakePointer
   inline AnyType* operator()(AnyType& obj) const { return &obj; }
 };
 
-/// <summary> Check if victim is still bleeding at the given time. </summary>
-struct UpdateNotBleedingAtSimTime
-{
-  UpdateNotBleedingAtSimTime(const int simTime_) : simTime(simTime_) {}
-  inline bool operator()(SimVictim* simVictim) const
-  {
-    switch (simVictim->simStatus)
-    {
-    case SimVictim::Status_Bleeding:
-      {
-        if (simVictim->timeToLive <= simTime)
-        {
-          simVictim->simStatus = SimVictim::Status_Expired;
-          return true;
-        }
-        else
-        {
-          return false;
-        }
-      }
-    case SimVictim::Status_Rescued:
-    case SimVictim::Status_Expired:
-      return true;
-    default:
-      assert(false && "Case not covered.");
-      return true;
-    }
-  }
-  int simTime;
-};
-
 /// <summary> Find object with best score near a given point. </summary>
 template <typename HasPositionType, typename ScoreFunc>
 struct ForEachFindBestScore
@@ -171,31 +196,460 @@ private:
   ForEachFindBestScoreBleeding& operator=(const ForEachFindBestScoreBleeding&);
 };
 
-/// <summary> Create a pair to rank victims by score. </summary>
-template <typename ScoreFunc>
-struct VictimRankGenerator
+/// <summary> Victim indices ranked by score and ordered lazily from the best. </summary>
+/// <remarks>
+///   <para> Only a head of the records is kept sorted. Reading past the head
+///     doubles it with nth_element() followed by a sort of the new part.
+///     Callers that stop at the first acceptable record, such as a search for
+///     the first feasible pickup, pay near O(n) rather than O(n log n).
+///   </para>
+/// </remarks>
+template <typename ScoreType>
+class LazyRankedList
 {
-  typedef typename ScoreFunc::result_type ScoreType;
-  VictimRankGenerator(const Point& point_, ScoreFunc* scoreFunc_)
-    : point(point_),
-      scoreFunc(scoreFunc_)
+public:
+  typedef std::pair<ScoreType, int> RankPair;
+  enum { InitialHeadSize = 8, };
+
+  LazyRankedList() : m_scores(), m_records(), m_sortedEnd(0) {}
+
+  /// <summary> Rank a block of victims by score from a point. </summary>
+  template <typename ScoreFunc>
+  void Rank(const Point& from, const VictimBlock& block, ScoreFunc* scoreFunc)
+  {
+    m_records.resize(block.count);
+    m_sortedEnd = 0;
+    if (0 == block.count)
+    {
+      return;
+    }
+    m_scores.resize(block.count);
+    scoreFunc->ScoreBlock(from, block, &m_scores[0]);
+    for (int entry = 0; entry < block.count; ++entry)
+    {
+      m_records[entry] = std::make_pair(m_scores[entry], block.victimIdx[entry]);
+    }
+  }
+
+  inline int Size() const
+  {
+    return static_cast<int>(m_records.size());
+  }
+
+  /// <summary> Get the record of the given rank. </summary>
+  inline const RankPair& operator[](const int rank)
+  {
+    assert(rank < Size());
+    if (rank >= m_sortedEnd)
+    {
+      WidenHead(rank);
+    }
+    return m_records[rank];
+  }
+
+private:
+  /// <summary> Sort the head far enough to include rank. </summary>
+  void WidenHead(const int rank)
+  {
+    int headSize = std::max(static_cast<int>(InitialHeadSize), 2 * m_sortedEnd);
+    headSize = std::max(headSize, rank + 1);
+    headSize = std::min(headSize, Size());
+    typename std::vector<RankPair>::iterator sortedEnd =
+      m_records.begin() + m_sortedEnd;
+    typename std::vector<RankPair>::iterator headEnd =
+      m_records.begin() + headSize;
+    if (headEnd != m_records.end())
+    {
+      std::nth_element(sortedEnd, headEnd - 1, m_records.end());
+    }
+    std::sort(sortedEnd, headEnd);
+    m_sortedEnd = headSize;
+  }
+
+  std::vector<ScoreType> m_scores;
+  std::vector<RankPair> m_records;
+  int m_sortedEnd;
+};
+
+/// <summary> Bleeding victims packed for batch scoring. </summary>
+class BleedingVictimList
+{
+public:
+  BleedingVictimList()
+    : m_victimIdx(),
+      m_x(),
+      m_y(),
+      m_timeToLive()
   {}
-  typedef std::pair<ScoreType, SimVictim*> RankPair;
-  inline RankPair operator()(SimVictim* victim) const
+
+  /// <summary> Take every bleeding victim in the store. </summary>
+  void Assign(const SimVictimStore& simVictims)
   {
-    if (SimVictim::Status_Bleeding == victim->simStatus)
+    m_victimIdx.clear();
+    m_x.clear();
+    m_y.clear();
+    m_timeToLive.clear();
+    for (int victimIdx = 0; victimIdx < simVictims.Size(); ++victimIdx)
     {
-      return std::make_pair((*scoreFunc)(point, *victim), victim);
+      if (simVictims.IsBleeding(victimIdx))
+      {
+        m_victimIdx.push_back(victimIdx);
+        m_x.push_back(simVictims.x[victimIdx]);
+        m_y.push_back(simVictims.y[victimIdx]);
+        m_timeToLive.push_back(simVictims.timeToLive[victimIdx]);
+      }
+    }
+  }
+
+  /// <summary> Drop every victim who is no longer bleeding. </summary>
+  void Compact(const SimVictimStore& simVictims)
+  {
+    int keep = 0;
+    for (int entry = 0; entry < Size(); ++entry)
+    {
+      if (simVictims.IsBleeding(m_victimIdx[entry]))
+      {
+        m_victimIdx[keep] = m_victimIdx[entry];
+        m_x[keep] = m_x[entry];
+        m_y[keep] = m_y[entry];
+        m_timeToLive[keep] = m_timeToLive[entry];
+        ++keep;
+      }
+    }
+    m_victimIdx.resize(keep);
+    m_x.resize(keep);
+    m_y.resize(keep);
+    m_timeToLive.resize(keep);
+  }
+
+  inline int Size() const
+  {
+    return static_cast<int>(m_victimIdx.size());
+  }
+
+  inline bool Empty() const
+  {
+    return m_victimIdx.empty();
+  }
+
+  /// <summary> All of the victims as one block. </summary>
+  inline VictimBlock Block() const
+  {
+    VictimBlock block;
+    block.count = Size();
+    block.x = block.count ? &m_x[0] : NULL;
+    block.y = block.count ? &m_y[0] : NULL;
+    block.timeToLive = block.count ? &m_timeToLive[0] : NULL;
+    block.victimIdx = block.count ? &m_victimIdx[0] : NULL;
+    return block;
+  }
+
+private:
+  std::vector<int> m_victimIdx;
+  std::vector<int> m_x;
+  std::vector<int> m_y;
+  std::vector<int> m_timeToLive;
+};
+
+/// <summary> Check if a victim may join a trip without anyone dying. </summary>
+/// <remarks>
+///   <para> On success, the time to drive to and load the victim and the
+///     hospital and time to return from the victim are kept.
+///   </para>
+/// </remarks>
+struct FeasiblePickup
+{
+  FeasiblePickup(const HospitalList& hospitals_,
+                 const NearestHospitalTable& nearestHospitals_,
+                 const SimVictimStore& simVictims_,
+                 const Point& position_,
+                 const int pickupTime_,
+                 const int mostCriticalVictimTime_)
+    : hospitals(&hospitals_),
+      nearestHospitals(&nearestHospitals_),
+      simVictims(&simVictims_),
+      position(position_),
+      pickupTime(pickupTime_),
+      mostCriticalVictimTime(mostCriticalVictimTime_),
+      pickupThisVictimTime(0),
+      returnFromVictimTime(0),
+      returnHospital(NULL)
+  {}
+
+  inline bool operator()(const int victimIdx)
+  {
+    const NearestHospitalTable::Entry& bestHospital =
+      (*nearestHospitals)[victimIdx];
+    // Estimated time to pickup.
+    const int victimDist = ManhattanDistance(position,
+                                             simVictims->Position(victimIdx));
+    const int pickupVictimTime = VictimLoadTime +
+                                 (victimDist * DriveOneBlockTime);
+    const int hospitalDist = bestHospital.distance;
+    const int returnTime = VictimUnloadTime +
+                           (hospitalDist * DriveOneBlockTime);
+    // See if this victim will make it.
+    const int newRouteTime = pickupTime + pickupVictimTime + returnTime;
+    // Can we pick this fella up?
+    if ((newRouteTime <= simVictims->timeToLive[victimIdx]) &&
+        (newRouteTime <= mostCriticalVictimTime))
+    {
+      pickupThisVictimTime = pickupVictimTime;
+      returnFromVictimTime = returnTime;
+      returnHospital = &(*hospitals)[bestHospital.hospitalIdx];
+      return true;
     }
     else
     {
-      return std::make_pair(std::numeric_limits<ScoreType>::max(), victim);
+      return false;
     }
   }
-  Point point;
-  ScoreFunc* scoreFunc;
+
+  /// <summary> Least time to live of any victim that may join at distance. </summary>
+  inline int MinTimeToLive(const int distance) const
+  {
+    return pickupTime + VictimLoadTime + (distance * DriveOneBlockTime) +
+           VictimUnloadTime;
+  }
+
+  const HospitalList* hospitals;
+  const NearestHospitalTable* nearestHospitals;
+  const SimVictimStore* simVictims;
+  Point position;
+  int pickupTime;
+  int mostCriticalVictimTime;
+  int pickupThisVictimTime;
+  int returnFromVictimTime;
+  const Hospital* returnHospital;
+};
+
+/// <summary> Put the victims of a trip in the order that returns first. </summary>
+/// <remarks>
+///   <para> Every passenger rides until the trip ends at a hospital, so all
+///     orders share one deadline: the least time to live aboard. The order
+///     that returns first is then the best one, and its best hospital is the
+///     one nearest to the last pickup. A trip holds at most four victims, so
+///     every order is walked from a permutation table with legs read from a
+///     small matrix. Ties keep the order the victims were picked.
+///   </para>
+/// </remarks>
+struct TripOrder
+{
+  enum { MaxStops = 4, };
+
+  /// <summary> Reorder the stops in place. </summary>
+  /// <returns> Time from leaving start to unloading at the hospital. </returns>
+  static int Run(const SimVictimStore& simVictims,
+                 const NearestHospitalTable& nearestHospitals,
+                 const Point& start, const int numStops, int* stops)
+  {
+    assert(stops && (numStops > 0) && (numStops <= MaxStops));
+    static const PermutationTable s_permutations[MaxStops + 1] =
+    {
+      PermutationTable(0), PermutationTable(1), PermutationTable(2),
+      PermutationTable(3), PermutationTable(4),
+    };
+    // Legs between stops, with start as stop numStops.
+    int leg[MaxStops + 1][MaxStops];
+    int returnLeg[MaxStops];
+    for (int to = 0; to < numStops; ++to)
+    {
+      const Point toPosition = simVictims.Position(stops[to]);
+      for (int from = 0; from < numStops; ++from)
+      {
+        leg[from][to] = VictimLoadTime +
+                        (ManhattanDistance(simVictims.Position(stops[from]),
+                                           toPosition) * DriveOneBlockTime);
+      }
+      leg[numStops][to] = VictimLoadTime +
+                          (ManhattanDistance(start, toPosition) *
+                           DriveOneBlockTime);
+      returnLeg[to] = VictimUnloadTime +
+                      (nearestHospitals[stops[to]].distance * DriveOneBlockTime);
+    }
+    // Time every order.
+    const PermutationTable& permutations = s_permutations[numStops];
+    int bestTime = std::numeric_limits<int>::max();
+    unsigned long long bestOrder = 0;
+    for (unsigned long long m = 0; m < permutations.GetPermutationCount(); ++m)
+    {
+      const unsigned char* order = permutations[m];
+      int time = leg[numStops][order[0]] + returnLeg[order[numStops - 1]];
+      for (int stop = 1; stop < numStops; ++stop)
+      {
+        time += leg[order[stop - 1]][order[stop]];
+      }
+      const bool better = time < bestTime;
+      bestTime = better ? time : bestTime;
+      bestOrder = better ? m : bestOrder;
+    }
+    int ordered[MaxStops];
+    const unsigned char* order = permutations[bestOrder];
+    for (int stop = 0; stop < numStops; ++stop)
+    {
+      ordered[stop] = stops[order[stop]];
+    }
+    std::copy(ordered, ordered + numStops, stops);
+    return bestTime;
+  }
 };
 
+/// <summary> Find the feasible pickup with the best score. </summary>
+/// <remarks>
+///   <para> Find() returns the victim index, or -1 if nobody may be picked
+///     up. Ties in score go to the earliest victim. The specializations
+///     differ in how they find candidates, not in what they find.
+///   </para>
+/// </remarks>
+template <typename ScoreFunc, int HasLowerBound>
+class BestPickupFinder;
+
+/// <summary> Find the best pickup by ranking every bleeding victim. </summary>
+template <typename ScoreFunc>
+class BestPickupFinder<ScoreFunc, 0>
+{
+public:
+  inline void Init(const SimVictimStore& simVictims)
+  {
+    m_bleedingVictims.Assign(simVictims);
+  }
+
+  int Find(ScoreFunc* scoreFunc, FeasiblePickup* feasible)
+  {
+    // Rank all victims based on score. Only as many as are needed to find
+    // a feasible pickup are put in order.
+    m_bleedingVictims.Compact(*feasible->simVictims);
+    m_rankVictims.Rank(feasible->position, m_bleedingVictims.Block(),
+                       scoreFunc);
+    for (int rankIdx = 0; rankIdx < m_rankVictims.Size(); ++rankIdx)
+    {
+      const int victimIdx = m_rankVictims[rankIdx].second;
+      if ((*feasible)(victimIdx))
+      {
+        return victimIdx;
+      }
+    }
+    return -1;
+  }
+
+private:
+  BleedingVictimList m_bleedingVictims;
+  LazyRankedList<typename ScoreFunc::result_type> m_rankVictims;
+};
+
+/// <summary> Find the best pickup by searching outward through a grid. </summary>
+/// <remarks>
+///   <para> Rings of grid cells are scored into a min heap. A candidate is
+///     popped only when its score beats the lower bound of every victim not
+///     yet seen, so the first feasible one popped is the best.
+///   </para>
+/// </remarks>
+template <typename ScoreFunc>
+class BestPickupFinder<ScoreFunc, 1>
+{
+public:
+  typedef typename ScoreFunc::result_type ScoreType;
+  typedef std::pair<ScoreType, int> RankPair;
+
+  inline void Init(const SimVictimStore& simVictims)
+  {
+    m_grid.Build(simVictims);
+  }
+
+  int Find(ScoreFunc* scoreFunc, FeasiblePickup* feasible)
+  {
+    const Point& position = feasible->position;
+    m_candidates.clear();
+    PushCandidates pushCandidates(position, scoreFunc, &m_scores,
+                                  &m_candidates);
+    const int maxRing = m_grid.MaxRing(position);
+    for (int ring = 0; ring <= maxRing; ++ring)
+    {
+      m_grid.VisitRing(position, ring, pushCandidates);
+      // Least score of any feasible victim further out.
+      ScoreType bound = std::numeric_limits<ScoreType>::max();
+      if (ring < maxRing)
+      {
+        const int distance = m_grid.RingLowerBound(position, ring + 1);
+        bound = scoreFunc->LowerBound(distance,
+                                      feasible->MinTimeToLive(distance));
+      }
+      while (!m_candidates.empty() &&
+             ((m_candidates.front().first < bound) || (ring == maxRing)))
+      {
+        const int victimIdx = m_candidates.front().second;
+        std::pop_heap(m_candidates.begin(), m_candidates.end(),
+                      std::greater<RankPair>());
+        m_candidates.pop_back();
+        if ((*feasible)(victimIdx))
+        {
+          return victimIdx;
+        }
+      }
+    }
+    return -1;
+  }
+
+private:
+  /// <summary> Score blocks of victims into the candidate min heap. </summary>
+  struct PushCandidates
+  {
+    PushCandidates(const Point& point_, ScoreFunc* scoreFunc_,
+                   std::vector<ScoreType>* scores_,
+                   std::vector<RankPair>* candidates_)
+      : point(point_),
+        scoreFunc(scoreFunc_),
+        scores(scores_),
+        candidates(candidates_)
+    {}
+    inline void operator()(const VictimBlock& block)
+    {
+      scores->resize(block.count);
+      scoreFunc->ScoreBlock(point, block, &(*scores)[0]);
+      for (int entry = 0; entry < block.count; ++entry)
+      {
+        candidates->push_back(std::make_pair((*scores)[entry],
+                                             block.victimIdx[entry]));
+        std::push_heap(candidates->begin(), candidates->end(),
+                       std::greater<RankPair>());
+      }
+    }
+    Point point;
+    ScoreFunc* scoreFunc;
+    std::vector<ScoreType>* scores;
+    std::vector<RankPair>* candidates;
+  };
+
+  VictimGrid m_grid;
+  std::vector<ScoreType> m_scores;
+  std::vector<RankPair> m_candidates;
+};
+
+}
+
+/// <summary> Buffers for detail::GreedyBase::Run() kept between runs. </summary>
+/// <remarks>
+///   <para> Every run resets the workspace, so nothing carries over from one
+///     run to the next but the capacity of its buffers.
+///   </para>
+/// </remarks>
+template <typename ScoreFunc>
+struct GreedyWorkspace
+{
+  typedef detail::BestPickupFinder<ScoreFunc, ScoreFunc::HasLowerBound>
+    PickupFinder;
+  SimVictimStore simVictims;
+  ExpiryIndex expiryIndex;
+  PickupFinder pickupFinder;
+  NearestHospitalTable nearestHospitals;
+  SimAmbulanceList simAmbulances;
+  CalendarQueue<int> ambulanceQueue;
+  ActionSequenceBuilder routes;
+};
+
+namespace detail
+{
+
 template <typename ScoreFunc>
 void GreedyBase::Run(const VictimList& victims,
                      const HospitalList& hospitals,
@@ -203,15 +657,20 @@ void GreedyBase::Run(const VictimList& victims,
                      ActionSequenceList* actionSequences,
                      int* rescued)
 {
-  assert(actionSequences);
+  GreedyWorkspace<ScoreFunc> workspace;
+  Run(victims, hospitals, scoreFunc, &workspace, actionSequences, rescued);
+}
 
-  typedef std::vector<detail::AmbulanceMinHeapRecord> AmbulanceHeap;
-  typedef
-    ForEachFindBestScoreBleeding<ScoreFunc>
-    BestBleedingVictimFinder;
-  typedef
-    ForEachFindBestScore<const Hospital, ManhattanDistanceScore>
-    BestHospitalFinder;
+template <typename ScoreFunc>
+void GreedyBase::Run(const VictimList& victims,
+                     const HospitalList& hospitals,
+                     ScoreFunc* scoreFunc,
+                     GreedyWorkspace<ScoreFunc>* workspace,
+                     ActionSequenceList* actionSequences,
+                     int* rescued,
+                     const int abandonAtMost)
+{
+  assert(workspace && actionSequences);
 
   // Need someone to rescue and something to pick them up.
   if (victims.empty() || hospitals.empty())
@@ -219,25 +678,32 @@ void GreedyBase::Run(const VictimList& victims,
     return;
   }
 
-  // Create simulation victims and graph.
-  SimVictimList simVictims;
-  simVictims.reserve(victims.size());
+  // Create simulation victims.
+  SimVictimStore& simVictims = workspace->simVictims;
+  simVictims.Assign(victims);
+  int bleeding = simVictims.Size();
+  ExpiryIndex& expiryIndex = workspace->expiryIndex;
+  expiryIndex.Build(simVictims);
+  typename GreedyWorkspace<ScoreFunc>::PickupFinder& pickupFinder =
+    workspace->pickupFinder;
+  pickupFinder.Init(simVictims);
+  // Hospitals do not move, so find the nearest one to each victim up front.
+  NearestHospitalTable* nearestHospitals = &workspace->nearestHospitals;
+  nearestHospitals->Build(victims, hospitals);
+  // Create all ambulances for all hospitals.
+  SimAmbulanceList& simAmbulances = workspace->simAmbulances;
+  simAmbulances.clear();
+  ActionSequenceBuilder& routes = workspace->routes;
   {
-    int victimId = 1;
-    for (VictimList::const_iterator victim = victims.begin();
-         victim != victims.end();
-         ++victim, ++victimId)
+    int numAmbulances = 0;
+    for (HospitalList::const_iterator hospital = hospitals.begin();
+         hospital != hospitals.end();
+         ++hospital)
     {
-      simVictims.push_back(SimVictim(*victim));
-      simVictims.back().id = victimId;
+      numAmbulances += hospital->ambulances;
     }
+    routes.Reset(numAmbulances);
   }
-  std::vector<SimVictim*> bleedingVictims(simVictims.size());
-  std::transform(simVictims.begin(), simVictims.end(), bleedingVictims.begin(),
-                 detail::MakePointer<SimVictim>());
-  // Create all ambulances for all hospitals.
-  SimAmbulanceList simAmbulances;
-  actionSequences->clear();
   {
     int hospitalIdx = 1;
     for (HospitalList::const_iterator hospital = hospitals.begin();
@@ -252,29 +718,40 @@ void GreedyBase::Run(const VictimList& victims,
         ambulanceIdx < hospital->ambulances;
         ++ambulanceIdx)
       {
+        routes.AddStop(static_cast<int>(simAmbulances.size()), actionNode);
         simAmbulances.push_back(SimAmbulance());
         SimAmbulance& ambulance = simAmbulances.back();
         {
           ambulance.position = hospital->position;
           ambulance.simTime = 0;
         }
-        actionSequences->push_back(ActionSequence());
-        actionSequences->back().push_back(actionNode);
       }
     }
   }
-  // Create min heap for ambulance simulation time.
+  // Queue ambulances by the time they are free. A bucket is about as wide as
+  // the gap between returns when every ambulance drives an average trip.
   const int numAmbulances = static_cast<int>(simAmbulances.size());
-  AmbulanceHeap ambulanceHeap;
-  ambulanceHeap.reserve(numAmbulances);
+  if (0 == numAmbulances)
   {
-    SimAmbulanceList::iterator ambulance = simAmbulances.begin();
-    ActionSequenceList::iterator actionSequence = actionSequences->begin();
-    for (; ambulance != simAmbulances.end(); ++ambulance, ++actionSequence)
+    routes.Build(actionSequences);
+    return;
+  }
+  CalendarQueue<int>& ambulanceQueue = workspace->ambulanceQueue;
+  {
+    long long totalTripTime = 0;
+    for (int victimIdx = 0; victimIdx < nearestHospitals->Size(); ++victimIdx)
+    {
+      totalTripTime += VictimLoadTime + VictimUnloadTime +
+                       (2 * (*nearestHospitals)[victimIdx].distance *
+                        DriveOneBlockTime);
+    }
+    const int meanTripTime =
+      static_cast<int>(totalTripTime / nearestHospitals->Size());
+    ambulanceQueue.Reset(numAmbulances,
+                         std::max(1, meanTripTime / numAmbulances));
+    for (int ambulanceIdx = 0; ambulanceIdx < numAmbulances; ++ambulanceIdx)
     {
-      assert(actionSequences->end() != actionSequence);
-      ambulanceHeap.push_back(detail::AmbulanceMinHeapRecord(&*ambulance,
-                                                             &*actionSequence));
+      ambulanceQueue.Push(0, ambulanceIdx);
     }
   }
   // reissb -- 20111018 -- The order to the heap may be randomized initially.
@@ -285,112 +762,77 @@ void GreedyBase::Run(const VictimList& victims,
   do
   {
     // Get the ambulance with the smallest time.
-    detail::AmbulanceMinHeapRecord ambulanceRecord = ambulanceHeap.front();
-    SimAmbulance* ambulance = ambulanceRecord.ambulance;
-    ActionSequence* actionSequence = ambulanceRecord.actionSequence;
-    assert(ambulance->pickedUp.empty());
-    std::pop_heap(ambulanceHeap.begin(), ambulanceHeap.end(),
-                  detail::AmbulanceMinHeapOrder());
-    ambulanceHeap.pop_back();
+    int ambulanceTime;
+    int ambulanceIdx;
+    ambulanceQueue.Pop(&ambulanceTime, &ambulanceIdx);
+    SimAmbulance* ambulance = &simAmbulances[ambulanceIdx];
+    assert(ambulance->simTime == ambulanceTime);
     // Try to pickup 4 victims.
+    const Point tripStart = ambulance->position;
+    int tripVictims[TripOrder::MaxStops];
     int pickupTime = ambulance->simTime;
-    int returnTime = 0;
-    const Hospital* returnHospital = NULL;
     int mostCritialVictimTime = std::numeric_limits<int>::max();
     int victimsPickedUp = 0;
-    typedef
-      std::vector<typename VictimRankGenerator<ScoreFunc>::RankPair>
-      RankedVictimList;
-    RankedVictimList rankVictims(bleedingVictims.size());
-    const typename ScoreFunc::result_type notBleedScore =
-      std::numeric_limits<typename ScoreFunc::result_type>::max();
-    for (; victimsPickedUp < 4; ++victimsPickedUp)
+    for (; victimsPickedUp < TripOrder::MaxStops; ++victimsPickedUp)
     {
-      // Rank all victims based on score.
-      VictimRankGenerator<ScoreFunc> rankGen(ambulance->position, scoreFunc);
-      std::transform(bleedingVictims.begin(), bleedingVictims.end(),
-                     rankVictims.begin(), rankGen);
-      std::sort(rankVictims.begin(), rankVictims.end());
-      int rankIdx = 0;
-      for (; rankIdx < static_cast<int>(rankVictims.size()); ++rankIdx)
-      {
-        if (notBleedScore == rankVictims[rankIdx].first)
-        {
-          continue;
-        }
-        SimVictim* pickupVictim = rankVictims[rankIdx].second;
-        // See if this person may be picked up without death.
-        static ManhattanDistanceScore s_manhattanScore;
-        BestHospitalFinder bestHospital =
-          std::for_each(hospitals.begin(), hospitals.end(),
-                        BestHospitalFinder(pickupVictim->position,
-                                           &s_manhattanScore));
-        // Estimated time to pickup.
-        const int victimDist = ManhattanDistance(ambulance->position,
-                                                 pickupVictim->position);
-        const int pickupThisVictimTime = VictimLoadTime +
-                                         (victimDist * DriveOneBlockTime);
-        const int hospitalDist = bestHospital.bestScore;
-        const int returnFromVictimtime = VictimUnloadTime +
-                                         (hospitalDist * DriveOneBlockTime);
-        // See if this victim will make it.
-        const int newRouteTime = pickupTime +
-                                 pickupThisVictimTime + returnFromVictimtime;
-        // Can we pick this fella up?
-        const int victimTimeToLive = pickupVictim->timeToLive;
-        if ((newRouteTime <= victimTimeToLive) &&
-            (newRouteTime <= mostCritialVictimTime))
-        {
-          // Add this victim pickup and set new return time.
-          pickupTime += pickupThisVictimTime;
-          returnTime = returnFromVictimtime;
-          mostCritialVictimTime = std::min(mostCritialVictimTime,
-                                           victimTimeToLive);
-          // Pickup victim and update ambulance positon.
-          pickupVictim->simStatus = SimVictim::Status_Rescued;
-          ++(*rescued);
-          ambulance->pickedUp.push_back(pickupVictim);
-          ambulance->position = pickupVictim->position;
-          actionSequence->push_back(ActionNode(pickupVictim->id,
-                                               ActionNode::StopType_Victim));
-          // Record hospital.
-          returnHospital = bestHospital.bestScored;
-          break;
-        }
-      }
+      // Find the best victim who may be picked up without death.
+      FeasiblePickup feasible(hospitals, *nearestHospitals, simVictims,
+                              ambulance->position, pickupTime,
+                              mostCritialVictimTime);
+      const int pickupIdx = pickupFinder.Find(scoreFunc, &feasible);
       // Did we find nobody?
-      if (rankIdx == static_cast<int>(rankVictims.size()))
+      if (pickupIdx < 0)
       {
         break;
       }
+      // Add this victim pickup.
+      pickupTime += feasible.pickupThisVictimTime;
+      mostCritialVictimTime = std::min(mostCritialVictimTime,
+                                       simVictims.timeToLive[pickupIdx]);
+      // Pickup victim and update ambulance positon.
+      simVictims.status[pickupIdx] =
+        static_cast<unsigned char>(SimVictim::Status_Rescued);
+      ++(*rescued);
+      --bleeding;
+      ambulance->position = simVictims.Position(pickupIdx);
+      tripVictims[victimsPickedUp] = pickupIdx;
     }
     // If we picked someone up, then update state.
     if (victimsPickedUp > 0)
     {
+      // Visit the victims in the order that returns first. The order they
+      // were picked in is feasible, so the best order is too.
+      const int tripTime = TripOrder::Run(simVictims, *nearestHospitals,
+                                          tripStart, victimsPickedUp,
+                                          tripVictims);
+      for (int stop = 0; stop < victimsPickedUp; ++stop)
+      {
+        routes.AddStop(ambulanceIdx, ActionNode(tripVictims[stop] + 1,
+                                                ActionNode::StopType_Victim));
+      }
       // Place ambulance at pickup hospital.
+      const Hospital* returnHospital =
+        &hospitals[(*nearestHospitals)[tripVictims[victimsPickedUp - 1]].hospitalIdx];
       ambulance->position = returnHospital->position;
-      ambulance->pickedUp.clear();
-      actionSequence->push_back(ActionNode(returnHospital->id,
-                                           ActionNode::StopType_Hospital));
+      routes.AddStop(ambulanceIdx, ActionNode(returnHospital->id,
+                                              ActionNode::StopType_Hospital));
       // Update ambulance clock only.
-      ambulance->simTime = pickupTime + returnTime;
+      ambulance->simTime += tripTime;
+      assert(ambulance->simTime <= mostCritialVictimTime);
       // Place this ambulance back into the simulation.
-      ambulanceHeap.push_back(ambulanceRecord);
-      std::push_heap(ambulanceHeap.begin(), ambulanceHeap.end(),
-                     detail::AmbulanceMinHeapOrder());
+      ambulanceQueue.Push(ambulance->simTime, ambulanceIdx);
     }
     // Update the global simulation time to the ambulance that is furthest
     // in the past.
-    if(!ambulanceHeap.empty())
+    if (!ambulanceQueue.Empty())
     {
-      const int simTime = ambulanceHeap.front().ambulance->simTime;
-      // Remove victims that are not bleeding at this time.
-      bleedingVictims.erase(std::remove_if(bleedingVictims.begin(),
-                                           bleedingVictims.end(),
-                                           detail::UpdateNotBleedingAtSimTime(simTime)),
-                            bleedingVictims.end());
+      const int simTime = ambulanceQueue.NextTime();
+      // Expire victims who died by this time.
+      bleeding -= expiryIndex.Advance(simTime, &simVictims);
     }
-  } while (!bleedingVictims.empty() && !ambulanceHeap.empty());
+  } while ((bleeding > 0) && !ambulanceQueue.Empty() &&
+           ((*rescued + bleeding) > abandonAtMost));
+  routes.Build(actionSequences);
 //  // Kill remaining victims.
 //  for (std::vector<SimVictim*>::iterator deadVictim = bleedingVictims.begin();
 //       deadVictim != bleedingVictims.end();
@@ -4,6 +4,7 @@
 #include "k-means.h"
 #include "rand_bound.h"
 #include "validate_gtest.h"
+#include "allocation_counter_gtest.h"
 #include "gtest/gtest.h"
 
 namespace _hps_ambulance_greedy_gtest_h_
@@ -42,6 +43,168 @@ TEST(RandomHospitals, Greedy)
   EXPECT_EQ(rescued, numRescued);
 }
 
+TEST(LazyRankedList, Greedy)
+{
+  enum { NumVictims = 1000, };
+  enum { MaxCoord = 100, };
+  enum { MaxTimeToLive = 200, };
+  // Random victims, some of which are no longer bleeding.
+  VictimList victims(NumVictims);
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(RandBound(MaxCoord), RandBound(MaxCoord));
+    victims[victimIdx].timeToLive = 1 + RandBound(MaxTimeToLive);
+  }
+  SimVictimStore simVictims;
+  simVictims.Assign(victims);
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    if (0 == RandBound(4))
+    {
+      simVictims.status[victimIdx] = SimVictim::Status_Rescued;
+    }
+  }
+  ambulance::detail::BleedingVictimList bleedingVictims;
+  bleedingVictims.Assign(simVictims);
+  // The lazy ranking must match a full sort of the bleeding victims.
+  typedef GreedyRescue::ManhattanDistInverseTTLScore ScoreFunc;
+  typedef ambulance::detail::LazyRankedList<float> RankedList;
+  ScoreFunc scoreFunc;
+  const Point from(MaxCoord / 2, MaxCoord / 2);
+  std::vector<RankedList::RankPair> expected;
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    if (simVictims.IsBleeding(victimIdx))
+    {
+      expected.push_back(std::make_pair(scoreFunc(from, victims[victimIdx]),
+                                        victimIdx));
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  RankedList ranked;
+  ranked.Rank(from, bleedingVictims.Block(), &scoreFunc);
+  ASSERT_EQ(static_cast<int>(expected.size()), ranked.Size());
+  for (int rank = 0; rank < ranked.Size(); ++rank)
+  {
+    EXPECT_EQ(expected[rank].second, ranked[rank].second);
+  }
+}
+
+TEST(TripOrder, Greedy)
+{
+  typedef ambulance::detail::TripOrder TripOrder;
+  enum { MaxCoord = 100, };
+  enum { NumHospitals = 3, };
+  enum { NumTrials = 200, };
+  enum { NumVictims = NumTrials * TripOrder::MaxStops, };
+  RandEngine rng(5ULL);
+  VictimList victims(NumVictims);
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    victims[victimIdx].timeToLive = 1000;
+  }
+  HospitalList hospitals(NumHospitals);
+  for (int hospitalIdx = 0; hospitalIdx < NumHospitals; ++hospitalIdx)
+  {
+    hospitals[hospitalIdx].id = hospitalIdx + 1;
+    hospitals[hospitalIdx].position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+  }
+  SimVictimStore simVictims;
+  simVictims.Assign(victims);
+  NearestHospitalTable nearestHospitals;
+  nearestHospitals.Build(victims, hospitals);
+  // Compare against trying every order with every hospital.
+  for (int trial = 0; trial < NumTrials; ++trial)
+  {
+    const int numStops = 1 + (trial % TripOrder::MaxStops);
+    const Point start(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    int stops[TripOrder::MaxStops];
+    for (int stop = 0; stop < numStops; ++stop)
+    {
+      stops[stop] = (trial * TripOrder::MaxStops) + stop;
+    }
+    std::vector<int> order(stops, stops + numStops);
+    int expectTime = std::numeric_limits<int>::max();
+    do
+    {
+      int time = 0;
+      Point position = start;
+      for (int stop = 0; stop < numStops; ++stop)
+      {
+        const Point& next = victims[order[stop]].position;
+        time += VictimLoadTime + ManhattanDistance(position, next);
+        position = next;
+      }
+      for (int hospitalIdx = 0; hospitalIdx < NumHospitals; ++hospitalIdx)
+      {
+        expectTime = std::min(expectTime, time + VictimUnloadTime +
+                              ManhattanDistance(position,
+                                                hospitals[hospitalIdx].position));
+      }
+    } while (std::next_permutation(order.begin(), order.end()));
+    const int time = TripOrder::Run(simVictims, nearestHospitals, start,
+                                    numStops, stops);
+    EXPECT_EQ(expectTime, time);
+    // The stops must be the same victims in some order.
+    std::sort(stops, stops + numStops);
+    for (int stop = 0; stop < numStops; ++stop)
+    {
+      EXPECT_EQ((trial * TripOrder::MaxStops) + stop, stops[stop]);
+    }
+  }
+}
+
+/// <summary> Score that hides its lower bound from the greedy search. </summary>
+struct RankedInverseTTLScore : public GreedyRescue::ManhattanDistInverseTTLScore
+{
+  enum { HasLowerBound = 0, };
+};
+
+TEST(GridMatchesRanking, Greedy)
+{
+  enum { NumVictims = 3000, };
+  enum { MaxCoord = 400, };
+  enum { NumHospitals = 5, };
+  RandEngine rng(3ULL);
+  VictimList victims(NumVictims);
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    victims[victimIdx].timeToLive = 20 + rng.Bound(MaxCoord);
+  }
+  HospitalList hospitals(NumHospitals);
+  for (int hospitalIdx = 0; hospitalIdx < NumHospitals; ++hospitalIdx)
+  {
+    hospitals[hospitalIdx].id = hospitalIdx + 1;
+    hospitals[hospitalIdx].position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    hospitals[hospitalIdx].ambulances = 5 + hospitalIdx;
+  }
+  // Grid search and full ranking must make the same choices.
+  ActionSequenceList gridSequences;
+  int gridRescued = 0;
+  GreedyRescue::ManhattanDistInverseTTLScore gridScore;
+  ambulance::detail::GreedyBase::Run(victims, hospitals, &gridScore,
+                                     &gridSequences, &gridRescued);
+  ActionSequenceList rankSequences;
+  int rankRescued = 0;
+  RankedInverseTTLScore rankScore;
+  ambulance::detail::GreedyBase::Run(victims, hospitals, &rankScore,
+                                     &rankSequences, &rankRescued);
+  EXPECT_EQ(rankRescued, gridRescued);
+  ASSERT_EQ(rankSequences.Size(), gridSequences.Size());
+  for (int seqIdx = 0; seqIdx < rankSequences.Size(); ++seqIdx)
+  {
+    const ActionSequence rankSequence = rankSequences[seqIdx];
+    const ActionSequence gridSequence = gridSequences[seqIdx];
+    ASSERT_EQ(rankSequence.Size(), gridSequence.Size());
+    for (int nodeIdx = 0; nodeIdx < rankSequence.Size(); ++nodeIdx)
+    {
+      EXPECT_TRUE(rankSequence[nodeIdx] == gridSequence[nodeIdx]);
+    }
+  }
+}
+
 void KMeansGreedyTest(const std::string& filename, const int iterations,
                       int* numRescued)
 {
@@ -65,7 +228,7 @@ void KMeansGreedyTest(const std::string& filename, const int iterations,
   KMeans<Point>::ClusterList clusters;
   KMeans<Point>::Run(k, iterations, 1, points,
                      std::ptr_fun(ManhattanDistance),
-                     &means, &clusters);
+                     &ThreadRandEngine(), &means, &clusters);
   // Sort clusters and hospitals based on size.
   std::vector<std::pair<size_t, int> > clusterSortList(k);
   std::vector<std::pair<int, int> > hospitalSortList(k);
@@ -161,6 +324,65 @@ TEST(KMeansHospitals, Greedy)
   }
 }
 
+/// <summary> Count allocations in runs that reuse a warm workspace. </summary>
+template <typename ScoreFunc>
+int CountSteadyStateAllocations(const VictimList& victims,
+                                const std::vector<HospitalList>& hospitalSets)
+{
+  GreedyWorkspace<ScoreFunc> workspace;
+  ActionSequenceList actionSequences;
+  ScoreFunc scoreFunc;
+  int rescued = 0;
+  // Grow every buffer to fit each hospital set.
+  for (size_t setIdx = 0; setIdx < hospitalSets.size(); ++setIdx)
+  {
+    ambulance::detail::GreedyBase::Run(victims, hospitalSets[setIdx],
+                                       &scoreFunc, &workspace,
+                                       &actionSequences, &rescued);
+  }
+  AllocationCounter::Count() = 0;
+  AllocationCounter::Enabled() = true;
+  for (size_t setIdx = 0; setIdx < hospitalSets.size(); ++setIdx)
+  {
+    ambulance::detail::GreedyBase::Run(victims, hospitalSets[setIdx],
+                                       &scoreFunc, &workspace,
+                                       &actionSequences, &rescued);
+  }
+  AllocationCounter::Enabled() = false;
+  return AllocationCounter::Count();
+}
+
+TEST(WorkspaceAllocationFree, Greedy)
+{
+  enum { NumVictims = 2000, };
+  enum { MaxCoord = 300, };
+  enum { NumHospitals = 5, };
+  enum { NumHospitalSets = 4, };
+  RandEngine rng(13ULL);
+  VictimList victims(NumVictims);
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    victims[victimIdx].timeToLive = 20 + rng.Bound(MaxCoord);
+  }
+  std::vector<HospitalList> hospitalSets(NumHospitalSets,
+                                         HospitalList(NumHospitals));
+  for (int setIdx = 0; setIdx < NumHospitalSets; ++setIdx)
+  {
+    for (int hospitalIdx = 0; hospitalIdx < NumHospitals; ++hospitalIdx)
+    {
+      Hospital& hospital = hospitalSets[setIdx][hospitalIdx];
+      hospital.id = hospitalIdx + 1;
+      hospital.position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+      hospital.ambulances = 3 + hospitalIdx;
+    }
+  }
+  EXPECT_EQ(0, CountSteadyStateAllocations<
+    GreedyRescue::ManhattanDistInverseTTLScore>(victims, hospitalSets));
+  EXPECT_EQ(0, CountSteadyStateAllocations<RankedInverseTTLScore>(
+    victims, hospitalSets));
+}
+
 }
 
 #endif //_HPS_AMBULANCE_GREEDY_GTEST_H_
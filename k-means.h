@@ -1,8 +1,10 @@
 #ifndef _HPS_AMBULANCE_KMEANS_H_
 #define _HPS_AMBULANCE_KMEANS_H_
 #include "rand_bound.h"
+#include "deadline.h"
 #include <vector>
 #include <algorithm>
+#include <utility>
 #include <functional>
 #include <numeric>
 #include <limits>
@@ -14,45 +16,863 @@ namespace hps
 namespace clustering
 {
 
-template <typename PointType>
+/// <summary> Find the closest and second closest means of a run of points. </summary>
+/// <remarks>
+///   <para> Ties go to the earliest mean. secondDist is the second least
+///     distance, equal to closestDist when two means tie. closestDist and
+///     secondDist may be NULL.
+///   </para>
+///   <para> This is the generic scan for any point type and distance. It is
+///     specialized where a vectorized kernel exists, as for Manhattan
+///     distance between Points in k-means_manhattan.h.
+///   </para>
+/// </remarks>
+template <typename PointType, typename DistanceFunc>
+struct NearestMeans
+{
+  typedef typename DistanceFunc::result_type DistanceType;
+
+  static void Run(const PointType* points, const int numPoints,
+                  const DistanceFunc& distanceFunc,
+                  const std::vector<PointType>& means,
+                  int* closestIdx, DistanceType* closestDist,
+                  DistanceType* secondDist)
+  {
+    const int numMeans = static_cast<int>(means.size());
+    for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+    {
+      const PointType& point = points[pointIdx];
+      DistanceType bestDist = std::numeric_limits<DistanceType>::max();
+      DistanceType secondBest = std::numeric_limits<DistanceType>::max();
+      int bestIdx = 0;
+      for (int meanIdx = 0; meanIdx < numMeans; ++meanIdx)
+      {
+        const DistanceType distance = distanceFunc(point, means[meanIdx]);
+        if (distance < bestDist)
+        {
+          secondBest = bestDist;
+          bestDist = distance;
+          bestIdx = meanIdx;
+        }
+        else if (distance < secondBest)
+        {
+          secondBest = distance;
+        }
+      }
+      closestIdx[pointIdx] = bestIdx;
+      if (closestDist)
+      {
+        closestDist[pointIdx] = bestDist;
+      }
+      if (secondDist)
+      {
+        secondDist[pointIdx] = secondBest;
+      }
+    }
+  }
+};
+
+/// <summary> Assign each point to its closest mean by trying every mean. </summary>
+/// <remarks>
+///   <para> An assignment policy is made once per clustering run and called
+///     every iteration as Assign(points, distanceFunc, means, labels), which
+///     returns the number of labels changed. On entry labels hold the
+///     assignment of the last call, if any. Reset() is called when labels
+///     were changed by other means. Ties go to the earliest mean.
+///   </para>
+/// </remarks>
+template <typename PointType, typename DistanceFunc>
+class LloydAssignment
+{
+public:
+  typedef typename DistanceFunc::result_type DistanceType;
+
+  enum { ChunkPoints = 256, };
+
+  inline void Reset() {}
+
+  int Assign(const std::vector<PointType>& points,
+             const DistanceFunc& distanceFunc,
+             const std::vector<PointType>& means,
+             std::vector<int>* labels)
+  {
+    assert(labels);
+    const int numPoints = static_cast<int>(points.size());
+    const int numChunks = (numPoints + ChunkPoints - 1) / ChunkPoints;
+    labels->resize(numPoints, -1);
+    int changed = 0;
+#pragma omp parallel for schedule(static) reduction(+:changed)
+    for (int chunk = 0; chunk < numChunks; ++chunk)
+    {
+      const int begin = chunk * ChunkPoints;
+      const int count = std::min(static_cast<int>(ChunkPoints), numPoints - begin);
+      int closestIdx[ChunkPoints];
+      NearestMeans<PointType, DistanceFunc>::Run(&points[begin], count,
+                                                 distanceFunc, means,
+                                                 closestIdx, NULL, NULL);
+      for (int entry = 0; entry < count; ++entry)
+      {
+        int& label = (*labels)[begin + entry];
+        changed += (label != closestIdx[entry]);
+        label = closestIdx[entry];
+      }
+    }
+    return changed;
+  }
+};
+
+/// <summary> Assign points to means, skipping distances that cannot matter. </summary>
+/// <remarks>
+///   <para> Hamerly's method, taken from:
+///       Greg Hamerly. 2010. Making k-means even faster. In Proceedings of
+///       the 2010 SIAM International Conference on Data Mining, 130-140.
+///   </para>
+///   <para> Each point keeps an upper bound on the distance to its mean and
+///     a lower bound on the distance to any other mean. When means move, the
+///     bounds grow and shrink by how far they moved. A point keeps its mean
+///     without a look at the others when its upper bound is within the lower
+///     bound or within half the distance from its mean to the nearest other
+///     mean. Once clusters settle, most points need no distance at all.
+///   </para>
+///   <para> The bounds need only the triangle inequality, so any metric
+///     DistanceFunc works, Manhattan distance included. A point that ties
+///     between means may keep its mean where LloydAssignment would take the
+///     earliest one.
+///   </para>
+/// </remarks>
+template <typename PointType, typename DistanceFunc>
+class HamerlyAssignment
+{
+public:
+  typedef typename DistanceFunc::result_type DistanceType;
+
+  enum { ChunkPoints = 256, };
+
+  HamerlyAssignment()
+    : m_upper(),
+      m_lower(),
+      m_prevMeans(),
+      m_meanMoves(),
+      m_meanSeparation()
+  {}
+
+  /// <summary> Forget the bounds so the next call is a full pass. </summary>
+  inline void Reset()
+  {
+    m_upper.clear();
+  }
+
+  int Assign(const std::vector<PointType>& points,
+             const DistanceFunc& distanceFunc,
+             const std::vector<PointType>& means,
+             std::vector<int>* labels)
+  {
+    assert(labels);
+    const int numPoints = static_cast<int>(points.size());
+    const int numMeans = static_cast<int>(means.size());
+    int changed = 0;
+    // Start the bounds with a full pass.
+    if ((static_cast<int>(m_upper.size()) != numPoints) ||
+        (static_cast<int>(m_prevMeans.size()) != numMeans))
+    {
+      labels->resize(numPoints, -1);
+      m_upper.resize(numPoints);
+      m_lower.resize(numPoints);
+      const int numChunks = (numPoints + ChunkPoints - 1) / ChunkPoints;
+#pragma omp parallel for schedule(static) reduction(+:changed)
+      for (int chunk = 0; chunk < numChunks; ++chunk)
+      {
+        const int begin = chunk * ChunkPoints;
+        const int count = std::min(static_cast<int>(ChunkPoints), numPoints - begin);
+        int closestIdx[ChunkPoints];
+        NearestMeans<PointType, DistanceFunc>::Run(&points[begin], count,
+                                                   distanceFunc, means,
+                                                   closestIdx, &m_upper[begin],
+                                                   &m_lower[begin]);
+        for (int entry = 0; entry < count; ++entry)
+        {
+          int& label = (*labels)[begin + entry];
+          changed += (label != closestIdx[entry]);
+          label = closestIdx[entry];
+        }
+      }
+      m_prevMeans = means;
+      return changed;
+    }
+    // How far each mean moved, and the two largest moves.
+    m_meanMoves.resize(numMeans);
+    int maxMoveIdx = 0;
+    DistanceType maxMove = 0;
+    DistanceType secondMove = 0;
+    for (int meanIdx = 0; meanIdx < numMeans; ++meanIdx)
+    {
+      const DistanceType move = distanceFunc(m_prevMeans[meanIdx], means[meanIdx]);
+      m_meanMoves[meanIdx] = move;
+      if (move > maxMove)
+      {
+        secondMove = maxMove;
+        maxMove = move;
+        maxMoveIdx = meanIdx;
+      }
+      else if (move > secondMove)
+      {
+        secondMove = move;
+      }
+    }
+    // Distance from each mean to the nearest other mean.
+    m_meanSeparation.assign(numMeans, std::numeric_limits<DistanceType>::max());
+    for (int meanIdx = 0; meanIdx < numMeans; ++meanIdx)
+    {
+      for (int otherIdx = meanIdx + 1; otherIdx < numMeans; ++otherIdx)
+      {
+        const DistanceType distance = distanceFunc(means[meanIdx], means[otherIdx]);
+        m_meanSeparation[meanIdx] = std::min(m_meanSeparation[meanIdx], distance);
+        m_meanSeparation[otherIdx] = std::min(m_meanSeparation[otherIdx], distance);
+      }
+    }
+#pragma omp parallel for schedule(static, 100) reduction(+:changed)
+    for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+    {
+      const int label = (*labels)[pointIdx];
+      DistanceType& upper = m_upper[pointIdx];
+      DistanceType& lower = m_lower[pointIdx];
+      upper += m_meanMoves[label];
+      const DistanceType otherMove = (label == maxMoveIdx) ? secondMove : maxMove;
+      lower = (lower > otherMove) ? (lower - otherMove) : 0;
+      if (Settled(upper, lower, m_meanSeparation[label]))
+      {
+        continue;
+      }
+      // Tighten the upper bound and try again.
+      upper = distanceFunc(points[pointIdx], means[label]);
+      if (Settled(upper, lower, m_meanSeparation[label]))
+      {
+        continue;
+      }
+      changed += AssignFull(points[pointIdx], distanceFunc, means, pointIdx,
+                            labels);
+    }
+    m_prevMeans = means;
+    return changed;
+  }
+
+private:
+  /// <summary> Check if no other mean may be closer than the point's own. </summary>
+  inline static bool Settled(const DistanceType upper, const DistanceType lower,
+                             const DistanceType separation)
+  {
+    // Compare against half the separation without dividing.
+    return (upper <= lower) || ((upper + upper) <= separation);
+  }
+
+  /// <summary> Find the closest and second closest means of a point. </summary>
+  /// <returns> One if the label of the point changed, else zero. </returns>
+  inline int AssignFull(const PointType& point, const DistanceFunc& distanceFunc,
+                         const std::vector<PointType>& means, const int pointIdx,
+                         std::vector<int>* labels)
+  {
+    int closestIdx;
+    NearestMeans<PointType, DistanceFunc>::Run(&point, 1, distanceFunc, means,
+                                               &closestIdx, &m_upper[pointIdx],
+                                               &m_lower[pointIdx]);
+    const int changed = ((*labels)[pointIdx] != closestIdx);
+    (*labels)[pointIdx] = closestIdx;
+    return changed;
+  }
+
+  std::vector<DistanceType> m_upper;
+  std::vector<DistanceType> m_lower;
+  std::vector<PointType> m_prevMeans;
+  std::vector<DistanceType> m_meanMoves;
+  std::vector<DistanceType> m_meanSeparation;
+};
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy = LloydAssignment>
 struct KMeans
 {
   typedef std::vector<PointType> PointList;
   typedef std::vector<PointList> ClusterList;
 
-  /// <summary> Compute the mean for a set of points. </summary>
-  struct ComputeMean
+  /// <summary> How clusters are seeded and what center each one keeps. </summary>
+  struct Settings
   {
-    inline const PointType operator()(const PointList& cluster) const
+    enum Seeding
     {
-      // reissb -- 20111016 -- This line requires operator+ for the PointType.
-      //   If this is not possible, then one could extend this template to
-      //   take an addition function as well as a distance function.
-      const PointType sumPoint = std::accumulate(cluster.begin(), cluster.end(),
-                                                 PointType(0, 0));
-      const int clusterSize = static_cast<int>(cluster.size());
-      return PointType(sumPoint.x / clusterSize, sumPoint.y / clusterSize);
-    }
+      /// <summary> Put every point in a uniformly random cluster. </summary>
+      Seeding_RandomPartition,
+      /// <summary> k-means++: pick seeds from the points, each with chance
+      ///   proportional to its squared distance from the seeds so far.
+      /// </summary>
+      Seeding_PlusPlus,
+    };
+    enum Center
+    {
+      Center_Mean,
+      Center_Median,
+    };
+
+    Settings()
+      : seeding(Seeding_RandomPartition),
+        center(Center_Mean),
+        weights(NULL)
+    {}
+    Settings(const Seeding seeding_, const Center center_,
+             const std::vector<int>* weights_ = NULL)
+      : seeding(seeding_),
+        center(center_),
+        weights(weights_)
+    {}
+
+    Seeding seeding;
+    Center center;
+    /// <summary> Positive weight of each point, or NULL for all ones. </summary>
+    /// <remarks>
+    ///   <para> A point of weight w counts as w points at its place. Weights
+    ///     scale the k-means++ seeding chances and the mean or median of
+    ///     each cluster. Assignment is unchanged, since weights do not
+    ///     change which mean is nearest.
+    ///   </para>
+    /// </remarks>
+    const std::vector<int>* weights;
+  };
+
+  typedef std::vector<int> LabelList;
+
+  enum { MinBlockPoints = 4096, };
+
+  /// <summary> Cluster tallies and buffers kept between iterations. </summary>
+  /// <remarks>
+  ///   <para> Points are split into contiguous blocks, at most one per
+  ///     thread. Each block counts and sums its points per cluster on its
+  ///     own, then the blocks are merged. The sums are exact, so the centers
+  ///     do not depend on the number of blocks.
+  ///   </para>
+  /// </remarks>
+  struct Workspace
+  {
+    Workspace()
+      : weights(NULL),
+        numBlocks(0),
+        blockSize(0),
+        blockCounts(),
+        blockWeights(),
+        blockSumX(),
+        blockSumY(),
+        counts(),
+        totalWeights(),
+        sumX(),
+        sumY(),
+        clusterStart(),
+        coordX(),
+        coordY(),
+        weightedX(),
+        weightedY()
+    {}
+
+    /// <summary> Weights of the points, or NULL. Sums are weighted. </summary>
+    const std::vector<int>* weights;
+    int numBlocks;
+    int blockSize;
+    std::vector<int> blockCounts;
+    std::vector<long long> blockWeights;
+    std::vector<long long> blockSumX;
+    std::vector<long long> blockSumY;
+    std::vector<int> counts;
+    std::vector<long long> totalWeights;
+    std::vector<long long> sumX;
+    std::vector<long long> sumY;
+    /// <summary> Coordinates grouped by cluster for medians. </summary>
+    std::vector<int> clusterStart;
+    std::vector<int> coordX;
+    std::vector<int> coordY;
+    /// <summary> Coordinates and weights grouped by cluster. </summary>
+    std::vector<std::pair<int, int> > weightedX;
+    std::vector<std::pair<int, int> > weightedY;
   };
 
   /// <summary> Run k-means clustering with given distance function. </summary>
+  /// <remarks>
+  ///   <para> Clusters are kept as labels, the index of the mean of each
+  ///     point, so no point is copied while iterating. Iteration stops once
+  ///     no label changes, once the means move no more than deltaDistStable
+  ///     in all, or after the given number of iterations.
+  ///   </para>
+  ///   <para> All random choices are drawn from rng so that the clustering
+  ///     is reproducible and safe to run on many threads at once.
+  ///   </para>
+  ///   <para> When a deadline is given, iteration stops once it expires and
+  ///     the means of the current labels are returned.
+  ///   </para>
+  /// </remarks>
+  /// <returns> The number of iterations run. </returns>
+  template <typename DistanceFunc, typename RandomEngine>
+  static int Run(const int k, const int iterations,
+                 const typename DistanceFunc::result_type deltaDistStable,
+                 const PointList& points, const DistanceFunc& distanceFunc,
+                 const Settings& settings,
+                 RandomEngine* rng, PointList* means, LabelList* labels,
+                 const Deadline* deadline = NULL);
+
+  /// <summary> How one restart of RunRestarts() went. </summary>
+  struct Restart
+  {
+    int iterations;
+    double inertia;
+  };
+
+  /// <summary> Run k-means from several seedings and keep the best. </summary>
+  /// <remarks>
+  ///   <para> Each restart draws from its own stream, split from rng in
+  ///     order, and restarts run on separate threads. The clustering of
+  ///     least inertia is returned, with ties going to the earliest restart,
+  ///     so the result does not depend on the number of threads.
+  ///   </para>
+  ///   <para> When restarts is given, it is filled with the iterations and
+  ///     inertia of every restart.
+  ///   </para>
+  /// </remarks>
+  /// <returns> The index of the restart returned. </returns>
+  template <typename DistanceFunc, typename RandomEngine>
+  static int RunRestarts(const int k, const int iterations,
+                         const typename DistanceFunc::result_type deltaDistStable,
+                         const PointList& points,
+                         const DistanceFunc& distanceFunc,
+                         const Settings& settings, const int numRestarts,
+                         RandomEngine* rng, PointList* means, LabelList* labels,
+                         std::vector<Restart>* restarts = NULL,
+                         const Deadline* deadline = NULL);
+
+  /// <summary> Total distance from each point to its mean. </summary>
+  /// <remarks>
+  ///   <para> Distances are scaled by weights when given. </para>
+  /// </remarks>
   template <typename DistanceFunc>
-  static void Run(const int k, const int iterations,
-                  const typename DistanceFunc::result_type deltaDistStable,
-                  const PointList& points, const DistanceFunc& distanceFunc,
-                  PointList* means, ClusterList* clusters);
+  static double Inertia(const PointList& points, const DistanceFunc& distanceFunc,
+                        const PointList& means, const LabelList& labels,
+                        const std::vector<int>* weights = NULL);
+
+  /// <summary> Run k-means clustering and gather the points of each cluster. </summary>
+  template <typename DistanceFunc, typename RandomEngine>
+  inline static void Run(const int k, const int iterations,
+                         const typename DistanceFunc::result_type deltaDistStable,
+                         const PointList& points,
+                         const DistanceFunc& distanceFunc,
+                         const Settings& settings,
+                         RandomEngine* rng, PointList* means,
+                         ClusterList* clusters,
+                         const Deadline* deadline = NULL)
+  {
+    assert(clusters);
+    LabelList labels;
+    Run(k, iterations, deltaDistStable, points, distanceFunc, settings,
+        rng, means, &labels, deadline);
+    MakeClusters(k, points, labels, clusters);
+  }
+
+  /// <summary> Run with random partition seeding and mean centers. </summary>
+  template <typename DistanceFunc, typename RandomEngine>
+  inline static void Run(const int k, const int iterations,
+                         const typename DistanceFunc::result_type deltaDistStable,
+                         const PointList& points,
+                         const DistanceFunc& distanceFunc,
+                         RandomEngine* rng, PointList* means,
+                         ClusterList* clusters,
+                         const Deadline* deadline = NULL)
+  {
+    Run(k, iterations, deltaDistStable, points, distanceFunc, Settings(),
+        rng, means, clusters, deadline);
+  }
+
+  /// <summary> Gather the points of each cluster from their labels. </summary>
+  static void MakeClusters(const int k, const PointList& points,
+                           const LabelList& labels, ClusterList* clusters);
+
+  /// <summary> Set each center from the points labeled with it. </summary>
+  /// <remarks>
+  ///   <para> An empty cluster first steals a point from another cluster. </para>
+  /// </remarks>
+  /// <returns> True if a point was stolen, which changes its label. </returns>
+  template <typename RandomEngine>
+  static bool UpdateCenters(const Settings& settings, const PointList& points,
+                            RandomEngine* rng, Workspace* workspace,
+                            LabelList* labels, PointList* means);
+
+  /// <summary> Count and sum the points of each cluster. </summary>
+  static void Tally(const int k, const PointList& points,
+                    const LabelList& labels, Workspace* workspace);
+
+  /// <summary> The least coordinate holding at least half of the weight. </summary>
+  static int WeightedLowerMedian(std::pair<int, int>* begin,
+                                 std::pair<int, int>* end);
+
+  /// <summary> Relabel a point in the tallies and labels. </summary>
+  static void MovePoint(const PointList& points, const int pointIdx,
+                        const int toClusterIdx, Workspace* workspace,
+                        LabelList* labels);
+
+  /// <summary> Pick k seeds from the points by k-means++. </summary>
+  /// <remarks>
+  ///   <para> With weights, chances are also in proportion to weight. </para>
+  /// </remarks>
+  template <typename DistanceFunc, typename RandomEngine>
+  static void SeedPlusPlus(const int k, const PointList& points,
+                           const DistanceFunc& distanceFunc,
+                           RandomEngine* rng, PointList* means,
+                           const std::vector<int>* weights = NULL);
 
 };
 
-template <typename PointType>
-template <typename DistanceFunc>
-void KMeans<PointType>:: Run(const int k, const int iterations,
-                             const typename DistanceFunc::result_type deltaDistStable,
-                             const PointList& points,
-                             const DistanceFunc& distanceFunc,
-                             PointList* means, ClusterList* clusters)
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+template <typename DistanceFunc, typename RandomEngine>
+void KMeans<PointType, AssignmentPolicy>::SeedPlusPlus(const int k, const PointList& points,
+                                     const DistanceFunc& distanceFunc,
+                                     RandomEngine* rng, PointList* means,
+                                     const std::vector<int>* weights)
+{
+  assert(rng && means);
+  assert((k > 0) && (k <= static_cast<int>(points.size())));
+  assert(!weights || (weights->size() == points.size()));
+  const int numPoints = static_cast<int>(points.size());
+  means->resize(k);
+  if (weights)
+  {
+    // Pick the first seed in proportion to weight.
+    const double totalWeight = std::accumulate(weights->begin(), weights->end(),
+                                               0.0);
+    double target = rng->Uniform() * totalWeight;
+    int chosenIdx = numPoints - 1;
+    for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+    {
+      target -= (*weights)[pointIdx];
+      if (target < 0.0)
+      {
+        chosenIdx = pointIdx;
+        break;
+      }
+    }
+    (*means)[0] = points[chosenIdx];
+  }
+  else
+  {
+    (*means)[0] = points[rng->Bound(numPoints)];
+  }
+  // Squared distance from each point to its nearest seed, times its weight.
+  std::vector<double> minDistSq(numPoints);
+  double totalDistSq = 0.0;
+  for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+  {
+    const double dist = static_cast<double>(distanceFunc(points[pointIdx],
+                                                         (*means)[0]));
+    const double weight = weights ? (*weights)[pointIdx] : 1.0;
+    minDistSq[pointIdx] = weight * dist * dist;
+    totalDistSq += minDistSq[pointIdx];
+  }
+  for (int meanIdx = 1; meanIdx < k; ++meanIdx)
+  {
+    int chosenIdx = numPoints - 1;
+    if (totalDistSq > 0.0)
+    {
+      double target = rng->Uniform() * totalDistSq;
+      for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+      {
+        target -= minDistSq[pointIdx];
+        if (target < 0.0)
+        {
+          chosenIdx = pointIdx;
+          break;
+        }
+      }
+    }
+    else
+    {
+      // Every point sits on a seed.
+      chosenIdx = rng->Bound(numPoints);
+    }
+    (*means)[meanIdx] = points[chosenIdx];
+    totalDistSq = 0.0;
+    for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+    {
+      const double dist = static_cast<double>(distanceFunc(points[pointIdx],
+                                                           (*means)[meanIdx]));
+      const double weight = weights ? (*weights)[pointIdx] : 1.0;
+      minDistSq[pointIdx] = std::min(minDistSq[pointIdx], weight * dist * dist);
+      totalDistSq += minDistSq[pointIdx];
+    }
+  }
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+void KMeans<PointType, AssignmentPolicy>::MakeClusters(const int k,
+                                                       const PointList& points,
+                                                       const LabelList& labels,
+                                                       ClusterList* clusters)
+{
+  assert(clusters);
+  assert(labels.size() == points.size());
+  clusters->resize(k);
+  std::for_each(clusters->begin(), clusters->end(),
+                std::mem_fun_ref(&PointList::clear));
+  const int numPoints = static_cast<int>(points.size());
+  for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+  {
+    clusters->at(labels[pointIdx]).push_back(points[pointIdx]);
+  }
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+void KMeans<PointType, AssignmentPolicy>::Tally(const int k,
+                                                const PointList& points,
+                                                const LabelList& labels,
+                                                Workspace* workspace)
+{
+  assert(workspace);
+  const int numPoints = static_cast<int>(points.size());
+  Workspace& ws = *workspace;
+  ws.numBlocks = std::max(1, std::min(omp_get_max_threads(),
+                                      numPoints / MinBlockPoints));
+  ws.blockSize = (numPoints + ws.numBlocks - 1) / ws.numBlocks;
+  ws.blockCounts.assign(ws.numBlocks * k, 0);
+  ws.blockWeights.assign(ws.numBlocks * k, 0);
+  ws.blockSumX.assign(ws.numBlocks * k, 0);
+  ws.blockSumY.assign(ws.numBlocks * k, 0);
+  const int numBlocks = ws.numBlocks;
+  const std::vector<int>* weights = ws.weights;
+#pragma omp parallel for schedule(static, 1) if (numBlocks > 1)
+  for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+  {
+    int* counts = &ws.blockCounts[blockIdx * k];
+    long long* blockWeights = &ws.blockWeights[blockIdx * k];
+    long long* sumX = &ws.blockSumX[blockIdx * k];
+    long long* sumY = &ws.blockSumY[blockIdx * k];
+    const int end = std::min(numPoints, (blockIdx + 1) * ws.blockSize);
+    for (int pointIdx = blockIdx * ws.blockSize; pointIdx < end; ++pointIdx)
+    {
+      const int label = labels[pointIdx];
+      const long long weight = weights ? (*weights)[pointIdx] : 1;
+      ++counts[label];
+      blockWeights[label] += weight;
+      sumX[label] += weight * points[pointIdx].x;
+      sumY[label] += weight * points[pointIdx].y;
+    }
+  }
+  // Merge blocks.
+  ws.counts.assign(k, 0);
+  ws.totalWeights.assign(k, 0);
+  ws.sumX.assign(k, 0);
+  ws.sumY.assign(k, 0);
+  for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+  {
+    for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx)
+    {
+      const int tallyIdx = (blockIdx * k) + clusterIdx;
+      ws.counts[clusterIdx] += ws.blockCounts[tallyIdx];
+      ws.totalWeights[clusterIdx] += ws.blockWeights[tallyIdx];
+      ws.sumX[clusterIdx] += ws.blockSumX[tallyIdx];
+      ws.sumY[clusterIdx] += ws.blockSumY[tallyIdx];
+    }
+  }
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+int KMeans<PointType, AssignmentPolicy>::WeightedLowerMedian(std::pair<int, int>* begin,
+                                                             std::pair<int, int>* end)
+{
+  assert(begin < end);
+  std::sort(begin, end);
+  long long totalWeight = 0;
+  for (const std::pair<int, int>* entry = begin; entry != end; ++entry)
+  {
+    totalWeight += entry->second;
+  }
+  long long weight = 0;
+  for (const std::pair<int, int>* entry = begin; entry != end; ++entry)
+  {
+    weight += entry->second;
+    if ((weight + weight) >= totalWeight)
+    {
+      return entry->first;
+    }
+  }
+  return (end - 1)->first;
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+void KMeans<PointType, AssignmentPolicy>::MovePoint(const PointList& points,
+                                                    const int pointIdx,
+                                                    const int toClusterIdx,
+                                                    Workspace* workspace,
+                                                    LabelList* labels)
+{
+  assert(workspace && labels);
+  Workspace& ws = *workspace;
+  const int k = static_cast<int>(ws.counts.size());
+  const int fromClusterIdx = (*labels)[pointIdx];
+  const PointType& point = points[pointIdx];
+  const long long weight = ws.weights ? (*ws.weights)[pointIdx] : 1;
+  const int blockTally = (pointIdx / ws.blockSize) * k;
+  --ws.blockCounts[blockTally + fromClusterIdx];
+  ws.blockWeights[blockTally + fromClusterIdx] -= weight;
+  ws.blockSumX[blockTally + fromClusterIdx] -= weight * point.x;
+  ws.blockSumY[blockTally + fromClusterIdx] -= weight * point.y;
+  ++ws.blockCounts[blockTally + toClusterIdx];
+  ws.blockWeights[blockTally + toClusterIdx] += weight;
+  ws.blockSumX[blockTally + toClusterIdx] += weight * point.x;
+  ws.blockSumY[blockTally + toClusterIdx] += weight * point.y;
+  --ws.counts[fromClusterIdx];
+  ws.totalWeights[fromClusterIdx] -= weight;
+  ws.sumX[fromClusterIdx] -= weight * point.x;
+  ws.sumY[fromClusterIdx] -= weight * point.y;
+  ++ws.counts[toClusterIdx];
+  ws.totalWeights[toClusterIdx] += weight;
+  ws.sumX[toClusterIdx] += weight * point.x;
+  ws.sumY[toClusterIdx] += weight * point.y;
+  (*labels)[pointIdx] = toClusterIdx;
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+template <typename RandomEngine>
+bool KMeans<PointType, AssignmentPolicy>::UpdateCenters(const Settings& settings,
+                                                        const PointList& points,
+                                                        RandomEngine* rng,
+                                                        Workspace* workspace,
+                                                        LabelList* labels,
+                                                        PointList* means)
+{
+  assert(rng && workspace && labels && means);
+  const int k = static_cast<int>(means->size());
+  const int numPoints = static_cast<int>(points.size());
+  Workspace& ws = *workspace;
+  ws.weights = settings.weights;
+  Tally(k, points, *labels, workspace);
+  // Make sure that there are no empty clusters.
+  bool stolen = false;
+  for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx)
+  {
+    if (0 == ws.counts[clusterIdx])
+    {
+      // Steal the last point of another cluster.
+      for (;;)
+      {
+        int stealClusterIdx = rng->Bound(k - 1);
+        stealClusterIdx += (stealClusterIdx == clusterIdx);
+        if (ws.counts[stealClusterIdx] > 1)
+        {
+          int pointIdx = numPoints - 1;
+          while ((*labels)[pointIdx] != stealClusterIdx)
+          {
+            --pointIdx;
+          }
+          MovePoint(points, pointIdx, clusterIdx, workspace, labels);
+          stolen = true;
+          break;
+        }
+      }
+    }
+  }
+  if (Settings::Center_Median == settings.center)
+  {
+    // Group coordinates by cluster. Each block writes after the blocks
+    // before it, so the tallies become write offsets.
+    ws.clusterStart.resize(k + 1);
+    ws.clusterStart[0] = 0;
+    for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx)
+    {
+      int offset = ws.clusterStart[clusterIdx];
+      for (int blockIdx = 0; blockIdx < ws.numBlocks; ++blockIdx)
+      {
+        int& blockCount = ws.blockCounts[(blockIdx * k) + clusterIdx];
+        const int count = blockCount;
+        blockCount = offset;
+        offset += count;
+      }
+      ws.clusterStart[clusterIdx + 1] = offset;
+    }
+    const std::vector<int>* weights = ws.weights;
+    if (weights)
+    {
+      ws.weightedX.resize(numPoints);
+      ws.weightedY.resize(numPoints);
+    }
+    else
+    {
+      ws.coordX.resize(numPoints);
+      ws.coordY.resize(numPoints);
+    }
+    const int numBlocks = ws.numBlocks;
+#pragma omp parallel for schedule(static, 1) if (numBlocks > 1)
+    for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+    {
+      int* offsets = &ws.blockCounts[blockIdx * k];
+      const int end = std::min(numPoints, (blockIdx + 1) * ws.blockSize);
+      for (int pointIdx = blockIdx * ws.blockSize; pointIdx < end; ++pointIdx)
+      {
+        const int pos = offsets[(*labels)[pointIdx]]++;
+        if (weights)
+        {
+          ws.weightedX[pos] = std::make_pair(points[pointIdx].x, (*weights)[pointIdx]);
+          ws.weightedY[pos] = std::make_pair(points[pointIdx].y, (*weights)[pointIdx]);
+        }
+        else
+        {
+          ws.coordX[pos] = points[pointIdx].x;
+          ws.coordY[pos] = points[pointIdx].y;
+        }
+      }
+    }
+    // Take the lower median of each coordinate.
+#pragma omp parallel for schedule(dynamic) if (numBlocks > 1)
+    for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx)
+    {
+      const int begin = ws.clusterStart[clusterIdx];
+      const int end = ws.clusterStart[clusterIdx + 1];
+      if (weights)
+      {
+        (*means)[clusterIdx] =
+          PointType(WeightedLowerMedian(&ws.weightedX[0] + begin, &ws.weightedX[0] + end),
+                    WeightedLowerMedian(&ws.weightedY[0] + begin, &ws.weightedY[0] + end));
+        continue;
+      }
+      const int mid = begin + ((end - begin - 1) / 2);
+      std::nth_element(ws.coordX.begin() + begin, ws.coordX.begin() + mid,
+                       ws.coordX.begin() + end);
+      std::nth_element(ws.coordY.begin() + begin, ws.coordY.begin() + mid,
+                       ws.coordY.begin() + end);
+      (*means)[clusterIdx] = PointType(ws.coordX[mid], ws.coordY[mid]);
+    }
+  }
+  else
+  {
+    for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx)
+    {
+      const long long totalWeight = ws.totalWeights[clusterIdx];
+      (*means)[clusterIdx] =
+        PointType(static_cast<int>(ws.sumX[clusterIdx] / totalWeight),
+                  static_cast<int>(ws.sumY[clusterIdx] / totalWeight));
+    }
+  }
+  return stolen;
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+template <typename DistanceFunc, typename RandomEngine>
+int KMeans<PointType, AssignmentPolicy>::Run(const int k, const int iterations,
+                            const typename DistanceFunc::result_type deltaDistStable,
+                            const PointList& points,
+                            const DistanceFunc& distanceFunc,
+                            const Settings& settings,
+                            RandomEngine* rng,
+                            PointList* means, LabelList* labels,
+                            const Deadline* deadline)
 {
-  assert(means && clusters);
+  assert(rng && means && labels);
   assert(k > 0);
   assert(k <= static_cast<int>(points.size()));
   // reissb -- 20111016 -- K-means algorithm
@@ -62,56 +882,44 @@ void KMeans<PointType>:: Run(const int k, const int iterations,
   //     ii)  For each collection of closest points, update center k_i with
   //          the new center (either a point or the mean of the cluster).
 
-  // Select k random clusters.
-  clusters->clear();
-  clusters->resize(k);
-  RandBoundedGenerator randClusterGenerator(k);
-  for (typename PointList::const_iterator point = points.begin();
-       point != points.end();
-       ++point)
+  // Seed the clusters.
+  AssignmentPolicy<PointType, DistanceFunc> assignment;
+  labels->clear();
+  if (Settings::Seeding_PlusPlus == settings.seeding)
   {
-    const int clusterIdx = randClusterGenerator();
-    clusters->at(clusterIdx).push_back(*point);
+    SeedPlusPlus(k, points, distanceFunc, rng, means, settings.weights);
+    assignment.Assign(points, distanceFunc, *means, labels);
+  }
+  else
+  {
+    // Put each point in a random cluster.
+    labels->resize(points.size());
+    for (typename LabelList::iterator label = labels->begin();
+         label != labels->end();
+         ++label)
+    {
+      *label = rng->Bound(k);
+    }
   }
   // Allocate memory for iterations.
-  typedef std::pair<typename DistanceFunc::result_type, int> DistanceMeanPair;
-  typedef std::vector<DistanceMeanPair> DistanceMeanPairList;
-  const int numPoints = static_cast<int>(points.size());
-  DistanceMeanPairList closestMeans(numPoints);
   PointList prevMeans(k, PointType(0, 0));
   std::vector<typename DistanceFunc::result_type> meanDeltas(k);
+  Workspace workspace;
   means->resize(k);
   // Iterate clusters.
   for(int iteration = 0; iteration < iterations; ++iteration)
   {
-    // Make sure that there are no empty clusters.
-    for (typename ClusterList::iterator cluster = clusters->begin();
-         cluster != clusters->end();
-         ++cluster)
+    // Update means. A stolen point has a new label that the assignment
+    // did not make, so it may not trust what it kept.
+    if (UpdateCenters(settings, points, rng, &workspace, labels, means))
     {
-      if (cluster->empty())
-      {
-        // Steal a point from another cluster.
-        for (;;)
-        {
-          const int stealClusterIdx = RandBound(k - 1);
-          typename ClusterList::iterator takePt = clusters->begin() + stealClusterIdx;
-          takePt += (takePt == cluster);
-          if (takePt->size() > 1)
-          {
-            cluster->push_back(takePt->back());
-            takePt->pop_back();
-            break;
-          }
-        }
-      }
+      assignment.Reset();
+    }
+    // Stop with the means of the current labels if out of time.
+    if (deadline && deadline->Expired())
+    {
+      return iteration + 1;
     }
-    // reissb -- 20111016 -- Mean updating may be parallelized, but it
-    //   should be verified that it gives a true speedup since it is not
-    //   computationally expensive unless N is very large.
-    // Update means.
-    std::transform(clusters->begin(), clusters->end(),
-                   means->begin(), ComputeMean());
     // See if we have reached a stable iteration.
     {
       std::transform(means->begin(), means->end(), prevMeans.begin(),
@@ -120,49 +928,95 @@ void KMeans<PointType>:: Run(const int k, const int iterations,
         std::accumulate(meanDeltas.begin(), meanDeltas.end(), 0);
       if (deltaDist <= deltaDistStable)
       {
-        return;
+        return iteration + 1;
       }
       prevMeans = *means;
     }
-    // Clear the clusters.
-    std::for_each(clusters->begin(), clusters->end(),
-                  std::mem_fun_ref(&PointList::clear));
-    // For each point, find the closest mean and add to the cluster.
-#pragma omp parallel for schedule(static, 100)
-    for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+    // With no label changed the means would not change either.
+    if (0 == assignment.Assign(points, distanceFunc, *means, labels))
     {
-      // Find closest mean.
-      DistanceMeanPair& closestMean = closestMeans.at(pointIdx);
-      closestMean = std::make_pair(std::numeric_limits<typename DistanceMeanPair::first_type>::max(),
-                                   std::numeric_limits<typename DistanceMeanPair::second_type>::max());
-      const PointType& point = points.at(pointIdx);
-      int meanIdx = 0;
-      for (typename PointList::const_iterator mean = means->begin();
-           mean != means->end();
-           ++mean, ++meanIdx)
-      {
-        const typename DistanceFunc::result_type distance = distanceFunc(point, *mean);
-        if (distance < closestMean.first)
-        {
-          closestMean.first = distance;
-          closestMean.second = meanIdx;
-        }
-      }
+      return iteration + 1;
     }
-    // Insert points into clusters.
+  }
+  // Compute final means.
+  UpdateCenters(settings, points, rng, &workspace, labels, means);
+  return iterations;
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+template <typename DistanceFunc, typename RandomEngine>
+int KMeans<PointType, AssignmentPolicy>::RunRestarts(const int k, const int iterations,
+                            const typename DistanceFunc::result_type deltaDistStable,
+                            const PointList& points,
+                            const DistanceFunc& distanceFunc,
+                            const Settings& settings, const int numRestarts,
+                            RandomEngine* rng,
+                            PointList* means, LabelList* labels,
+                            std::vector<Restart>* restarts,
+                            const Deadline* deadline)
+{
+  assert(rng && means && labels);
+  assert(numRestarts > 0);
+  // Split streams before going parallel so each restart gets the same one
+  // however threads are scheduled.
+  std::vector<RandomEngine> restartRngs;
+  restartRngs.reserve(numRestarts);
+  for (int restartIdx = 0; restartIdx < numRestarts; ++restartIdx)
+  {
+    restartRngs.push_back(rng->Split());
+  }
+  std::vector<PointList> restartMeans(numRestarts);
+  std::vector<LabelList> restartLabels(numRestarts);
+  std::vector<Restart> stats(numRestarts);
+#pragma omp parallel for schedule(dynamic) if (numRestarts > 1)
+  for (int restartIdx = 0; restartIdx < numRestarts; ++restartIdx)
+  {
+    Restart& stat = stats[restartIdx];
+    stat.iterations = Run(k, iterations, deltaDistStable, points, distanceFunc,
+                          settings, &restartRngs[restartIdx],
+                          &restartMeans[restartIdx], &restartLabels[restartIdx],
+                          deadline);
+    stat.inertia = Inertia(points, distanceFunc, restartMeans[restartIdx],
+                           restartLabels[restartIdx], settings.weights);
+  }
+  int bestIdx = 0;
+  for (int restartIdx = 1; restartIdx < numRestarts; ++restartIdx)
+  {
+    if (stats[restartIdx].inertia < stats[bestIdx].inertia)
     {
-      typename PointList::const_iterator point = points.begin();
-      for (typename DistanceMeanPairList::const_iterator closestMean = closestMeans.begin();
-           closestMean != closestMeans.end();
-           ++closestMean, ++point)
-      {
-        clusters->at(closestMean->second).push_back(*point);
-      }
+      bestIdx = restartIdx;
     }
   }
-  // Compute final means.
-  std::transform(clusters->begin(), clusters->end(),
-                 means->begin(), ComputeMean());
+  means->swap(restartMeans[bestIdx]);
+  labels->swap(restartLabels[bestIdx]);
+  if (restarts)
+  {
+    restarts->swap(stats);
+  }
+  return bestIdx;
+}
+
+template <typename PointType,
+          template <typename, typename> class AssignmentPolicy>
+template <typename DistanceFunc>
+double KMeans<PointType, AssignmentPolicy>::Inertia(const PointList& points,
+                                                    const DistanceFunc& distanceFunc,
+                                                    const PointList& means,
+                                                    const LabelList& labels,
+                                                    const std::vector<int>* weights)
+{
+  assert(labels.size() == points.size());
+  const int numPoints = static_cast<int>(points.size());
+  double inertia = 0.0;
+#pragma omp parallel for schedule(static) reduction(+:inertia)
+  for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+  {
+    const double weight = weights ? (*weights)[pointIdx] : 1.0;
+    inertia += weight * static_cast<double>(distanceFunc(points[pointIdx],
+                                                         means[labels[pointIdx]]));
+  }
+  return inertia;
 }
 
 }
@@ -1,9 +1,12 @@
 #ifndef _HPS_AMBULANCE_KMEANS_GTEST_H_
 #define _HPS_AMBULANCE_KMEANS_GTEST_H_
 #include "k-means.h"
+#include "k-means_manhattan.h"
+#include "k-means_mini_batch.h"
 #include "ambulance_core.h"
 #include "rand_bound.h"
 #include "gtest/gtest.h"
+#include <omp.h>
 #include <algorithm>
 #include <numeric>
 #include <limits>
@@ -12,6 +15,37 @@ namespace _hps_ambulance_kmeans_gtest_h_
 {
 using namespace hps;
 
+namespace KMeansHelpers
+{
+/// <summary> Reference mean of a cluster, rounded toward zero. </summary>
+inline Point ReferenceMean(const KMeans<Point>::PointList& cluster)
+{
+  const Point sumPoint = std::accumulate(cluster.begin(), cluster.end(),
+                                         Point(0, 0));
+  const int clusterSize = static_cast<int>(cluster.size());
+  return Point(sumPoint.x / clusterSize, sumPoint.y / clusterSize);
+}
+
+/// <summary> Reference coordinate-wise lower median of a cluster. </summary>
+inline Point ReferenceMedian(const KMeans<Point>::PointList& cluster)
+{
+  std::vector<int> x;
+  std::vector<int> y;
+  for (KMeans<Point>::PointList::const_iterator point = cluster.begin();
+       point != cluster.end();
+       ++point)
+  {
+    x.push_back(point->x);
+    y.push_back(point->y);
+  }
+  const int mid = (static_cast<int>(cluster.size()) - 1) / 2;
+  std::nth_element(x.begin(), x.begin() + mid, x.end());
+  std::nth_element(y.begin(), y.begin() + mid, y.end());
+  return Point(x[mid], y[mid]);
+}
+}
+using namespace KMeansHelpers;
+
 TEST(KMeansFixedData, k_means)
 {
   enum { KMeansIterations = 1000, };
@@ -34,7 +68,7 @@ TEST(KMeansFixedData, k_means)
     KMeans<Point>::ClusterList clusters;
     KMeans<Point>::Run(k, KMeansIterations, 1, points,
                        std::ptr_fun(ManhattanDistance),
-                       &means, &clusters);
+                       &ThreadRandEngine(), &means, &clusters);
   }
 }
 
@@ -86,7 +120,7 @@ struct KMeansGaussianDataHelpers
   }
 };
 
-TEST(KMeansGaussianData, k_means)
+void KMeansGaussianDataTest(const KMeans<Point>::Settings& settings)
 {
   // reissb -- 20111017 -- Generate Gaussian distributed clusters in
   //   rectangular regions of the plane. Try to recover the centers
@@ -152,8 +186,8 @@ TEST(KMeansGaussianData, k_means)
     KMeans<Point>::PointList means;
     KMeans<Point>::ClusterList clusters;
     KMeans<Point>::Run(K, KMeansIterations, 0, points,
-                       std::ptr_fun(ManhattanDistance),
-                       &means, &clusters);
+                       std::ptr_fun(ManhattanDistance), settings,
+                       &ThreadRandEngine(), &means, &clusters);
     // Make sure that clusters were recovered.
     std::vector<int> meanRecovered(K, 1);
     std::vector<std::pair<Point, Point> > centerMeanPairs;
@@ -193,6 +227,472 @@ TEST(KMeansGaussianData, k_means)
   }
 }
 
+TEST(KMeansGaussianData, k_means)
+{
+  KMeansGaussianDataTest(KMeans<Point>::Settings());
+}
+
+TEST(KMeansPlusPlusGaussianData, k_means)
+{
+  KMeansGaussianDataTest(
+    KMeans<Point>::Settings(KMeans<Point>::Settings::Seeding_PlusPlus,
+                            KMeans<Point>::Settings::Center_Mean));
+}
+
+TEST(SingleClusterMedian, k_means)
+{
+  KMeans<Point>::PointList cluster;
+  cluster.push_back(Point(1, 9));
+  cluster.push_back(Point(5, 2));
+  cluster.push_back(Point(3, 3));
+  cluster.push_back(Point(9, 1));
+  cluster.push_back(Point(2, 7));
+  const KMeans<Point>::Settings settings(KMeans<Point>::Settings::Seeding_PlusPlus,
+                                         KMeans<Point>::Settings::Center_Median);
+  RandEngine rng(22ULL);
+  KMeans<Point>::PointList means;
+  KMeans<Point>::LabelList labels;
+  KMeans<Point>::Run(1, 10, 0, cluster, std::ptr_fun(ManhattanDistance),
+                     settings, &rng, &means, &labels);
+  ASSERT_EQ(1U, means.size());
+  EXPECT_EQ(3, means[0].x);
+  EXPECT_EQ(3, means[0].y);
+  // Even sizes take the lower median.
+  cluster.pop_back();
+  KMeans<Point>::Run(1, 10, 0, cluster, std::ptr_fun(ManhattanDistance),
+                     settings, &rng, &means, &labels);
+  ASSERT_EQ(1U, means.size());
+  EXPECT_EQ(3, means[0].x);
+  EXPECT_EQ(2, means[0].y);
+}
+
+TEST(KMediansFixedData, k_means)
+{
+  enum { KMeansIterations = 1000, };
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  KMeans<Point>::PointList points;
+  for (VictimList::const_iterator victim = victims.begin();
+       victim != victims.end();
+       ++victim)
+  {
+    points.push_back(victim->position);
+  }
+  const int k = static_cast<int>(hospitalAmbulances.size());
+  // Each center must be the median of its cluster, and every point must be
+  // in the cluster of its closest center.
+  RandEngine rng(21ULL);
+  KMeans<Point>::PointList means;
+  KMeans<Point>::ClusterList clusters;
+  KMeans<Point>::Run(k, KMeansIterations, 0, points,
+                     std::ptr_fun(ManhattanDistance),
+                     KMeans<Point>::Settings(KMeans<Point>::Settings::Seeding_PlusPlus,
+                                             KMeans<Point>::Settings::Center_Median),
+                     &rng, &means, &clusters);
+  ASSERT_EQ(k, static_cast<int>(means.size()));
+  for (int clusterIdx = 0; clusterIdx < k; ++clusterIdx)
+  {
+    ASSERT_FALSE(clusters[clusterIdx].empty());
+    const Point median = ReferenceMedian(clusters[clusterIdx]);
+    EXPECT_EQ(median.x, means[clusterIdx].x);
+    EXPECT_EQ(median.y, means[clusterIdx].y);
+    for (KMeans<Point>::PointList::const_iterator point = clusters[clusterIdx].begin();
+         point != clusters[clusterIdx].end();
+         ++point)
+    {
+      for (int meanIdx = 0; meanIdx < k; ++meanIdx)
+      {
+        EXPECT_LE(ManhattanDistance(*point, means[clusterIdx]),
+                  ManhattanDistance(*point, means[meanIdx]));
+      }
+    }
+  }
+}
+
+/// <summary> Manhattan distance that counts its calls. </summary>
+struct CountingManhattanDistance
+{
+  typedef int result_type;
+  explicit CountingManhattanDistance(long long* count_) : count(count_) {}
+  inline int operator()(const Point& lhs, const Point& rhs) const
+  {
+#pragma omp atomic
+    ++(*count);
+    return ManhattanDistance(lhs, rhs);
+  }
+  long long* count;
+};
+
+TEST(HamerlyAssignment, k_means)
+{
+  enum { NumPoints = 5000, };
+  enum { NumMeans = 8, };
+  enum { NumRounds = 12, };
+  enum { GridSize = 1000, };
+  RandEngine rng(15ULL);
+  KMeans<Point>::PointList points(NumPoints);
+  for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+  {
+    points[pointIdx] = Point(RandBound(&rng, GridSize), RandBound(&rng, GridSize));
+  }
+  KMeans<Point>::PointList means(NumMeans);
+  for (int meanIdx = 0; meanIdx < NumMeans; ++meanIdx)
+  {
+    means[meanIdx] = Point(RandBound(&rng, GridSize), RandBound(&rng, GridSize));
+  }
+  // Move the means less each round, as k-means does, and check that every
+  // label is a closest mean.
+  long long lloydCount = 0;
+  long long hamerlyCount = 0;
+  const CountingManhattanDistance lloydDistance(&lloydCount);
+  const CountingManhattanDistance hamerlyDistance(&hamerlyCount);
+  LloydAssignment<Point, CountingManhattanDistance> lloyd;
+  HamerlyAssignment<Point, CountingManhattanDistance> hamerly;
+  std::vector<int> lloydLabels;
+  std::vector<int> hamerlyLabels;
+  for (int round = 0; round < NumRounds; ++round)
+  {
+    lloyd.Assign(points, lloydDistance, means, &lloydLabels);
+    hamerly.Assign(points, hamerlyDistance, means, &hamerlyLabels);
+    ASSERT_EQ(static_cast<size_t>(NumPoints), hamerlyLabels.size());
+    for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+    {
+      EXPECT_EQ(ManhattanDistance(points[pointIdx], means[lloydLabels[pointIdx]]),
+                ManhattanDistance(points[pointIdx], means[hamerlyLabels[pointIdx]]));
+    }
+    const int step = 1 + ((NumRounds - round) * 4);
+    for (int meanIdx = 0; meanIdx < NumMeans; ++meanIdx)
+    {
+      means[meanIdx].x += RandBound(&rng, (2 * step) + 1) - step;
+      means[meanIdx].y += RandBound(&rng, (2 * step) + 1) - step;
+    }
+  }
+  EXPECT_LT(hamerlyCount, lloydCount);
+}
+
+TEST(KMeansLabels, k_means)
+{
+  enum { NumPoints = 40000, };
+  enum { K = 12, };
+  enum { GridSize = 1000, };
+  enum { KMeansIterations = 100, };
+  RandEngine pointRng(16ULL);
+  KMeans<Point>::PointList points(NumPoints);
+  for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+  {
+    points[pointIdx] = Point(RandBound(&pointRng, GridSize),
+                             RandBound(&pointRng, GridSize));
+  }
+  const KMeans<Point>::Settings::Center centers[] =
+  {
+    KMeans<Point>::Settings::Center_Mean,
+    KMeans<Point>::Settings::Center_Median,
+  };
+  for (int centerIdx = 0; centerIdx < 2; ++centerIdx)
+  {
+    const KMeans<Point>::Settings settings(KMeans<Point>::Settings::Seeding_PlusPlus,
+                                           centers[centerIdx]);
+    // Labels must not depend on the number of threads.
+    const int numThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    RandEngine serialRng(17ULL);
+    KMeans<Point>::PointList serialMeans;
+    KMeans<Point>::LabelList serialLabels;
+    KMeans<Point>::Run(K, KMeansIterations, 0, points,
+                       std::ptr_fun(ManhattanDistance), settings,
+                       &serialRng, &serialMeans, &serialLabels);
+    omp_set_num_threads(numThreads);
+    RandEngine rng(17ULL);
+    KMeans<Point>::PointList means;
+    KMeans<Point>::LabelList labels;
+    KMeans<Point>::Run(K, KMeansIterations, 0, points,
+                       std::ptr_fun(ManhattanDistance), settings,
+                       &rng, &means, &labels);
+    ASSERT_EQ(static_cast<size_t>(NumPoints), labels.size());
+    EXPECT_TRUE(serialLabels == labels);
+    // Each center must match the points gathered into its cluster.
+    KMeans<Point>::ClusterList clusters;
+    KMeans<Point>::MakeClusters(K, points, labels, &clusters);
+    for (int clusterIdx = 0; clusterIdx < K; ++clusterIdx)
+    {
+      ASSERT_FALSE(clusters[clusterIdx].empty());
+      const Point center = (KMeans<Point>::Settings::Center_Mean == centers[centerIdx]) ?
+        ReferenceMean(clusters[clusterIdx]) :
+        ReferenceMedian(clusters[clusterIdx]);
+      EXPECT_EQ(center.x, means[clusterIdx].x);
+      EXPECT_EQ(center.y, means[clusterIdx].y);
+      EXPECT_EQ(serialMeans[clusterIdx].x, means[clusterIdx].x);
+      EXPECT_EQ(serialMeans[clusterIdx].y, means[clusterIdx].y);
+    }
+  }
+}
+
+TEST(KMeansWeights, k_means)
+{
+  enum { NumPoints = 4000, };
+  enum { K = 6, };
+  enum { GridSize = 1000, };
+  enum { MaxWeight = 4, };
+  enum { KMeansIterations = 100, };
+  RandEngine pointRng(20ULL);
+  KMeans<Point>::PointList points(NumPoints);
+  std::vector<int> weights(NumPoints);
+  for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+  {
+    points[pointIdx] = Point(RandBound(&pointRng, GridSize),
+                             RandBound(&pointRng, GridSize));
+    weights[pointIdx] = 1 + RandBound(&pointRng, MaxWeight);
+  }
+  const KMeans<Point>::Settings::Center centers[] =
+  {
+    KMeans<Point>::Settings::Center_Mean,
+    KMeans<Point>::Settings::Center_Median,
+  };
+  for (int centerIdx = 0; centerIdx < 2; ++centerIdx)
+  {
+    const KMeans<Point>::Settings settings(KMeans<Point>::Settings::Seeding_PlusPlus,
+                                           centers[centerIdx], &weights);
+    RandEngine rng(21ULL);
+    KMeans<Point>::PointList means;
+    KMeans<Point>::LabelList labels;
+    KMeans<Point>::Run(K, KMeansIterations, 0, points,
+                       std::ptr_fun(ManhattanDistance), settings,
+                       &rng, &means, &labels);
+    ASSERT_EQ(static_cast<size_t>(NumPoints), labels.size());
+    // A point of weight w counts as w copies of the point.
+    KMeans<Point>::ClusterList clusters(K);
+    double inertia = 0.0;
+    for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+    {
+      const int label = labels[pointIdx];
+      clusters[label].insert(clusters[label].end(), weights[pointIdx],
+                             points[pointIdx]);
+      inertia += weights[pointIdx] * ManhattanDistance(points[pointIdx],
+                                                       means[label]);
+    }
+    for (int clusterIdx = 0; clusterIdx < K; ++clusterIdx)
+    {
+      ASSERT_FALSE(clusters[clusterIdx].empty());
+      const Point center = (KMeans<Point>::Settings::Center_Mean == centers[centerIdx]) ?
+        ReferenceMean(clusters[clusterIdx]) :
+        ReferenceMedian(clusters[clusterIdx]);
+      EXPECT_EQ(center.x, means[clusterIdx].x);
+      EXPECT_EQ(center.y, means[clusterIdx].y);
+    }
+    EXPECT_EQ(inertia, KMeans<Point>::Inertia(points, std::ptr_fun(ManhattanDistance),
+                                              means, labels, &weights));
+  }
+}
+
+TEST(KMeansManhattanKernel, k_means)
+{
+  enum { KMeansIterations = 1000, };
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  KMeans<Point>::PointList points;
+  points.reserve(victims.size());
+  for (VictimList::const_iterator victim = victims.begin();
+       victim != victims.end();
+       ++victim)
+  {
+    points.push_back(victim->position);
+  }
+  const int k = static_cast<int>(hospitalAmbulances.size());
+  // The kernel must give the same clusters as the generic scan.
+  typedef KMeans<Point, HamerlyAssignment> KMeansType;
+  const KMeansType::Settings settings(KMeansType::Settings::Seeding_PlusPlus,
+                                      KMeansType::Settings::Center_Median);
+  RandEngine genericRng(23ULL);
+  KMeans<Point>::PointList genericMeans;
+  KMeans<Point>::LabelList genericLabels;
+  KMeansType::Run(k, KMeansIterations, 0, points,
+                  std::ptr_fun(ManhattanDistance), settings,
+                  &genericRng, &genericMeans, &genericLabels);
+  RandEngine kernelRng(23ULL);
+  KMeans<Point>::PointList kernelMeans;
+  KMeans<Point>::LabelList kernelLabels;
+  KMeansType::Run(k, KMeansIterations, 0, points,
+                  ManhattanDistanceFunc(), settings,
+                  &kernelRng, &kernelMeans, &kernelLabels);
+  EXPECT_TRUE(genericLabels == kernelLabels);
+  ASSERT_EQ(genericMeans.size(), kernelMeans.size());
+  for (int meanIdx = 0; meanIdx < k; ++meanIdx)
+  {
+    EXPECT_EQ(genericMeans[meanIdx].x, kernelMeans[meanIdx].x);
+    EXPECT_EQ(genericMeans[meanIdx].y, kernelMeans[meanIdx].y);
+  }
+}
+
+TEST(KMeansRestarts, k_means)
+{
+  enum { KMeansIterations = 1000, };
+  enum { NumRestarts = 6, };
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  KMeans<Point>::PointList points;
+  points.reserve(victims.size());
+  for (VictimList::const_iterator victim = victims.begin();
+       victim != victims.end();
+       ++victim)
+  {
+    points.push_back(victim->position);
+  }
+  const int k = static_cast<int>(hospitalAmbulances.size());
+  const KMeans<Point>::Settings settings(KMeans<Point>::Settings::Seeding_PlusPlus,
+                                         KMeans<Point>::Settings::Center_Median);
+  RandEngine rng(29ULL);
+  KMeans<Point>::PointList means;
+  KMeans<Point>::LabelList labels;
+  std::vector<KMeans<Point>::Restart> restarts;
+  const int bestIdx = KMeans<Point>::RunRestarts(k, KMeansIterations, 0, points,
+                                                 std::ptr_fun(ManhattanDistance),
+                                                 settings, NumRestarts, &rng,
+                                                 &means, &labels, &restarts);
+  ASSERT_EQ(static_cast<size_t>(NumRestarts), restarts.size());
+  ASSERT_TRUE((bestIdx >= 0) && (bestIdx < NumRestarts));
+  // The best restart has the least inertia, and is the first to have it.
+  for (int restartIdx = 0; restartIdx < NumRestarts; ++restartIdx)
+  {
+    EXPECT_GT(restarts[restartIdx].iterations, 0);
+    EXPECT_LE(restarts[bestIdx].inertia, restarts[restartIdx].inertia);
+    if (restartIdx < bestIdx)
+    {
+      EXPECT_LT(restarts[bestIdx].inertia, restarts[restartIdx].inertia);
+    }
+  }
+  EXPECT_EQ(restarts[bestIdx].inertia,
+            KMeans<Point>::Inertia(points, std::ptr_fun(ManhattanDistance),
+                                   means, labels));
+  // Each restart is a plain run on its own split stream.
+  RandEngine replayRng(29ULL);
+  RandEngine bestRng(0ULL);
+  for (int restartIdx = 0; restartIdx <= bestIdx; ++restartIdx)
+  {
+    bestRng = replayRng.Split();
+  }
+  KMeans<Point>::PointList replayMeans;
+  KMeans<Point>::LabelList replayLabels;
+  const int replayIterations = KMeans<Point>::Run(k, KMeansIterations, 0, points,
+                                                  std::ptr_fun(ManhattanDistance),
+                                                  settings, &bestRng,
+                                                  &replayMeans, &replayLabels);
+  EXPECT_EQ(restarts[bestIdx].iterations, replayIterations);
+  EXPECT_TRUE(replayLabels == labels);
+}
+
+TEST(MiniBatchWeightedSample, k_means)
+{
+  enum { NumPoints = 4, };
+  enum { NumDraws = 40000, };
+  KMeans<Point>::PointList points;
+  std::vector<int> weights;
+  for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+  {
+    points.push_back(Point(pointIdx, 0));
+    weights.push_back(pointIdx);
+  }
+  RandEngine rng(38ULL);
+  MiniBatchKMeans<Point>::SampleSource<RandEngine> source(points, &rng,
+                                                          &weights);
+  KMeans<Point>::PointList draws(NumDraws);
+  ASSERT_EQ(static_cast<int>(NumDraws), source.Read(&draws[0], NumDraws));
+  // Point i has weight i out of a total of 6.
+  std::vector<int> counts(NumPoints, 0);
+  for (int drawIdx = 0; drawIdx < NumDraws; ++drawIdx)
+  {
+    ++counts[draws[drawIdx].x];
+  }
+  EXPECT_EQ(0, counts[0]);
+  for (int pointIdx = 1; pointIdx < NumPoints; ++pointIdx)
+  {
+    EXPECT_NEAR(pointIdx / 6.0,
+                static_cast<double>(counts[pointIdx]) / NumDraws, 0.01);
+  }
+}
+
+TEST(MiniBatchKMeans, k_means)
+{
+  enum { K = 4, };
+  enum { PointsPerCluster = 40000, };
+  enum { HalfWidth = 20, };
+  enum { BatchSize = 256, };
+  enum { MaxBatches = 500, };
+  enum { MaxDistError = 6, };
+  const Point centers[K] = { Point(100, 100), Point(900, 150),
+                             Point(200, 800), Point(700, 700), };
+  // Square blobs around each center in random order.
+  RandEngine pointRng(31ULL);
+  KMeans<Point>::PointList points;
+  points.reserve(K * PointsPerCluster);
+  for (int clusterIdx = 0; clusterIdx < K; ++clusterIdx)
+  {
+    for (int pointIdx = 0; pointIdx < PointsPerCluster; ++pointIdx)
+    {
+      points.push_back(Point(centers[clusterIdx].x + pointRng.Bound(2 * HalfWidth + 1) - HalfWidth,
+                             centers[clusterIdx].y + pointRng.Bound(2 * HalfWidth + 1) - HalfWidth));
+    }
+  }
+  for (int pointIdx = static_cast<int>(points.size()) - 1; pointIdx > 0; --pointIdx)
+  {
+    std::swap(points[pointIdx], points[pointRng.Bound(pointIdx + 1)]);
+  }
+  for (int sourceIdx = 0; sourceIdx < 2; ++sourceIdx)
+  {
+    RandEngine rng(37ULL);
+    KMeans<Point>::PointList means;
+    std::vector<long long> counts;
+    int numBatches;
+    if (0 == sourceIdx)
+    {
+      MiniBatchKMeans<Point>::SampleSource<RandEngine> source(points, &rng);
+      numBatches = MiniBatchKMeans<Point>::Run(K, BatchSize, MaxBatches, -1,
+                                               ManhattanDistanceFunc(),
+                                               &source, &rng, &means, &counts);
+      EXPECT_EQ(MaxBatches, numBatches);
+    }
+    else
+    {
+      // A stream runs out after one pass.
+      typedef KMeans<Point>::PointList::const_iterator PointIterator;
+      MiniBatchKMeans<Point>::StreamSource<PointIterator> source(points.begin(),
+                                                                 points.end());
+      numBatches = MiniBatchKMeans<Point>::Run(K, BatchSize, 1000000, -1,
+                                               ManhattanDistanceFunc(),
+                                               &source, &rng, &means, &counts);
+      const int numPoints = static_cast<int>(points.size());
+      EXPECT_EQ((numPoints - BatchSize + BatchSize - 1) / BatchSize, numBatches);
+      EXPECT_EQ(numPoints - BatchSize,
+                std::accumulate(counts.begin(), counts.end(), 0LL));
+    }
+    ASSERT_EQ(static_cast<size_t>(K), means.size());
+    ASSERT_EQ(static_cast<size_t>(K), counts.size());
+    // Every center is recovered by one mean that took about a quarter of
+    // the points.
+    const long long total = std::accumulate(counts.begin(), counts.end(), 0LL);
+    std::vector<int> recovered(K, 0);
+    for (int clusterIdx = 0; clusterIdx < K; ++clusterIdx)
+    {
+      int closestIdx = 0;
+      for (int meanIdx = 1; meanIdx < K; ++meanIdx)
+      {
+        if (ManhattanDistance(centers[clusterIdx], means[meanIdx]) <
+            ManhattanDistance(centers[clusterIdx], means[closestIdx]))
+        {
+          closestIdx = meanIdx;
+        }
+      }
+      EXPECT_LE(ManhattanDistance(centers[clusterIdx], means[closestIdx]),
+                static_cast<int>(MaxDistError));
+      EXPECT_NEAR(0.25, static_cast<double>(counts[closestIdx]) / total, 0.02);
+      ++recovered[closestIdx];
+    }
+    EXPECT_EQ(K, std::count(recovered.begin(), recovered.end(), 1));
+  }
+}
+
 }
 
 #endif //_HPS_AMBULANCE_KMEANS_GTEST_H_
@@ -0,0 +1,55 @@
+#ifndef _HPS_AMBULANCE_KMEANS_MANHATTAN_H_
+#define _HPS_AMBULANCE_KMEANS_MANHATTAN_H_
+#include "k-means.h"
+#include "ambulance_core.h"
+#include "score_kernels.h"
+#include <vector>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Manhattan distance between Points as a functor. </summary>
+/// <remarks>
+///   <para> KMeans given this functor finds nearest means with the
+///     vectorized NearestPointKernel. std::ptr_fun(ManhattanDistance) gives
+///     the same clusters through the generic scan.
+///   </para>
+/// </remarks>
+struct ManhattanDistanceFunc
+{
+  typedef Point first_argument_type;
+  typedef Point second_argument_type;
+  typedef int result_type;
+
+  inline int operator()(const Point& lhs, const Point& rhs) const
+  {
+    return ManhattanDistance(lhs, rhs);
+  }
+};
+
+}
+
+namespace clustering
+{
+
+template <>
+struct NearestMeans<Point, ManhattanDistanceFunc>
+{
+  inline static void Run(const Point* points, const int numPoints,
+                         const ManhattanDistanceFunc& /*distanceFunc*/,
+                         const std::vector<Point>& means,
+                         int* closestIdx, int* closestDist, int* secondDist)
+  {
+    NearestPointKernel(points, numPoints, &means[0],
+                       static_cast<int>(means.size()),
+                       closestIdx, closestDist, secondDist);
+  }
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_KMEANS_MANHATTAN_H_
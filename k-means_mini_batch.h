@@ -0,0 +1,236 @@
+#ifndef _HPS_AMBULANCE_KMEANS_MINI_BATCH_H_
+#define _HPS_AMBULANCE_KMEANS_MINI_BATCH_H_
+#include "k-means.h"
+#include "deadline.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+namespace hps
+{
+namespace clustering
+{
+
+/// <summary> K-means from small random batches of points. </summary>
+/// <remarks>
+///   <para> Mini-batch k-means, taken from:
+///       D. Sculley. 2010. Web-scale k-means clustering. In Proceedings of
+///       the 19th International Conference on World Wide Web, 1177-1178.
+///   </para>
+///   <para> Each batch is assigned to the current centers and every point
+///     then pulls its center toward it by 1 / n, where n is the number of
+///     points the center has taken so far. Each center so has its own
+///     learning rate that falls as it settles. A batch costs O(batch * k)
+///     however many points there are.
+///   </para>
+///   <para> Points come from a source with the method
+///       int Read(PointType* points, int maxPoints)
+///     that fills up to maxPoints points and returns how many it gave, or
+///     zero once it is out of points. SampleSource draws batches from a
+///     list in memory. Given weights, it draws each point with chance in
+///     proportion to its weight, so a point of weight w counts as w copies
+///     as in weighted KMeans. StreamSource reads an input range once, so
+///     the points never have to be held at once; they should come in
+///     random order.
+///   </para>
+///   <para> Centers are kept in double precision and rounded to PointType
+///     to find nearest centers, so a NearestMeans specialization applies.
+///   </para>
+/// </remarks>
+template <typename PointType>
+struct MiniBatchKMeans
+{
+  typedef std::vector<PointType> PointList;
+
+  /// <summary> Batches drawn with replacement from a list of points. </summary>
+  template <typename RandomEngine>
+  class SampleSource
+  {
+  public:
+    SampleSource(const PointList& points, RandomEngine* rng,
+                 const std::vector<int>* weights = NULL)
+      : m_points(&points),
+        m_rng(rng),
+        m_cumulativeWeights()
+    {
+      assert(rng);
+      if (weights)
+      {
+        assert(weights->size() == points.size());
+        m_cumulativeWeights.resize(weights->size());
+        double total = 0.0;
+        for (size_t pointIdx = 0; pointIdx < weights->size(); ++pointIdx)
+        {
+          assert((*weights)[pointIdx] >= 0);
+          total += (*weights)[pointIdx];
+          m_cumulativeWeights[pointIdx] = total;
+        }
+      }
+    }
+
+    inline int Read(PointType* points, const int maxPoints)
+    {
+      const int numPoints = static_cast<int>(m_points->size());
+      if ((0 == numPoints) ||
+          (!m_cumulativeWeights.empty() && (m_cumulativeWeights.back() <= 0.0)))
+      {
+        return 0;
+      }
+      for (int pointIdx = 0; pointIdx < maxPoints; ++pointIdx)
+      {
+        points[pointIdx] = (*m_points)[Draw(numPoints)];
+      }
+      return maxPoints;
+    }
+
+  private:
+    inline int Draw(const int numPoints)
+    {
+      if (m_cumulativeWeights.empty())
+      {
+        return m_rng->Bound(numPoints);
+      }
+      // The first point whose cumulative weight passes the draw.
+      const double draw = m_rng->Uniform() * m_cumulativeWeights.back();
+      const int drawIdx = static_cast<int>(
+        std::upper_bound(m_cumulativeWeights.begin(), m_cumulativeWeights.end(),
+                         draw) - m_cumulativeWeights.begin());
+      return std::min(drawIdx, numPoints - 1);
+    }
+
+    const PointList* m_points;
+    RandomEngine* m_rng;
+    std::vector<double> m_cumulativeWeights;
+  };
+
+  /// <summary> Points read once from an input range. </summary>
+  template <typename InputIterator>
+  class StreamSource
+  {
+  public:
+    StreamSource(InputIterator begin, InputIterator end)
+      : m_next(begin),
+        m_end(end)
+    {}
+
+    inline int Read(PointType* points, const int maxPoints)
+    {
+      int numRead = 0;
+      for (; (numRead < maxPoints) && (m_next != m_end); ++numRead, ++m_next)
+      {
+        points[numRead] = *m_next;
+      }
+      return numRead;
+    }
+
+  private:
+    InputIterator m_next;
+    InputIterator m_end;
+  };
+
+  /// <summary> Run mini-batch k-means with given distance function. </summary>
+  /// <remarks>
+  ///   <para> Centers are seeded by k-means++ on the first batch, which is
+  ///     read with room for at least k points and must give them. Batches
+  ///     then run until maxBatches, until the source runs out, until no
+  ///     center moves more than deltaDistStable in all over a batch, or
+  ///     until the deadline expires.
+  ///   </para>
+  ///   <para> When counts is given, it gets the number of points each
+  ///     center took, which estimates the relative sizes of the clusters.
+  ///   </para>
+  /// </remarks>
+  /// <returns> The number of batches run after seeding. </returns>
+  template <typename DistanceFunc, typename PointSource, typename RandomEngine>
+  static int Run(const int k, const int batchSize, const int maxBatches,
+                 const typename DistanceFunc::result_type deltaDistStable,
+                 const DistanceFunc& distanceFunc,
+                 PointSource* source, RandomEngine* rng,
+                 PointList* means, std::vector<long long>* counts = NULL,
+                 const Deadline* deadline = NULL);
+};
+
+template <typename PointType>
+template <typename DistanceFunc, typename PointSource, typename RandomEngine>
+int MiniBatchKMeans<PointType>::Run(const int k, const int batchSize,
+                                    const int maxBatches,
+                                    const typename DistanceFunc::result_type deltaDistStable,
+                                    const DistanceFunc& distanceFunc,
+                                    PointSource* source, RandomEngine* rng,
+                                    PointList* means,
+                                    std::vector<long long>* counts,
+                                    const Deadline* deadline)
+{
+  typedef typename DistanceFunc::result_type DistanceType;
+  assert(source && rng && means);
+  assert((k > 0) && (batchSize > 0));
+  // Seed from the first batch.
+  PointList batch(std::max(batchSize, k));
+  const int seedCount = source->Read(&batch[0], static_cast<int>(batch.size()));
+  assert(seedCount >= k);
+  batch.resize(seedCount);
+  KMeans<PointType>::SeedPlusPlus(k, batch, distanceFunc, rng, means);
+  std::vector<double> centerX(k);
+  std::vector<double> centerY(k);
+  for (int meanIdx = 0; meanIdx < k; ++meanIdx)
+  {
+    centerX[meanIdx] = (*means)[meanIdx].x;
+    centerY[meanIdx] = (*means)[meanIdx].y;
+  }
+  std::vector<long long> taken(k, 0);
+  std::vector<int> closestIdx(batchSize);
+  PointList prevMeans(k);
+  batch.resize(batchSize);
+  int numBatches = 0;
+  while (numBatches < maxBatches)
+  {
+    if (deadline && deadline->Expired())
+    {
+      break;
+    }
+    const int count = source->Read(&batch[0], batchSize);
+    if (0 == count)
+    {
+      break;
+    }
+    ++numBatches;
+    // Assign the whole batch before moving any center.
+    NearestMeans<PointType, DistanceFunc>::Run(&batch[0], count, distanceFunc,
+                                               *means, &closestIdx[0],
+                                               NULL, NULL);
+    for (int pointIdx = 0; pointIdx < count; ++pointIdx)
+    {
+      const int meanIdx = closestIdx[pointIdx];
+      const double rate = 1.0 / static_cast<double>(++taken[meanIdx]);
+      centerX[meanIdx] += rate * (batch[pointIdx].x - centerX[meanIdx]);
+      centerY[meanIdx] += rate * (batch[pointIdx].y - centerY[meanIdx]);
+    }
+    // Round the centers and see if they settled.
+    prevMeans.swap(*means);
+    means->resize(k);
+    DistanceType deltaDist = 0;
+    for (int meanIdx = 0; meanIdx < k; ++meanIdx)
+    {
+      (*means)[meanIdx] =
+        PointType(static_cast<int>(std::floor(centerX[meanIdx] + 0.5)),
+                  static_cast<int>(std::floor(centerY[meanIdx] + 0.5)));
+      deltaDist += distanceFunc((*means)[meanIdx], prevMeans[meanIdx]);
+    }
+    if (deltaDist <= deltaDistStable)
+    {
+      break;
+    }
+  }
+  if (counts)
+  {
+    counts->swap(taken);
+  }
+  return numBatches;
+}
+
+}
+using namespace clustering;
+}
+
+#endif //_HPS_AMBULANCE_KMEANS_MINI_BATCH_H_
@@ -0,0 +1,584 @@
+#include "local_search.h"
+#include "victim_grid.h"
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+namespace detail
+{
+/// <summary> Check if adding delta to a trip keeps everyone alive. </summary>
+template <typename Route>
+inline bool TripAbsorbs(const Route& route, const int trip, const int delta,
+                        const int newDeadline)
+{
+  return ((route.time[route.tripStart[trip + 1]] + delta) <= newDeadline) &&
+         (delta <= route.suffixSlack[trip + 1]);
+}
+}
+
+LocalSearch::LocalSearch()
+: m_victims(NULL),
+  m_hospitals(NULL),
+  m_nearestHospitals(),
+  m_distances(),
+  m_neighborStart(),
+  m_neighbors(),
+  m_routes(),
+  m_victimRoute(),
+  m_victimPos(),
+  m_scratch()
+{}
+
+int LocalSearch::Improve(const VictimList& victims,
+                         const HospitalList& hospitals,
+                         const Deadline& deadline,
+                         ActionSequenceList* actionSequences)
+{
+  assert(actionSequences);
+  m_victims = &victims;
+  m_hospitals = &hospitals;
+  const int numVictims = static_cast<int>(victims.size());
+  const int numRoutes = actionSequences->Size();
+  m_victimRoute.assign(numVictims, -1);
+  m_victimPos.assign(numVictims, -1);
+  if (victims.empty() || hospitals.empty() || (0 == numRoutes))
+  {
+    return 0;
+  }
+  m_nearestHospitals.Build(victims, hospitals);
+  if (m_distances.Assign(victims, hospitals))
+  {
+    BuildNeighbors();
+  }
+  // Load routes.
+  m_routes.resize(numRoutes);
+  for (int routeIdx = 0; routeIdx < numRoutes; ++routeIdx)
+  {
+    const ActionSequence seq = (*actionSequences)[routeIdx];
+    std::vector<int>& stops = m_routes[routeIdx].stops;
+    stops.clear();
+    for (ActionSequence::const_iterator node = seq.begin();
+         node != seq.end();
+         ++node)
+    {
+      if (ActionNode::StopType_Hospital == node->Type())
+      {
+        stops.push_back(~(node->Id() - 1));
+      }
+      else
+      {
+        stops.push_back(node->Id() - 1);
+      }
+    }
+    Rebuild(routeIdx);
+  }
+  // Search until no move helps.
+  for (int pass = 0; (pass < MaxPasses) && !deadline.Expired(); ++pass)
+  {
+    bool changed = InsertPass(deadline);
+    changed = RelocatePass(deadline) || changed;
+    changed = SwapPass(deadline) || changed;
+    changed = TwoOptStarPass(deadline) || changed;
+    if (!changed)
+    {
+      break;
+    }
+  }
+  // Store routes.
+  actionSequences->Clear();
+  for (int routeIdx = 0; routeIdx < numRoutes; ++routeIdx)
+  {
+    actionSequences->AddRoute();
+    const std::vector<int>& stops = m_routes[routeIdx].stops;
+    for (std::vector<int>::const_iterator stop = stops.begin();
+         stop != stops.end();
+         ++stop)
+    {
+      if (IsHospital(*stop))
+      {
+        actionSequences->AddStop(ActionNode(~*stop + 1,
+                                            ActionNode::StopType_Hospital));
+      }
+      else
+      {
+        actionSequences->AddStop(ActionNode(*stop + 1,
+                                            ActionNode::StopType_Victim));
+      }
+    }
+  }
+  return numVictims - static_cast<int>(std::count(m_victimRoute.begin(),
+                                                  m_victimRoute.end(), -1));
+}
+
+void LocalSearch::Rebuild(const int routeIdx)
+{
+  Route& route = m_routes[routeIdx];
+  const std::vector<int>& stops = route.stops;
+  const int numStops = static_cast<int>(stops.size());
+  assert((numStops > 0) && IsHospital(stops.front()) && IsHospital(stops.back()));
+  route.time.resize(numStops);
+  route.tripOf.assign(numStops, -1);
+  route.tripStart.clear();
+  route.time[0] = 0;
+  route.tripStart.push_back(0);
+  for (int pos = 1; pos < numStops; ++pos)
+  {
+    const int stop = stops[pos];
+    route.time[pos] = route.time[pos - 1] + Leg(stops[pos - 1], stop);
+    if (IsHospital(stop))
+    {
+      route.tripStart.push_back(pos);
+    }
+    else
+    {
+      route.tripOf[pos] = static_cast<int>(route.tripStart.size()) - 1;
+      m_victimRoute[stop] = routeIdx;
+      m_victimPos[stop] = pos;
+    }
+  }
+  // Deadlines and slack of trips.
+  const int numTrips = route.NumTrips();
+  route.tripDeadline.assign(numTrips, std::numeric_limits<int>::max());
+  for (int pos = 1; pos < numStops; ++pos)
+  {
+    if (!IsHospital(stops[pos]))
+    {
+      int& tripDeadline = route.tripDeadline[route.tripOf[pos]];
+      tripDeadline = std::min(tripDeadline, (*m_victims)[stops[pos]].timeToLive);
+    }
+  }
+  route.suffixSlack.resize(numTrips + 1);
+  route.suffixSlack[numTrips] = std::numeric_limits<int>::max();
+  for (int trip = numTrips - 1; trip >= 0; --trip)
+  {
+    const int slack = route.tripDeadline[trip] -
+                      route.time[route.tripStart[trip + 1]];
+    assert(slack >= 0);
+    route.suffixSlack[trip] = std::min(slack, route.suffixSlack[trip + 1]);
+  }
+}
+
+void LocalSearch::BuildNeighbors()
+{
+  const int numVictims = static_cast<int>(m_victims->size());
+  SimVictimStore simVictims;
+  simVictims.Assign(*m_victims);
+  VictimGrid grid;
+  grid.Build(simVictims);
+  m_neighborStart.resize(numVictims + 1);
+  m_neighbors.clear();
+  std::vector<int> nearest;
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    m_neighborStart[victimIdx] = static_cast<int>(m_neighbors.size());
+    // The victim itself is among the nearest.
+    grid.KNearest((*m_victims)[victimIdx].position, NeighborCandidates + 1,
+                  &nearest);
+    for (std::vector<int>::const_iterator neighbor = nearest.begin();
+         neighbor != nearest.end();
+         ++neighbor)
+    {
+      if ((*neighbor != victimIdx) &&
+          ((m_neighbors.size() - m_neighborStart[victimIdx]) <
+           static_cast<size_t>(NeighborCandidates)))
+      {
+        m_neighbors.push_back(*neighbor);
+      }
+    }
+  }
+  m_neighborStart[numVictims] = static_cast<int>(m_neighbors.size());
+}
+
+int LocalSearch::TripDeadlineWithout(const Route& route, const int trip,
+                                     const int skipPos) const
+{
+  int tripDeadline = std::numeric_limits<int>::max();
+  for (int pos = route.tripStart[trip] + 1;
+       pos < route.tripStart[trip + 1];
+       ++pos)
+  {
+    if (pos != skipPos)
+    {
+      tripDeadline = std::min(tripDeadline,
+                              (*m_victims)[route.stops[pos]].timeToLive);
+    }
+  }
+  return tripDeadline;
+}
+
+int LocalSearch::RemovalDelta(const Route& route, const int pos) const
+{
+  const std::vector<int>& stops = route.stops;
+  const int prev = stops[pos - 1];
+  const int victim = stops[pos];
+  const int next = stops[pos + 1];
+  if (route.TripSize(route.tripOf[pos]) > 1)
+  {
+    return Leg(prev, next) - Leg(prev, victim) - Leg(victim, next);
+  }
+  // The trip empties, so its hospital stop goes too.
+  int delta = -Leg(prev, victim) - Leg(victim, next);
+  if (pos + 2 < static_cast<int>(stops.size()))
+  {
+    delta += Leg(prev, stops[pos + 2]) - Leg(next, stops[pos + 2]);
+  }
+  return delta;
+}
+
+void LocalSearch::TryInsertion(const int victimIdx, const int newDeadline,
+                               const int routeIdx, const int trip,
+                               const int pos, Insertion* best) const
+{
+  const Route& route = m_routes[routeIdx];
+  const std::vector<int>& stops = route.stops;
+  const int delta = Leg(stops[pos - 1], victimIdx) +
+                    Leg(victimIdx, stops[pos]) -
+                    Leg(stops[pos - 1], stops[pos]);
+  if ((delta < best->delta) &&
+      detail::TripAbsorbs(route, trip, delta, newDeadline))
+  {
+    best->routeIdx = routeIdx;
+    best->pos = pos;
+    best->delta = delta;
+    best->newTrip = false;
+  }
+}
+
+void LocalSearch::FindInsertion(const int victimIdx, const int skipRouteIdx,
+                                Insertion* best) const
+{
+  assert(best);
+  const int timeToLive = (*m_victims)[victimIdx].timeToLive;
+  const int numRoutes = static_cast<int>(m_routes.size());
+  for (int routeIdx = 0; routeIdx < numRoutes; ++routeIdx)
+  {
+    if (routeIdx == skipRouteIdx)
+    {
+      continue;
+    }
+    const Route& route = m_routes[routeIdx];
+    for (int trip = 0; trip < route.NumTrips(); ++trip)
+    {
+      // An insert adds at least one unit of time. Trips only end later
+      // along the route, so no later trip may take the victim either.
+      if (route.time[route.tripStart[trip + 1]] >= timeToLive)
+      {
+        break;
+      }
+      if (route.TripSize(trip) >= MaxVictimsPerTrip)
+      {
+        continue;
+      }
+      const int newDeadline = std::min(route.tripDeadline[trip], timeToLive);
+      for (int pos = route.tripStart[trip] + 1;
+           pos <= route.tripStart[trip + 1];
+           ++pos)
+      {
+        TryInsertion(victimIdx, newDeadline, routeIdx, trip, pos, best);
+      }
+    }
+  }
+}
+
+void LocalSearch::FindNeighborInsertion(const int victimIdx,
+                                        const int skipRouteIdx,
+                                        Insertion* best) const
+{
+  assert(best);
+  const int timeToLive = (*m_victims)[victimIdx].timeToLive;
+  for (int neighborIdx = m_neighborStart[victimIdx];
+       neighborIdx < m_neighborStart[victimIdx + 1];
+       ++neighborIdx)
+  {
+    const int neighbor = m_neighbors[neighborIdx];
+    const int routeIdx = m_victimRoute[neighbor];
+    if ((routeIdx < 0) || (routeIdx == skipRouteIdx))
+    {
+      continue;
+    }
+    const Route& route = m_routes[routeIdx];
+    const int neighborPos = m_victimPos[neighbor];
+    const int trip = route.tripOf[neighborPos];
+    if ((route.time[route.tripStart[trip + 1]] >= timeToLive) ||
+        (route.TripSize(trip) >= MaxVictimsPerTrip))
+    {
+      continue;
+    }
+    // Just before or just after the neighbor.
+    const int newDeadline = std::min(route.tripDeadline[trip], timeToLive);
+    TryInsertion(victimIdx, newDeadline, routeIdx, trip, neighborPos, best);
+    TryInsertion(victimIdx, newDeadline, routeIdx, trip, neighborPos + 1,
+                 best);
+  }
+}
+
+void LocalSearch::ApplyInsertion(const int victimIdx,
+                                 const Insertion& insertion)
+{
+  assert(insertion.routeIdx >= 0);
+  std::vector<int>& stops = m_routes[insertion.routeIdx].stops;
+  if (insertion.newTrip)
+  {
+    stops.push_back(victimIdx);
+    stops.push_back(~m_nearestHospitals[victimIdx].hospitalIdx);
+  }
+  else
+  {
+    stops.insert(stops.begin() + insertion.pos, victimIdx);
+  }
+  Rebuild(insertion.routeIdx);
+}
+
+void LocalSearch::RemoveVictim(const int victimIdx)
+{
+  const int routeIdx = m_victimRoute[victimIdx];
+  const int pos = m_victimPos[victimIdx];
+  assert(routeIdx >= 0);
+  Route& route = m_routes[routeIdx];
+  const int numErased = (route.TripSize(route.tripOf[pos]) > 1) ? 1 : 2;
+  route.stops.erase(route.stops.begin() + pos,
+                    route.stops.begin() + pos + numErased);
+  m_victimRoute[victimIdx] = -1;
+  m_victimPos[victimIdx] = -1;
+  Rebuild(routeIdx);
+}
+
+bool LocalSearch::InsertPass(const Deadline& deadline)
+{
+  bool inserted = false;
+  const int numVictims = static_cast<int>(m_victimRoute.size());
+  const int numRoutes = static_cast<int>(m_routes.size());
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    if (m_victimRoute[victimIdx] >= 0)
+    {
+      continue;
+    }
+    if (deadline.Expired())
+    {
+      break;
+    }
+    Insertion best;
+    best.delta = std::numeric_limits<int>::max();
+    FindInsertion(victimIdx, -1, &best);
+    // A new trip at the end of a route.
+    const int timeToLive = (*m_victims)[victimIdx].timeToLive;
+    const int hospital = ~m_nearestHospitals[victimIdx].hospitalIdx;
+    for (int routeIdx = 0; routeIdx < numRoutes; ++routeIdx)
+    {
+      const Route& route = m_routes[routeIdx];
+      const int delta = Leg(route.stops.back(), victimIdx) +
+                        Leg(victimIdx, hospital);
+      if ((delta < best.delta) && (route.EndTime() + delta <= timeToLive))
+      {
+        best.routeIdx = routeIdx;
+        best.pos = static_cast<int>(route.stops.size());
+        best.delta = delta;
+        best.newTrip = true;
+      }
+    }
+    if (best.routeIdx >= 0)
+    {
+      ApplyInsertion(victimIdx, best);
+      inserted = true;
+    }
+  }
+  return inserted;
+}
+
+bool LocalSearch::RelocatePass(const Deadline& deadline)
+{
+  bool improved = false;
+  const int numVictims = static_cast<int>(m_victimRoute.size());
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    const int routeIdx = m_victimRoute[victimIdx];
+    if (routeIdx < 0)
+    {
+      continue;
+    }
+    if (deadline.Expired())
+    {
+      break;
+    }
+    // Removal always keeps the source route feasible.
+    const int removalDelta = RemovalDelta(m_routes[routeIdx],
+                                          m_victimPos[victimIdx]);
+    Insertion best;
+    best.delta = -removalDelta;
+    FindNeighborInsertion(victimIdx, routeIdx, &best);
+    if (best.routeIdx >= 0)
+    {
+      RemoveVictim(victimIdx);
+      ApplyInsertion(victimIdx, best);
+      improved = true;
+    }
+  }
+  return improved;
+}
+
+bool LocalSearch::SwapPass(const Deadline& deadline)
+{
+  bool improved = false;
+  const int numVictims = static_cast<int>(m_victimRoute.size());
+  for (int lhsIdx = 0; lhsIdx < numVictims; ++lhsIdx)
+  {
+    if (m_victimRoute[lhsIdx] < 0)
+    {
+      continue;
+    }
+    if (deadline.Expired())
+    {
+      break;
+    }
+    for (int neighborIdx = m_neighborStart[lhsIdx];
+         neighborIdx < m_neighborStart[lhsIdx + 1];
+         ++neighborIdx)
+    {
+      const int rhsIdx = m_neighbors[neighborIdx];
+      const int lhsRouteIdx = m_victimRoute[lhsIdx];
+      const int rhsRouteIdx = m_victimRoute[rhsIdx];
+      if ((rhsRouteIdx < 0) || (rhsRouteIdx == lhsRouteIdx))
+      {
+        continue;
+      }
+      Route& lhsRoute = m_routes[lhsRouteIdx];
+      Route& rhsRoute = m_routes[rhsRouteIdx];
+      const int lhsPos = m_victimPos[lhsIdx];
+      const int rhsPos = m_victimPos[rhsIdx];
+      const std::vector<int>& lhsStops = lhsRoute.stops;
+      const std::vector<int>& rhsStops = rhsRoute.stops;
+      // Each victim takes the place of the other.
+      const int lhsDelta = Leg(lhsStops[lhsPos - 1], rhsIdx) +
+                           Leg(rhsIdx, lhsStops[lhsPos + 1]) -
+                           Leg(lhsStops[lhsPos - 1], lhsIdx) -
+                           Leg(lhsIdx, lhsStops[lhsPos + 1]);
+      const int rhsDelta = Leg(rhsStops[rhsPos - 1], lhsIdx) +
+                           Leg(lhsIdx, rhsStops[rhsPos + 1]) -
+                           Leg(rhsStops[rhsPos - 1], rhsIdx) -
+                           Leg(rhsIdx, rhsStops[rhsPos + 1]);
+      if (lhsDelta + rhsDelta >= 0)
+      {
+        continue;
+      }
+      const int lhsTrip = lhsRoute.tripOf[lhsPos];
+      const int rhsTrip = rhsRoute.tripOf[rhsPos];
+      const int lhsDeadline =
+        std::min(TripDeadlineWithout(lhsRoute, lhsTrip, lhsPos),
+                 (*m_victims)[rhsIdx].timeToLive);
+      const int rhsDeadline =
+        std::min(TripDeadlineWithout(rhsRoute, rhsTrip, rhsPos),
+                 (*m_victims)[lhsIdx].timeToLive);
+      if (detail::TripAbsorbs(lhsRoute, lhsTrip, lhsDelta, lhsDeadline) &&
+          detail::TripAbsorbs(rhsRoute, rhsTrip, rhsDelta, rhsDeadline))
+      {
+        lhsRoute.stops[lhsPos] = rhsIdx;
+        rhsRoute.stops[rhsPos] = lhsIdx;
+        Rebuild(lhsRouteIdx);
+        Rebuild(rhsRouteIdx);
+        improved = true;
+      }
+    }
+  }
+  return improved;
+}
+
+bool LocalSearch::TwoOptStarPass(const Deadline& deadline)
+{
+  bool improved = false;
+  const int numRoutes = static_cast<int>(m_routes.size());
+  for (int lhsRouteIdx = 0; lhsRouteIdx < numRoutes; ++lhsRouteIdx)
+  {
+    if (deadline.Expired())
+    {
+      break;
+    }
+    for (int rhsRouteIdx = lhsRouteIdx + 1;
+         (rhsRouteIdx < numRoutes) && !deadline.Expired();
+         ++rhsRouteIdx)
+    {
+      Route& lhs = m_routes[lhsRouteIdx];
+      Route& rhs = m_routes[rhsRouteIdx];
+      const int lhsTrips = lhs.NumTrips();
+      const int rhsTrips = rhs.NumTrips();
+      const int oldEnd = lhs.EndTime() + rhs.EndTime();
+      // Find the best pair of hospital stops to cut at. The tail after a
+      // cut is delayed uniformly, so it fits when the delay is within the
+      // slack of its trips.
+      int bestGain = 0;
+      int bestLhsCut = -1;
+      int bestRhsCut = -1;
+      for (int lhsCut = 0; lhsCut <= lhsTrips; ++lhsCut)
+      {
+        const int lhsPos = lhs.tripStart[lhsCut];
+        for (int rhsCut = 0; rhsCut <= rhsTrips; ++rhsCut)
+        {
+          if ((lhsCut == lhsTrips) && (rhsCut == rhsTrips))
+          {
+            continue;
+          }
+          const int rhsPos = rhs.tripStart[rhsCut];
+          // The rhs tail follows the lhs head.
+          int newLhsEnd = lhs.time[lhsPos];
+          if (rhsCut < rhsTrips)
+          {
+            const int first = rhs.stops[rhsPos + 1];
+            const int shift = lhs.time[lhsPos] - rhs.time[rhsPos] +
+                              Leg(lhs.stops[lhsPos], first) -
+                              Leg(rhs.stops[rhsPos], first);
+            if (shift > rhs.suffixSlack[rhsCut])
+            {
+              continue;
+            }
+            newLhsEnd = rhs.EndTime() + shift;
+          }
+          // The lhs tail follows the rhs head.
+          int newRhsEnd = rhs.time[rhsPos];
+          if (lhsCut < lhsTrips)
+          {
+            const int first = lhs.stops[lhsPos + 1];
+            const int shift = rhs.time[rhsPos] - lhs.time[lhsPos] +
+                              Leg(rhs.stops[rhsPos], first) -
+                              Leg(lhs.stops[lhsPos], first);
+            if (shift > lhs.suffixSlack[lhsCut])
+            {
+              continue;
+            }
+            newRhsEnd = lhs.EndTime() + shift;
+          }
+          const int gain = oldEnd - newLhsEnd - newRhsEnd;
+          if (gain > bestGain)
+          {
+            bestGain = gain;
+            bestLhsCut = lhsCut;
+            bestRhsCut = rhsCut;
+          }
+        }
+      }
+      if (bestGain > 0)
+      {
+        const int lhsPos = lhs.tripStart[bestLhsCut];
+        const int rhsPos = rhs.tripStart[bestRhsCut];
+        m_scratch.assign(lhs.stops.begin(), lhs.stops.begin() + lhsPos + 1);
+        m_scratch.insert(m_scratch.end(),
+                         rhs.stops.begin() + rhsPos + 1, rhs.stops.end());
+        rhs.stops.erase(rhs.stops.begin() + rhsPos + 1, rhs.stops.end());
+        rhs.stops.insert(rhs.stops.end(),
+                         lhs.stops.begin() + lhsPos + 1, lhs.stops.end());
+        lhs.stops.swap(m_scratch);
+        Rebuild(lhsRouteIdx);
+        Rebuild(rhsRouteIdx);
+        improved = true;
+      }
+    }
+  }
+  return improved;
+}
+
+}
+}
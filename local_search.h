@@ -0,0 +1,173 @@
+#ifndef _HPS_AMBULANCE_LOCAL_SEARCH_H_
+#define _HPS_AMBULANCE_LOCAL_SEARCH_H_
+#include "ambulance_core.h"
+#include "distance_oracle.h"
+#include "deadline.h"
+#include <vector>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Improve rescue routes after construction by local search. </summary>
+/// <remarks>
+///   <para> Moves are tried between ambulances:
+///     insert   - add an unrescued victim to a trip or as a new last trip;
+///     relocate - move a victim from one route to a trip of another;
+///     swap     - trade two victims between routes;
+///     2-opt*   - trade the trips after a hospital stop between routes.
+///     Inserts rescue more victims. The other moves are taken when they
+///     shorten the total time of the routes, which leaves slack for inserts.
+///   </para>
+///   <para> An insert tries every trip. Relocates and swaps try only the
+///     NeighborCandidates victims nearest to the one moved: a relocate puts
+///     it next to a neighbor and a swap trades it with one. A pass is then
+///     O(V * NeighborCandidates) rather than O(V^2), and the deadline is
+///     checked before each victim.
+///   </para>
+///   <para> A route is a run of trips, each ending at a hospital. Every
+///     route keeps the arrival time at each stop, the deadline of each trip
+///     (its least time to live) and the forward slack from each trip on
+///     (the most time that may be added before it without anyone dying).
+///     Adding time t to trip k keeps everyone alive exactly when trip k
+///     still meets its deadline and t is within the slack of the trips
+///     after it, so each move is checked in O(1). A route is rebuilt only
+///     when a move is applied.
+///   </para>
+///   <para> Hospital stops stay where they are, except that a trip emptied
+///     by a relocate is dropped. Routes keep their first hospital, so the
+///     ambulances per hospital do not change.
+///   </para>
+///   <para> Legs are read from a DistanceOracle. Its victim distances and
+///     the neighbor lists are kept between calls with the same victims.
+///   </para>
+/// </remarks>
+class LocalSearch
+{
+public:
+  enum { MaxVictimsPerTrip = 4, };
+  enum { MaxPasses = 64, };
+  enum { NeighborCandidates = 16, };
+
+  LocalSearch();
+
+  /// <summary> Improve the routes in place. </summary>
+  /// <remarks>
+  ///   <para> The routes must be feasible, as made by GreedyRescue. </para>
+  /// </remarks>
+  /// <returns> The number of victims the improved routes rescue. </returns>
+  int Improve(const VictimList& victims,
+              const HospitalList& hospitals,
+              const Deadline& deadline,
+              ActionSequenceList* actionSequences);
+
+private:
+  /// <summary> A route with its times, trips and slack. </summary>
+  /// <remarks>
+  ///   <para> Stops are victim indices, or ~hospitalIdx for hospitals. Trip k
+  ///     holds the victims between the hospital stops at tripStart[k] and
+  ///     tripStart[k + 1]. suffixSlack[k] is the least slack of trips k on.
+  ///   </para>
+  /// </remarks>
+  struct Route
+  {
+    std::vector<int> stops;
+    std::vector<int> time;
+    std::vector<int> tripOf;
+    std::vector<int> tripStart;
+    std::vector<int> tripDeadline;
+    std::vector<int> suffixSlack;
+    inline int NumTrips() const
+    {
+      return static_cast<int>(tripStart.size()) - 1;
+    }
+    inline int TripSize(const int trip) const
+    {
+      return tripStart[trip + 1] - tripStart[trip] - 1;
+    }
+    inline int EndTime() const
+    {
+      return time.back();
+    }
+  };
+
+  /// <summary> Where an insert goes and what it costs. </summary>
+  struct Insertion
+  {
+    Insertion() : routeIdx(-1), pos(-1), delta(0), newTrip(false) {}
+    int routeIdx;
+    int pos;
+    int delta;
+    bool newTrip;
+  };
+
+  inline static bool IsHospital(const int stop)
+  {
+    return stop < 0;
+  }
+
+  inline int Place(const int stop) const
+  {
+    return IsHospital(stop) ? m_distances.HospitalPlace(~stop) : stop;
+  }
+
+  /// <summary> Time to drive from one stop and load or unload at the next. </summary>
+  inline int Leg(const int from, const int to) const
+  {
+    const int stopTime = IsHospital(to) ? static_cast<int>(VictimUnloadTime)
+                                        : static_cast<int>(VictimLoadTime);
+    return stopTime + (m_distances(Place(from), Place(to)) * DriveOneBlockTime);
+  }
+
+  /// <summary> Recompute times, trips and slack of a route. </summary>
+  void Rebuild(const int routeIdx);
+
+  /// <summary> Least time to live in a trip, leaving out one stop. </summary>
+  int TripDeadlineWithout(const Route& route, const int trip,
+                          const int skipPos) const;
+
+  /// <summary> Time saved, as a negative delta, by removing a victim. </summary>
+  int RemovalDelta(const Route& route, const int pos) const;
+
+  /// <summary> Find the nearest victims of every victim. </summary>
+  void BuildNeighbors();
+
+  /// <summary> Take an insert at pos of a trip if it fits and costs less. </summary>
+  void TryInsertion(const int victimIdx, const int newDeadline,
+                    const int routeIdx, const int trip, const int pos,
+                    Insertion* best) const;
+
+  /// <summary> Cheapest feasible insert of a victim into an existing trip. </summary>
+  void FindInsertion(const int victimIdx, const int skipRouteIdx,
+                     Insertion* best) const;
+
+  /// <summary> Cheapest feasible insert of a victim next to a neighbor. </summary>
+  void FindNeighborInsertion(const int victimIdx, const int skipRouteIdx,
+                             Insertion* best) const;
+
+  void ApplyInsertion(const int victimIdx, const Insertion& insertion);
+  void RemoveVictim(const int victimIdx);
+
+  bool InsertPass(const Deadline& deadline);
+  bool RelocatePass(const Deadline& deadline);
+  bool SwapPass(const Deadline& deadline);
+  bool TwoOptStarPass(const Deadline& deadline);
+
+  const VictimList* m_victims;
+  const HospitalList* m_hospitals;
+  NearestHospitalTable m_nearestHospitals;
+  DistanceOracle m_distances;
+  std::vector<int> m_neighborStart;
+  std::vector<int> m_neighbors;
+  std::vector<Route> m_routes;
+  std::vector<int> m_victimRoute;
+  std::vector<int> m_victimPos;
+  std::vector<int> m_scratch;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_LOCAL_SEARCH_H_
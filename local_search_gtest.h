@@ -0,0 +1,58 @@
+#ifndef _HPS_AMBULANCE_LOCAL_SEARCH_GTEST_H_
+#define _HPS_AMBULANCE_LOCAL_SEARCH_GTEST_H_
+#include "local_search.h"
+#include "greedy.h"
+#include "data_file.h"
+#include "validate_gtest.h"
+#include "gtest/gtest.h"
+
+namespace _hps_ambulance_local_search_gtest_h_
+{
+using namespace hps;
+
+TEST(ImproveGreedyRoutes, local_search)
+{
+  enum { MaxHospitalCoord = 200, };
+  enum { NumTrials = 10, };
+
+  const char* filenames[] = { "ambusamp2010", "ambusamp2009", };
+  for (int fileIdx = 0; fileIdx < 2; ++fileIdx)
+  {
+    VictimList victims;
+    HospitalAmbulanceList hospitalAmbulances;
+    LoadDataFile(filenames[fileIdx], &victims, &hospitalAmbulances);
+    RandEngine rng(fileIdx, 0);
+    LocalSearch localSearch;
+    int totalGreedy = 0;
+    int totalImproved = 0;
+    for (int trial = 0; trial < NumTrials; ++trial)
+    {
+      HospitalList hospitals;
+      RandomLayout(hospitalAmbulances, MaxHospitalCoord, &rng, &hospitals);
+      ActionSequenceList actionSequences;
+      int rescued;
+      GreedyRescue::Run(victims, hospitals, &actionSequences, &rescued);
+      // Nothing moves once the deadline has passed.
+      ActionSequenceList expiredSequences = actionSequences;
+      EXPECT_EQ(rescued, localSearch.Improve(victims, hospitals, Deadline(0),
+                                             &expiredSequences));
+      ExpectSameActionSequences(actionSequences, expiredSequences);
+      const int improved = localSearch.Improve(victims, hospitals, Deadline(),
+                                               &actionSequences);
+      int numRescued;
+      ASSERT_TRUE(ValidateAmbulance(victims, hospitals, actionSequences,
+                                    &numRescued));
+      EXPECT_EQ(improved, numRescued);
+      EXPECT_GE(improved, rescued);
+      totalGreedy += rescued;
+      totalImproved += improved;
+    }
+    std::cout << "Local search on input file " << filenames[fileIdx]
+              << " rescued " << totalImproved << " victims against "
+              << totalGreedy << " for greedy." << std::endl;
+  }
+}
+
+}
+
+#endif //_HPS_AMBULANCE_LOCAL_SEARCH_GTEST_H_
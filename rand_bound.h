@@ -2,26 +2,214 @@
 #define _MATH_RAND_BOUND_GENERATOR_H_
 #include <math.h>
 #include <cstdlib>
+#include <assert.h>
+#include <new>
+#include <omp.h>
 
 namespace hps
 {
 namespace math
 {
 
+/// <summary> SplitMix64 generator used to expand seeds. </summary>
+class SplitMix64
+{
+public:
+  explicit SplitMix64(const unsigned long long seed) : m_state(seed) {}
+
+  /// <summary> Get the next 64 random bits. </summary>
+  inline unsigned long long Next()
+  {
+    unsigned long long z = (m_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+private:
+  unsigned long long m_state;
+};
+
+/// <summary> A seedable random engine that owns its state. </summary>
+/// <remarks>
+///   <para> Unlike rand(), every engine is independent. Parallel searches may
+///     each own an engine and remain reproducible from a seed. The generator
+///     is xoshiro256** taken from:
+///       David Blackman and Sebastiano Vigna. 2018. Scrambled linear
+///       pseudorandom number generators. http://prng.di.unimi.it/
+///   </para>
+///   <para> Independent streams of one seed are made either by seeding with
+///     a stream number or by Split(), which hands out the current sequence
+///     and jumps this engine 2^128 steps ahead.
+///   </para>
+/// </remarks>
+class RandEngine
+{
+public:
+  explicit RandEngine(const unsigned long long seed)
+  {
+    Seed(seed, 0ULL);
+  }
+  RandEngine(const unsigned long long seed, const unsigned long long stream)
+  {
+    Seed(seed, stream);
+  }
+
+  /// <summary> Reset to the given stream of a seed. </summary>
+  inline void Seed(const unsigned long long seed,
+                   const unsigned long long stream)
+  {
+    SplitMix64 mix(seed ^ (stream * 0xD1B54A32D192ED03ULL));
+    // Mix once more so that nearby streams do not share state words.
+    SplitMix64 expand(mix.Next() + stream);
+    for (int stateIdx = 0; stateIdx < StateWords; ++stateIdx)
+    {
+      m_state[stateIdx] = expand.Next();
+    }
+  }
+
+  /// <summary> Get the next 64 random bits. </summary>
+  inline unsigned long long Next()
+  {
+    const unsigned long long result = Rotl(m_state[1] * 5, 7) * 9;
+    const unsigned long long t = m_state[1] << 17;
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = Rotl(m_state[3], 45);
+    return result;
+  }
+
+  /// <summary> Get an unbiased number in [0, bound - 1]. </summary>
+  /// <remarks>
+  ///   <para> Multiply-shift with rejection taken from:
+  ///       Daniel Lemire. 2019. Fast Random Integer Generation in an
+  ///       Interval. ACM Trans. Model. Comput. Simul. 29, 1, Article 3.
+  ///   </para>
+  /// </remarks>
+  inline int Bound(const int bound)
+  {
+    assert(bound > 0);
+    const unsigned long long range = static_cast<unsigned long long>(bound);
+    unsigned long long m = (Next() >> 32) * range;
+    unsigned long long low = m & 0xFFFFFFFFULL;
+    if (low < range)
+    {
+      const unsigned long long threshold = (0x100000000ULL - range) % range;
+      while (low < threshold)
+      {
+        m = (Next() >> 32) * range;
+        low = m & 0xFFFFFFFFULL;
+      }
+    }
+    return static_cast<int>(m >> 32);
+  }
+
+  /// <summary> Get a uniform number in [0, 1). </summary>
+  inline double Uniform()
+  {
+    return static_cast<double>(Next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /// <summary> Advance the engine by 2^128 steps. </summary>
+  void Jump()
+  {
+    static const unsigned long long s_jump[StateWords] =
+    {
+      0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+      0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL,
+    };
+    unsigned long long jumped[StateWords] = { 0ULL, 0ULL, 0ULL, 0ULL, };
+    for (int jumpIdx = 0; jumpIdx < StateWords; ++jumpIdx)
+    {
+      for (int bit = 0; bit < 64; ++bit)
+      {
+        if (s_jump[jumpIdx] & (1ULL << bit))
+        {
+          for (int stateIdx = 0; stateIdx < StateWords; ++stateIdx)
+          {
+            jumped[stateIdx] ^= m_state[stateIdx];
+          }
+        }
+        Next();
+      }
+    }
+    for (int stateIdx = 0; stateIdx < StateWords; ++stateIdx)
+    {
+      m_state[stateIdx] = jumped[stateIdx];
+    }
+  }
+
+  /// <summary> Split off an independent stream. </summary>
+  inline RandEngine Split()
+  {
+    RandEngine child(*this);
+    Jump();
+    return child;
+  }
+
+private:
+  enum { StateWords = 4, };
+
+  inline static unsigned long long Rotl(const unsigned long long x,
+                                        const int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  unsigned long long m_state[StateWords];
+};
+
+/// <summary> Default seed for engines that are not seeded explicitly. </summary>
+enum { DefaultRandSeed = 20111017, };
+
+/// <summary> Get the random engine that belongs to the calling thread. </summary>
+/// <remarks>
+///   <para> Each thread starts on the stream of DefaultRandSeed given by its
+///     OpenMP thread number. Use SeedThreadRandEngine() to reseed.
+///   </para>
+///   <para> A threadprivate variable may not have a constructor, so each
+///     thread's engine is built in raw threadprivate storage on first use.
+///   </para>
+/// </remarks>
+inline RandEngine& ThreadRandEngine()
+{
+  enum { StorageWords = (sizeof(RandEngine) + sizeof(unsigned long long) - 1) /
+                        sizeof(unsigned long long), };
+  static unsigned long long s_storage[StorageWords];
+  static bool s_constructed = false;
+#pragma omp threadprivate(s_storage, s_constructed)
+  if (!s_constructed)
+  {
+    new (s_storage) RandEngine(DefaultRandSeed, omp_get_thread_num());
+    s_constructed = true;
+  }
+  return *reinterpret_cast<RandEngine*>(s_storage);
+}
+
+/// <summary> Reseed the calling thread's engine to its stream of seed. </summary>
+inline void SeedThreadRandEngine(const unsigned long long seed)
+{
+  ThreadRandEngine().Seed(seed, omp_get_thread_num());
+}
+
 /// <summary> Partition consecutive intervals of size bound mapped to the
 ///   numbers [0, bound - 1].
 /// </summary>
-int RandBound(const int bound)
+inline int RandBound(RandEngine* rng, const int bound)
 {
-  assert(bound <= RAND_MAX);
-  int factor = ((RAND_MAX - bound) / bound) + 1;
-  int limit = factor * bound;
-  int r;
-  do
-  {
-    r = rand();
-  } while (r >= limit);
-  return r / factor;
+  assert(rng);
+  return rng->Bound(bound);
+}
+
+/// <summary> Partition consecutive intervals of size bound mapped to the
+///   numbers [0, bound - 1] using the thread's engine.
+/// </summary>
+inline int RandBound(const int bound)
+{
+  return RandBound(&ThreadRandEngine(), bound);
 }
 
 /// <summary> Partition consecutive intervals of size bound mapped to the
@@ -31,31 +219,36 @@ struct RandBoundedGenerator
 {
   RandBoundedGenerator(const int bound_)
   : bound(bound_),
-    factor(((RAND_MAX - bound) / bound) + 1),
-    limit(factor * bound)
+    rng(&ThreadRandEngine())
   {
-    assert(bound <= RAND_MAX);
+    assert(bound > 0);
+  }
+  RandBoundedGenerator(const int bound_, RandEngine* rng_)
+  : bound(bound_),
+    rng(rng_)
+  {
+    assert(bound > 0);
+    assert(rng);
   }
 
   inline int operator()() const
   {
-    int r;
-    do
-    {
-      r = rand();
-    } while (r >= limit);
-    return r / factor;
+    return rng->Bound(bound);
   }
 
   int bound;
-  int factor;
-  int limit;
+  RandEngine* rng;
 };
 
+inline double RandUniform(RandEngine* rng)
+{
+  assert(rng);
+  return rng->Uniform();
+}
+
 inline double RandUniform()
 {
-  static RandBoundedGenerator s_rand(RAND_MAX);
-  return static_cast<double>(s_rand()) / static_cast<double>(RAND_MAX - 1);
+  return RandUniform(&ThreadRandEngine());
 }
 
 /// <summary> Generate values from a normal distribution using ratio of uniforms. </summary>
@@ -68,8 +261,9 @@ inline double RandUniform()
 ///       NY, USA.
 ///   </para>
 /// </remarks>
-double RatioOfUniforms(const double mu, const double sig)
+inline double RatioOfUniforms(RandEngine* rng, const double mu, const double sig)
 {
+  assert(rng);
   // Uses a squeeze on the cartesion plot of standard distribution region
   // to reject efficiently (u,v) not in the allowed region. Since (u,v) is
   // selected uniformly, the coordinates allowed model the normal distribution
@@ -77,8 +271,8 @@ double RatioOfUniforms(const double mu, const double sig)
   double u, v, x, y, q;
   do
   {
-    u = RandUniform();
-    v = 1.7156 * (RandUniform() - 0.5);
+    u = RandUniform(rng);
+    v = 1.7156 * (RandUniform(rng) - 0.5);
     x = u - 0.449871;
     y = fabs(v) + 0.386596;
     q = (x * x) + (y * ((0.19600 * y) - (0.25472 * x)));
@@ -87,6 +281,14 @@ double RatioOfUniforms(const double mu, const double sig)
   return mu + (sig * (v / u));
 }
 
+/// <summary> Generate values from a normal distribution using the thread's
+///   engine.
+/// </summary>
+inline double RatioOfUniforms(const double mu, const double sig)
+{
+  return RatioOfUniforms(&ThreadRandEngine(), mu, sig);
+}
+
 }
 using namespace math;
 }
@@ -29,6 +29,66 @@ TEST(RatioOfUniforms, RandBound)
   }
 }
 
+TEST(SeedReproducible, RandEngine)
+{
+  enum { Draws = 1000, };
+  RandEngine rngA(1234ULL);
+  RandEngine rngB(1234ULL);
+  RandEngine rngOther(1235ULL);
+  int sameAsOther = 0;
+  for (int draw = 0; draw < Draws; ++draw)
+  {
+    const unsigned long long a = rngA.Next();
+    ASSERT_EQ(a, rngB.Next());
+    sameAsOther += (a == rngOther.Next());
+  }
+  EXPECT_EQ(0, sameAsOther);
+}
+
+TEST(Streams, RandEngine)
+{
+  enum { Draws = 1000, };
+  // Seeded streams and split streams must not repeat their siblings.
+  RandEngine stream0(1234ULL, 0ULL);
+  RandEngine stream1(1234ULL, 1ULL);
+  RandEngine parent(1234ULL);
+  RandEngine child = parent.Split();
+  int matches = 0;
+  for (int draw = 0; draw < Draws; ++draw)
+  {
+    matches += (stream0.Next() == stream1.Next());
+    matches += (parent.Next() == child.Next());
+  }
+  EXPECT_EQ(0, matches);
+}
+
+TEST(BoundUniform, RandEngine)
+{
+  enum { Bound = 7, };
+  enum { Draws = 70000, };
+  // Each bin expects Draws / Bound = 10000 with a std. dev. of about 93.
+  enum { MaxBinError = 500, };
+  RandEngine rng(42ULL);
+  std::vector<int> hist(Bound, 0);
+  for (int draw = 0; draw < Draws; ++draw)
+  {
+    const int value = rng.Bound(Bound);
+    ASSERT_GE(value, 0);
+    ASSERT_LT(value, static_cast<int>(Bound));
+    ++hist[value];
+  }
+  for (int bin = 0; bin < Bound; ++bin)
+  {
+    EXPECT_LT(abs(hist[bin] - (Draws / Bound)), MaxBinError);
+  }
+  for (int draw = 0; draw < Draws; ++draw)
+  {
+    const double u = rng.Uniform();
+    ASSERT_GE(u, 0.0);
+    ASSERT_LT(u, 1.0);
+  }
+}
+
 }
 
 #endif //_HPS_AMBULANCE_RAND_BOUND_GTEST_H_
@@ -0,0 +1,434 @@
+#include "score_kernels.h"
+#include <limits.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HPS_SCORE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace hps
+{
+namespace ambulance
+{
+
+namespace detail
+{
+
+typedef void (*ManhattanDistanceKernelFunc)(const Point&, const VictimBlock&,
+                                            int*);
+typedef void (*DistanceTimeSquaredKernelFunc)(const Point&, const VictimBlock&,
+                                              float*);
+typedef void (*NearestPointKernelFunc)(const Point*, const int, const Point*,
+                                       const int, int*, int*, int*);
+
+/// <summary> Kernels for one instruction set. </summary>
+struct ScoreKernelTable
+{
+  ScoreKernelIsa isa;
+  ManhattanDistanceKernelFunc manhattanDistance;
+  DistanceTimeSquaredKernelFunc distanceTimeSquared;
+  NearestPointKernelFunc nearestPoint;
+};
+
+void ManhattanDistanceScalar(const Point& from, const VictimBlock& block,
+                             int* distances)
+{
+  for (int victimIdx = 0; victimIdx < block.count; ++victimIdx)
+  {
+    distances[victimIdx] = abs(from.x - block.x[victimIdx]) +
+                           abs(from.y - block.y[victimIdx]);
+  }
+}
+
+void DistanceTimeSquaredScalar(const Point& from, const VictimBlock& block,
+                               float* scores)
+{
+  for (int victimIdx = 0; victimIdx < block.count; ++victimIdx)
+  {
+    const float dist = static_cast<float>(abs(from.x - block.x[victimIdx]) +
+                                          abs(from.y - block.y[victimIdx]));
+    const float timeMult = static_cast<float>(block.timeToLive[victimIdx]);
+    scores[victimIdx] = dist * timeMult * timeMult;
+  }
+}
+
+void NearestPointScalar(const Point* points, const int numPoints,
+                        const Point* candidates, const int numCandidates,
+                        int* nearestIdx, int* nearestDist, int* secondDist)
+{
+  for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+  {
+    const Point& point = points[pointIdx];
+    int closestIdx = 0;
+    int closestDist = INT_MAX;
+    int secondBest = INT_MAX;
+    for (int candidateIdx = 0; candidateIdx < numCandidates; ++candidateIdx)
+    {
+      const int dist = abs(point.x - candidates[candidateIdx].x) +
+                       abs(point.y - candidates[candidateIdx].y);
+      if (dist < closestDist)
+      {
+        secondBest = closestDist;
+        closestDist = dist;
+        closestIdx = candidateIdx;
+      }
+      else if (dist < secondBest)
+      {
+        secondBest = dist;
+      }
+    }
+    nearestIdx[pointIdx] = closestIdx;
+    if (nearestDist)
+    {
+      nearestDist[pointIdx] = closestDist;
+    }
+    if (secondDist)
+    {
+      secondDist[pointIdx] = secondBest;
+    }
+  }
+}
+
+#if HPS_SCORE_KERNELS_X86
+/// <summary> Candidates as arrays padded to a whole number of registers. </summary>
+/// <remarks>
+///   <para> Padding lanes have a pad of INT_MAX, which is taken as their
+///     distance so that they are never nearest.
+///   </para>
+/// </remarks>
+struct NearestPointCandidates
+{
+  NearestPointCandidates(const Point* candidates, const int numCandidates,
+                         const int lanes)
+    : numChunks((numCandidates + lanes - 1) / lanes)
+  {
+    for (int candidateIdx = 0; candidateIdx < numChunks * lanes; ++candidateIdx)
+    {
+      const bool valid = candidateIdx < numCandidates;
+      x[candidateIdx] = valid ? candidates[candidateIdx].x : 0;
+      y[candidateIdx] = valid ? candidates[candidateIdx].y : 0;
+      pad[candidateIdx] = valid ? 0 : INT_MAX;
+    }
+  }
+
+  int numChunks;
+  int x[MaxNearestPointCandidates] __attribute__((aligned(64)));
+  int y[MaxNearestPointCandidates] __attribute__((aligned(64)));
+  int pad[MaxNearestPointCandidates] __attribute__((aligned(64)));
+};
+
+__attribute__((target("avx2")))
+inline int HorizontalMinAvx2(const __m256i values)
+{
+  __m128i mins = _mm_min_epi32(_mm256_castsi256_si128(values),
+                               _mm256_extracti128_si256(values, 1));
+  mins = _mm_min_epi32(mins, _mm_shuffle_epi32(mins, _MM_SHUFFLE(1, 0, 3, 2)));
+  mins = _mm_min_epi32(mins, _mm_shuffle_epi32(mins, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(mins);
+}
+
+__attribute__((target("avx2")))
+void ManhattanDistanceAvx2(const Point& from, const VictimBlock& block,
+                           int* distances)
+{
+  const __m256i fromX = _mm256_set1_epi32(from.x);
+  const __m256i fromY = _mm256_set1_epi32(from.y);
+  int victimIdx = 0;
+  for (; victimIdx + 8 <= block.count; victimIdx += 8)
+  {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.x + victimIdx));
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.y + victimIdx));
+    const __m256i dist = _mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(fromX, x)),
+                                          _mm256_abs_epi32(_mm256_sub_epi32(fromY, y)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(distances + victimIdx), dist);
+  }
+  VictimBlock tail = block;
+  tail.x += victimIdx;
+  tail.y += victimIdx;
+  tail.count -= victimIdx;
+  ManhattanDistanceScalar(from, tail, distances + victimIdx);
+}
+
+__attribute__((target("avx2")))
+void DistanceTimeSquaredAvx2(const Point& from, const VictimBlock& block,
+                             float* scores)
+{
+  const __m256i fromX = _mm256_set1_epi32(from.x);
+  const __m256i fromY = _mm256_set1_epi32(from.y);
+  int victimIdx = 0;
+  for (; victimIdx + 8 <= block.count; victimIdx += 8)
+  {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.x + victimIdx));
+    const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.y + victimIdx));
+    const __m256i ttl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.timeToLive + victimIdx));
+    const __m256i dist = _mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(fromX, x)),
+                                          _mm256_abs_epi32(_mm256_sub_epi32(fromY, y)));
+    const __m256 timeMult = _mm256_cvtepi32_ps(ttl);
+    const __m256 score = _mm256_mul_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(dist),
+                                                     timeMult),
+                                       timeMult);
+    _mm256_storeu_ps(scores + victimIdx, score);
+  }
+  VictimBlock tail = block;
+  tail.x += victimIdx;
+  tail.y += victimIdx;
+  tail.timeToLive += victimIdx;
+  tail.count -= victimIdx;
+  DistanceTimeSquaredScalar(from, tail, scores + victimIdx);
+}
+
+__attribute__((target("avx2")))
+void NearestPointAvx2(const Point* points, const int numPoints,
+                      const Point* candidates, const int numCandidates,
+                      int* nearestIdx, int* nearestDist, int* secondDist)
+{
+  enum { Lanes = 8, };
+  if (numCandidates > MaxNearestPointCandidates)
+  {
+    NearestPointScalar(points, numPoints, candidates, numCandidates,
+                       nearestIdx, nearestDist, secondDist);
+    return;
+  }
+  const NearestPointCandidates soa(candidates, numCandidates, Lanes);
+  const __m256i laneIdx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i intMax = _mm256_set1_epi32(INT_MAX);
+  for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+  {
+    const __m256i x = _mm256_set1_epi32(points[pointIdx].x);
+    const __m256i y = _mm256_set1_epi32(points[pointIdx].y);
+    // Each lane keeps its own nearest and second nearest.
+    __m256i best = intMax;
+    __m256i second = intMax;
+    __m256i bestIdx = _mm256_setzero_si256();
+    for (int chunk = 0; chunk < soa.numChunks; ++chunk)
+    {
+      const int offset = chunk * Lanes;
+      const __m256i candX = _mm256_load_si256(reinterpret_cast<const __m256i*>(soa.x + offset));
+      const __m256i candY = _mm256_load_si256(reinterpret_cast<const __m256i*>(soa.y + offset));
+      const __m256i pad = _mm256_load_si256(reinterpret_cast<const __m256i*>(soa.pad + offset));
+      const __m256i dist = _mm256_max_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(x, candX)),
+                                                             _mm256_abs_epi32(_mm256_sub_epi32(y, candY))),
+                                            pad);
+      const __m256i closer = _mm256_cmpgt_epi32(best, dist);
+      second = _mm256_blendv_epi8(_mm256_min_epi32(second, dist), best, closer);
+      best = _mm256_min_epi32(best, dist);
+      bestIdx = _mm256_blendv_epi8(bestIdx,
+                                   _mm256_add_epi32(laneIdx, _mm256_set1_epi32(offset)),
+                                   closer);
+    }
+    // The nearest is the earliest lane at the least distance. The second is
+    // the least of every other lane and the second of the nearest lane.
+    const int closestDist = HorizontalMinAvx2(best);
+    const __m256i isClosest = _mm256_cmpeq_epi32(best, _mm256_set1_epi32(closestDist));
+    const int closestIdx = HorizontalMinAvx2(_mm256_blendv_epi8(intMax, bestIdx, isClosest));
+    nearestIdx[pointIdx] = closestIdx;
+    if (nearestDist)
+    {
+      nearestDist[pointIdx] = closestDist;
+    }
+    if (secondDist)
+    {
+      const __m256i others = _mm256_blendv_epi8(best, intMax,
+                                                _mm256_cmpeq_epi32(bestIdx, _mm256_set1_epi32(closestIdx)));
+      secondDist[pointIdx] = HorizontalMinAvx2(_mm256_min_epi32(second, others));
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+void ManhattanDistanceAvx512(const Point& from, const VictimBlock& block,
+                             int* distances)
+{
+  const __m512i fromX = _mm512_set1_epi32(from.x);
+  const __m512i fromY = _mm512_set1_epi32(from.y);
+  for (int victimIdx = 0; victimIdx < block.count; victimIdx += 16)
+  {
+    // Mask off lanes past the end of the block.
+    const int remain = block.count - victimIdx;
+    const __mmask16 lanes = (remain >= 16) ?
+      static_cast<__mmask16>(0xFFFF) :
+      static_cast<__mmask16>((1U << remain) - 1U);
+    const __m512i x = _mm512_maskz_loadu_epi32(lanes, block.x + victimIdx);
+    const __m512i y = _mm512_maskz_loadu_epi32(lanes, block.y + victimIdx);
+    const __m512i dist = _mm512_add_epi32(_mm512_abs_epi32(_mm512_sub_epi32(fromX, x)),
+                                          _mm512_abs_epi32(_mm512_sub_epi32(fromY, y)));
+    _mm512_mask_storeu_epi32(distances + victimIdx, lanes, dist);
+  }
+}
+
+__attribute__((target("avx512f")))
+void DistanceTimeSquaredAvx512(const Point& from, const VictimBlock& block,
+                               float* scores)
+{
+  const __m512i fromX = _mm512_set1_epi32(from.x);
+  const __m512i fromY = _mm512_set1_epi32(from.y);
+  for (int victimIdx = 0; victimIdx < block.count; victimIdx += 16)
+  {
+    // Mask off lanes past the end of the block.
+    const int remain = block.count - victimIdx;
+    const __mmask16 lanes = (remain >= 16) ?
+      static_cast<__mmask16>(0xFFFF) :
+      static_cast<__mmask16>((1U << remain) - 1U);
+    const __m512i x = _mm512_maskz_loadu_epi32(lanes, block.x + victimIdx);
+    const __m512i y = _mm512_maskz_loadu_epi32(lanes, block.y + victimIdx);
+    const __m512i ttl = _mm512_maskz_loadu_epi32(lanes, block.timeToLive + victimIdx);
+    const __m512i dist = _mm512_add_epi32(_mm512_abs_epi32(_mm512_sub_epi32(fromX, x)),
+                                          _mm512_abs_epi32(_mm512_sub_epi32(fromY, y)));
+    const __m512 timeMult = _mm512_cvtepi32_ps(ttl);
+    const __m512 score = _mm512_mul_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(dist),
+                                                     timeMult),
+                                       timeMult);
+    _mm512_mask_storeu_ps(scores + victimIdx, lanes, score);
+  }
+}
+
+__attribute__((target("avx512f")))
+void NearestPointAvx512(const Point* points, const int numPoints,
+                        const Point* candidates, const int numCandidates,
+                        int* nearestIdx, int* nearestDist, int* secondDist)
+{
+  enum { Lanes = 16, };
+  if (numCandidates > MaxNearestPointCandidates)
+  {
+    NearestPointScalar(points, numPoints, candidates, numCandidates,
+                       nearestIdx, nearestDist, secondDist);
+    return;
+  }
+  const NearestPointCandidates soa(candidates, numCandidates, Lanes);
+  const __m512i laneIdx = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15);
+  const __m512i intMax = _mm512_set1_epi32(INT_MAX);
+  for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+  {
+    const __m512i x = _mm512_set1_epi32(points[pointIdx].x);
+    const __m512i y = _mm512_set1_epi32(points[pointIdx].y);
+    // Each lane keeps its own nearest and second nearest.
+    __m512i best = intMax;
+    __m512i second = intMax;
+    __m512i bestIdx = _mm512_setzero_si512();
+    for (int chunk = 0; chunk < soa.numChunks; ++chunk)
+    {
+      const int offset = chunk * Lanes;
+      const __m512i candX = _mm512_load_si512(soa.x + offset);
+      const __m512i candY = _mm512_load_si512(soa.y + offset);
+      const __m512i pad = _mm512_load_si512(soa.pad + offset);
+      const __m512i dist = _mm512_max_epi32(_mm512_add_epi32(_mm512_abs_epi32(_mm512_sub_epi32(x, candX)),
+                                                             _mm512_abs_epi32(_mm512_sub_epi32(y, candY))),
+                                            pad);
+      const __mmask16 closer = _mm512_cmpgt_epi32_mask(best, dist);
+      second = _mm512_mask_blend_epi32(closer, _mm512_min_epi32(second, dist), best);
+      best = _mm512_min_epi32(best, dist);
+      bestIdx = _mm512_mask_blend_epi32(closer, bestIdx,
+                                        _mm512_add_epi32(laneIdx, _mm512_set1_epi32(offset)));
+    }
+    // The nearest is the earliest lane at the least distance. The second is
+    // the least of every other lane and the second of the nearest lane.
+    const int closestDist = _mm512_reduce_min_epi32(best);
+    const __mmask16 isClosest = _mm512_cmpeq_epi32_mask(best, _mm512_set1_epi32(closestDist));
+    const int closestIdx = _mm512_mask_reduce_min_epi32(isClosest, bestIdx);
+    nearestIdx[pointIdx] = closestIdx;
+    if (nearestDist)
+    {
+      nearestDist[pointIdx] = closestDist;
+    }
+    if (secondDist)
+    {
+      const __mmask16 isClosestIdx = _mm512_cmpeq_epi32_mask(bestIdx, _mm512_set1_epi32(closestIdx));
+      const __m512i others = _mm512_mask_blend_epi32(isClosestIdx, best, intMax);
+      secondDist[pointIdx] = _mm512_reduce_min_epi32(_mm512_min_epi32(second, others));
+    }
+  }
+}
+#endif
+
+/// <summary> Get the kernels for an instruction set. </summary>
+ScoreKernelTable MakeScoreKernelTable(const ScoreKernelIsa isa)
+{
+  ScoreKernelTable table;
+  table.isa = ScoreKernelIsa_Scalar;
+  table.manhattanDistance = &ManhattanDistanceScalar;
+  table.distanceTimeSquared = &DistanceTimeSquaredScalar;
+  table.nearestPoint = &NearestPointScalar;
+#if HPS_SCORE_KERNELS_X86
+  switch (isa)
+  {
+  case ScoreKernelIsa_Avx512:
+    table.isa = ScoreKernelIsa_Avx512;
+    table.manhattanDistance = &ManhattanDistanceAvx512;
+    table.distanceTimeSquared = &DistanceTimeSquaredAvx512;
+    table.nearestPoint = &NearestPointAvx512;
+    break;
+  case ScoreKernelIsa_Avx2:
+    table.isa = ScoreKernelIsa_Avx2;
+    table.manhattanDistance = &ManhattanDistanceAvx2;
+    table.distanceTimeSquared = &DistanceTimeSquaredAvx2;
+    table.nearestPoint = &NearestPointAvx2;
+    break;
+  default:
+    break;
+  }
+#endif
+  return table;
+}
+
+/// <summary> The kernels in use. </summary>
+inline ScoreKernelTable& SelectedScoreKernels()
+{
+  static ScoreKernelTable s_table = MakeScoreKernelTable(BestScoreKernelIsa());
+  return s_table;
+}
+
+}
+
+ScoreKernelIsa BestScoreKernelIsa()
+{
+#if HPS_SCORE_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    return ScoreKernelIsa_Avx512;
+  }
+  else if (__builtin_cpu_supports("avx2"))
+  {
+    return ScoreKernelIsa_Avx2;
+  }
+#endif
+  return ScoreKernelIsa_Scalar;
+}
+
+ScoreKernelIsa SelectedScoreKernelIsa()
+{
+  return detail::SelectedScoreKernels().isa;
+}
+
+void SelectScoreKernels(const ScoreKernelIsa isa)
+{
+  const ScoreKernelIsa bestIsa = BestScoreKernelIsa();
+  detail::SelectedScoreKernels() =
+    detail::MakeScoreKernelTable((isa <= bestIsa) ? isa : bestIsa);
+}
+
+void ManhattanDistanceKernel(const Point& from, const VictimBlock& block,
+                             int* distances)
+{
+  detail::SelectedScoreKernels().manhattanDistance(from, block, distances);
+}
+
+void DistanceTimeSquaredKernel(const Point& from, const VictimBlock& block,
+                               float* scores)
+{
+  detail::SelectedScoreKernels().distanceTimeSquared(from, block, scores);
+}
+
+
+void NearestPointKernel(const Point* points, const int numPoints,
+                        const Point* candidates, const int numCandidates,
+                        int* nearestIdx, int* nearestDist, int* secondDist)
+{
+  detail::SelectedScoreKernels().nearestPoint(points, numPoints,
+                                              candidates, numCandidates,
+                                              nearestIdx, nearestDist,
+                                              secondDist);
+}
+
+}
+}
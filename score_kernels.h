@@ -0,0 +1,72 @@
+#ifndef _HPS_AMBULANCE_SCORE_KERNELS_H_
+#define _HPS_AMBULANCE_SCORE_KERNELS_H_
+#include "ambulance_core.h"
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Instruction sets for the batch scoring kernels. </summary>
+enum ScoreKernelIsa
+{
+  ScoreKernelIsa_Scalar,
+  ScoreKernelIsa_Avx2,
+  ScoreKernelIsa_Avx512,
+};
+
+/// <summary> The best instruction set that this machine supports. </summary>
+ScoreKernelIsa BestScoreKernelIsa();
+
+/// <summary> The instruction set of the kernels in use. </summary>
+/// <remarks>
+///   <para> Defaults to BestScoreKernelIsa() on first use. </para>
+/// </remarks>
+ScoreKernelIsa SelectedScoreKernelIsa();
+
+/// <summary> Use the kernels for the given instruction set. </summary>
+/// <remarks>
+///   <para> Falls back to the best supported instruction set if the given one
+///     is not supported. Not safe to call while kernels are running.
+///   </para>
+/// </remarks>
+void SelectScoreKernels(const ScoreKernelIsa isa);
+
+/// <summary> Manhattan distances from a point to a block of victims. </summary>
+void ManhattanDistanceKernel(const Point& from, const VictimBlock& block,
+                             int* distances);
+
+/// <summary> Scores dist * ttl * ttl from a point to a block of victims. </summary>
+/// <remarks>
+///   <para> Every kernel rounds as the scalar expression
+///     (float(dist) * float(ttl)) * float(ttl) does, so scores do not depend
+///     on the instruction set.
+///   </para>
+/// </remarks>
+void DistanceTimeSquaredKernel(const Point& from, const VictimBlock& block,
+                               float* scores);
+
+enum { MaxNearestPointCandidates = 64, };
+
+/// <summary> Nearest and second nearest candidate to each point. </summary>
+/// <remarks>
+///   <para> Meant for a few candidates, such as cluster means, against many
+///     points. The candidates are held in vector registers and every point
+///     is compared with 8 or 16 of them at once. Ties go to the earliest
+///     candidate. secondDist is the second least distance, which equals
+///     nearestDist when two candidates tie, and INT_MAX when there is only
+///     one candidate. nearestDist and secondDist may be NULL.
+///   </para>
+///   <para> Up to MaxNearestPointCandidates candidates are vectorized. More
+///     use the scalar kernel.
+///   </para>
+/// </remarks>
+void NearestPointKernel(const Point* points, const int numPoints,
+                        const Point* candidates, const int numCandidates,
+                        int* nearestIdx, int* nearestDist, int* secondDist);
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_SCORE_KERNELS_H_
@@ -0,0 +1,137 @@
+#ifndef _HPS_AMBULANCE_SCORE_KERNELS_GTEST_H_
+#define _HPS_AMBULANCE_SCORE_KERNELS_GTEST_H_
+#include "score_kernels.h"
+#include "rand_bound.h"
+#include "gtest/gtest.h"
+#include <vector>
+
+namespace _hps_ambulance_score_kernels_gtest_h_
+{
+using namespace hps;
+
+TEST(KernelsMatchScalar, score_kernels)
+{
+  // Odd block sizes exercise the tails of the vector loops.
+  enum { NumVictims = 1000, };
+  enum { MaxCoord = 1000, };
+  RandEngine rng(5ULL);
+  VictimList victims(NumVictims);
+  for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    victims[victimIdx].timeToLive = 1 + rng.Bound(MaxCoord);
+  }
+  SimVictimStore simVictims;
+  simVictims.Assign(victims);
+  std::vector<int> victimIdx(NumVictims);
+  for (int entry = 0; entry < NumVictims; ++entry)
+  {
+    victimIdx[entry] = entry;
+  }
+  const Point from(MaxCoord / 3, MaxCoord / 2);
+  const ScoreKernelIsa selectedIsa = SelectedScoreKernelIsa();
+  const ScoreKernelIsa bestIsa = BestScoreKernelIsa();
+  const int blockSizes[] = { 1, 7, 8, 15, 16, 17, 33, NumVictims, };
+  for (int sizeIdx = 0; sizeIdx < 8; ++sizeIdx)
+  {
+    VictimBlock block;
+    block.x = &simVictims.x[0];
+    block.y = &simVictims.y[0];
+    block.timeToLive = &simVictims.timeToLive[0];
+    block.victimIdx = &victimIdx[0];
+    block.count = blockSizes[sizeIdx];
+    SelectScoreKernels(ScoreKernelIsa_Scalar);
+    std::vector<int> expectedDist(block.count);
+    std::vector<float> expectedScore(block.count);
+    ManhattanDistanceKernel(from, block, &expectedDist[0]);
+    DistanceTimeSquaredKernel(from, block, &expectedScore[0]);
+    for (int entry = 0; entry < block.count; ++entry)
+    {
+      ASSERT_EQ(ManhattanDistance(from, victims[entry].position),
+                expectedDist[entry]);
+    }
+    for (int isa = ScoreKernelIsa_Scalar; isa <= bestIsa; ++isa)
+    {
+      SelectScoreKernels(static_cast<ScoreKernelIsa>(isa));
+      ASSERT_EQ(isa, SelectedScoreKernelIsa());
+      std::vector<int> dist(block.count);
+      std::vector<float> score(block.count);
+      ManhattanDistanceKernel(from, block, &dist[0]);
+      DistanceTimeSquaredKernel(from, block, &score[0]);
+      for (int entry = 0; entry < block.count; ++entry)
+      {
+        EXPECT_EQ(expectedDist[entry], dist[entry]);
+        EXPECT_EQ(expectedScore[entry], score[entry]);
+      }
+    }
+  }
+  SelectScoreKernels(selectedIsa);
+}
+
+TEST(NearestPointMatchesScalar, score_kernels)
+{
+  // Small coordinates make ties between candidates common.
+  enum { NumPoints = 500, };
+  enum { MaxCoord = 20, };
+  RandEngine rng(6ULL);
+  std::vector<Point> points(NumPoints);
+  for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+  {
+    points[pointIdx] = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+  }
+  const ScoreKernelIsa selectedIsa = SelectedScoreKernelIsa();
+  const ScoreKernelIsa bestIsa = BestScoreKernelIsa();
+  const int candidateCounts[] = { 1, 2, 7, 8, 9, 16, 17, 40, 64, 65, };
+  for (int countIdx = 0; countIdx < 10; ++countIdx)
+  {
+    const int numCandidates = candidateCounts[countIdx];
+    std::vector<Point> candidates(numCandidates);
+    for (int candidateIdx = 0; candidateIdx < numCandidates; ++candidateIdx)
+    {
+      candidates[candidateIdx] = Point(rng.Bound(MaxCoord), rng.Bound(MaxCoord));
+    }
+    SelectScoreKernels(ScoreKernelIsa_Scalar);
+    std::vector<int> expectedIdx(NumPoints);
+    std::vector<int> expectedDist(NumPoints);
+    std::vector<int> expectedSecond(NumPoints);
+    NearestPointKernel(&points[0], NumPoints, &candidates[0], numCandidates,
+                       &expectedIdx[0], &expectedDist[0], &expectedSecond[0]);
+    for (int pointIdx = 0; pointIdx < NumPoints; ++pointIdx)
+    {
+      // The nearest is the earliest at the least distance.
+      for (int candidateIdx = 0; candidateIdx < numCandidates; ++candidateIdx)
+      {
+        const int dist = ManhattanDistance(points[pointIdx], candidates[candidateIdx]);
+        ASSERT_LE(expectedDist[pointIdx], dist);
+        ASSERT_TRUE((candidateIdx >= expectedIdx[pointIdx]) ||
+                    (dist > expectedDist[pointIdx]));
+        if (candidateIdx != expectedIdx[pointIdx])
+        {
+          ASSERT_LE(expectedSecond[pointIdx], dist);
+        }
+      }
+    }
+    for (int isa = ScoreKernelIsa_Scalar; isa <= bestIsa; ++isa)
+    {
+      SelectScoreKernels(static_cast<ScoreKernelIsa>(isa));
+      std::vector<int> nearestIdx(NumPoints);
+      std::vector<int> nearestDist(NumPoints);
+      std::vector<int> secondDist(NumPoints);
+      NearestPointKernel(&points[0], NumPoints, &candidates[0], numCandidates,
+                         &nearestIdx[0], &nearestDist[0], &secondDist[0]);
+      EXPECT_TRUE(expectedIdx == nearestIdx);
+      EXPECT_TRUE(expectedDist == nearestDist);
+      EXPECT_TRUE(expectedSecond == secondDist);
+      // Distances are optional.
+      std::vector<int> idxOnly(NumPoints);
+      NearestPointKernel(&points[0], NumPoints, &candidates[0], numCandidates,
+                         &idxOnly[0], NULL, NULL);
+      EXPECT_TRUE(expectedIdx == idxOnly);
+    }
+  }
+  SelectScoreKernels(selectedIsa);
+}
+
+}
+
+#endif //_HPS_AMBULANCE_SCORE_KERNELS_GTEST_H_
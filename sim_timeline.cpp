@@ -0,0 +1,87 @@
+#include "sim_timeline.h"
+#include <algorithm>
+
+namespace hps
+{
+namespace ambulance
+{
+
+ExpiryIndex::ExpiryIndex()
+: m_victimIdx(),
+  m_timeToLive(),
+  m_tickStart(),
+  m_records(),
+  m_next(0)
+{}
+
+void ExpiryIndex::Build(const SimVictimStore& simVictims)
+{
+  // Counting sort by time to live, which spans a small range of ticks.
+  enum { MaxTicksPerVictim = 8, };
+  const int numVictims = simVictims.Size();
+  m_next = 0;
+  m_victimIdx.resize(numVictims);
+  m_timeToLive.resize(numVictims);
+  if (0 == numVictims)
+  {
+    return;
+  }
+  const int minTime = *std::min_element(simVictims.timeToLive.begin(),
+                                        simVictims.timeToLive.end());
+  const int maxTime = *std::max_element(simVictims.timeToLive.begin(),
+                                        simVictims.timeToLive.end());
+  const long long span = static_cast<long long>(maxTime) - minTime + 1;
+  if (span > static_cast<long long>(MaxTicksPerVictim) * numVictims)
+  {
+    m_records.resize(numVictims);
+    for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+    {
+      m_records[victimIdx] = std::make_pair(simVictims.timeToLive[victimIdx],
+                                            victimIdx);
+    }
+    std::sort(m_records.begin(), m_records.end());
+    for (int entry = 0; entry < numVictims; ++entry)
+    {
+      m_timeToLive[entry] = m_records[entry].first;
+      m_victimIdx[entry] = m_records[entry].second;
+    }
+    return;
+  }
+  m_tickStart.assign(static_cast<int>(span) + 1, 0);
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    ++m_tickStart[simVictims.timeToLive[victimIdx] - minTime + 1];
+  }
+  for (int tick = 0; tick < static_cast<int>(span); ++tick)
+  {
+    m_tickStart[tick + 1] += m_tickStart[tick];
+  }
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    const int timeToLive = simVictims.timeToLive[victimIdx];
+    const int entry = m_tickStart[timeToLive - minTime]++;
+    m_timeToLive[entry] = timeToLive;
+    m_victimIdx[entry] = victimIdx;
+  }
+}
+
+int ExpiryIndex::Advance(const int simTime, SimVictimStore* simVictims)
+{
+  assert(simVictims);
+  int expired = 0;
+  const int numVictims = static_cast<int>(m_victimIdx.size());
+  for (; (m_next < numVictims) && (m_timeToLive[m_next] <= simTime); ++m_next)
+  {
+    const int victimIdx = m_victimIdx[m_next];
+    if (simVictims->IsBleeding(victimIdx))
+    {
+      simVictims->status[victimIdx] =
+        static_cast<unsigned char>(SimVictim::Status_Expired);
+      ++expired;
+    }
+  }
+  return expired;
+}
+
+}
+}
@@ -0,0 +1,232 @@
+#ifndef _HPS_AMBULANCE_SIM_TIMELINE_H_
+#define _HPS_AMBULANCE_SIM_TIMELINE_H_
+#include "ambulance_core.h"
+#include <vector>
+#include <limits>
+#include <assert.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> A calendar queue of events at integer times. </summary>
+/// <remarks>
+///   <para> Events hash into a ring of buckets by time / bucketWidth. A pop
+///     scans forward from the bucket of the last event for one that falls
+///     within the current lap of the ring, so with about one event per
+///     bucket both push and pop take O(1) amortized time. A lap that finds
+///     nothing falls back to a direct search.
+///   </para>
+///   <para> Events may not be pushed before the time of the last event
+///     popped. Events at the same time pop in the order they were pushed.
+///   </para>
+/// </remarks>
+template <typename T>
+class CalendarQueue
+{
+public:
+  CalendarQueue()
+    : m_buckets(),
+      m_bucketMask(0),
+      m_bucketWidth(1),
+      m_bucket(0),
+      m_bucketEnd(1),
+      m_size(0),
+      m_nextSeq(0),
+      m_lastTime(0)
+  {
+    Reset(1, 1);
+  }
+
+  /// <summary> Empty the queue and set its bucket layout. </summary>
+  /// <remarks>
+  ///   <para> The number of buckets is rounded up to a power of two. </para>
+  /// </remarks>
+  void Reset(const int numBuckets, const int bucketWidth)
+  {
+    assert(numBuckets > 0);
+    assert(bucketWidth > 0);
+    int size = 1;
+    while (size < numBuckets)
+    {
+      size <<= 1;
+    }
+    m_buckets.resize(size);
+    for (typename BucketList::iterator bucket = m_buckets.begin();
+         bucket != m_buckets.end();
+         ++bucket)
+    {
+      bucket->clear();
+    }
+    m_bucketMask = size - 1;
+    m_bucketWidth = bucketWidth;
+    m_bucket = 0;
+    m_bucketEnd = bucketWidth;
+    m_size = 0;
+    m_nextSeq = 0;
+    m_lastTime = 0;
+  }
+
+  inline bool Empty() const
+  {
+    return 0 == m_size;
+  }
+
+  inline int Size() const
+  {
+    return m_size;
+  }
+
+  void Push(const int time, const T& value)
+  {
+    assert(time >= m_lastTime);
+    Event event;
+    event.time = time;
+    event.seq = m_nextSeq++;
+    event.value = value;
+    m_buckets[BucketOf(time)].push_back(event);
+    ++m_size;
+    // Rewind if the event falls before the bucket under the cursor.
+    if (time < m_bucketEnd - m_bucketWidth)
+    {
+      SeekTo(time);
+    }
+  }
+
+  /// <summary> Time of the earliest event. </summary>
+  inline int NextTime()
+  {
+    const int slot = FindNext();
+    return m_buckets[m_bucket][slot].time;
+  }
+
+  /// <summary> Remove the earliest event. </summary>
+  void Pop(int* time, T* value)
+  {
+    assert(time && value);
+    const int slot = FindNext();
+    Bucket& bucket = m_buckets[m_bucket];
+    *time = bucket[slot].time;
+    *value = bucket[slot].value;
+    m_lastTime = *time;
+    bucket[slot] = bucket.back();
+    bucket.pop_back();
+    --m_size;
+  }
+
+private:
+  struct Event
+  {
+    int time;
+    unsigned int seq;
+    T value;
+  };
+  typedef std::vector<Event> Bucket;
+  typedef std::vector<Bucket> BucketList;
+
+  inline int BucketOf(const int time) const
+  {
+    return (time / m_bucketWidth) & m_bucketMask;
+  }
+
+  /// <summary> Put the cursor on the bucket that holds time. </summary>
+  inline void SeekTo(const int time)
+  {
+    m_bucket = BucketOf(time);
+    m_bucketEnd = ((time / m_bucketWidth) + 1) * m_bucketWidth;
+  }
+
+  /// <summary> Earliest event in the bucket that ends before end. </summary>
+  inline int EarliestBefore(const Bucket& bucket, const int end) const
+  {
+    int earliest = -1;
+    for (int slot = 0; slot < static_cast<int>(bucket.size()); ++slot)
+    {
+      const Event& event = bucket[slot];
+      if ((event.time < end) &&
+          ((earliest < 0) ||
+           (event.time < bucket[earliest].time) ||
+           ((event.time == bucket[earliest].time) &&
+            (event.seq < bucket[earliest].seq))))
+      {
+        earliest = slot;
+      }
+    }
+    return earliest;
+  }
+
+  /// <summary> Move the cursor to the earliest event and get its slot. </summary>
+  int FindNext()
+  {
+    assert(!Empty());
+    const int numBuckets = m_bucketMask + 1;
+    for (int lap = 0; lap < numBuckets; ++lap)
+    {
+      const int slot = EarliestBefore(m_buckets[m_bucket], m_bucketEnd);
+      if (slot >= 0)
+      {
+        return slot;
+      }
+      m_bucket = (m_bucket + 1) & m_bucketMask;
+      m_bucketEnd += m_bucketWidth;
+    }
+    // Nothing within a lap, so search all of the buckets.
+    int nextTime = std::numeric_limits<int>::max();
+    for (typename BucketList::const_iterator bucket = m_buckets.begin();
+         bucket != m_buckets.end();
+         ++bucket)
+    {
+      for (typename Bucket::const_iterator event = bucket->begin();
+           event != bucket->end();
+           ++event)
+      {
+        nextTime = std::min(nextTime, event->time);
+      }
+    }
+    SeekTo(nextTime);
+    return EarliestBefore(m_buckets[m_bucket], m_bucketEnd);
+  }
+
+  BucketList m_buckets;
+  int m_bucketMask;
+  int m_bucketWidth;
+  int m_bucket;
+  int m_bucketEnd;
+  int m_size;
+  unsigned int m_nextSeq;
+  int m_lastTime;
+};
+
+/// <summary> Victims ordered by the time that they expire. </summary>
+/// <remarks>
+///   <para> Advance() moves a clock forward and expires the victims it
+///     passes, so each victim is looked at once per simulation no matter how
+///     often the clock moves.
+///   </para>
+/// </remarks>
+class ExpiryIndex
+{
+public:
+  ExpiryIndex();
+
+  /// <summary> Index every victim in the store and reset the clock. </summary>
+  void Build(const SimVictimStore& simVictims);
+
+  /// <summary> Expire bleeding victims with timeToLive at or before simTime. </summary>
+  /// <returns> The number of victims expired. </returns>
+  int Advance(const int simTime, SimVictimStore* simVictims);
+
+private:
+  std::vector<int> m_victimIdx;
+  std::vector<int> m_timeToLive;
+  std::vector<int> m_tickStart;
+  std::vector<std::pair<int, int> > m_records;
+  int m_next;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_SIM_TIMELINE_H_
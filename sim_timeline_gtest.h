@@ -0,0 +1,103 @@
+#ifndef _HPS_AMBULANCE_SIM_TIMELINE_GTEST_H_
+#define _HPS_AMBULANCE_SIM_TIMELINE_GTEST_H_
+#include "sim_timeline.h"
+#include "rand_bound.h"
+#include "gtest/gtest.h"
+#include <queue>
+#include <vector>
+#include <functional>
+
+namespace _hps_ambulance_sim_timeline_gtest_h_
+{
+using namespace hps;
+
+TEST(CalendarQueue, sim_timeline)
+{
+  // Compare against a priority queue ordered by time, then by push order.
+  typedef std::pair<int, int> Event;
+  typedef std::priority_queue<Event, std::vector<Event>,
+                              std::greater<Event> > ReferenceQueue;
+  enum { NumTrials = 20, };
+  enum { NumSteps = 5000, };
+  for (int trial = 0; trial < NumTrials; ++trial)
+  {
+    RandEngine rng(static_cast<unsigned long long>(trial));
+    CalendarQueue<int> queue;
+    queue.Reset(1 + rng.Bound(64), 1 + rng.Bound(50));
+    ReferenceQueue reference;
+    int seq = 0;
+    for (; seq < 50; ++seq)
+    {
+      queue.Push(0, seq);
+      reference.push(std::make_pair(0, seq));
+    }
+    int now = 0;
+    for (int step = 0; (step < NumSteps) && !reference.empty(); ++step)
+    {
+      // Mix short hops with jumps past a whole lap of buckets.
+      if (rng.Bound(3) > 0)
+      {
+        const int time = now + rng.Bound(rng.Bound(2) ? 30 : 3000);
+        queue.Push(time, seq);
+        reference.push(std::make_pair(time, seq));
+        ++seq;
+      }
+      ASSERT_EQ(static_cast<int>(reference.size()), queue.Size());
+      ASSERT_EQ(reference.top().first, queue.NextTime());
+      int time;
+      int value;
+      queue.Pop(&time, &value);
+      ASSERT_EQ(reference.top().first, time);
+      ASSERT_EQ(reference.top().second, value);
+      reference.pop();
+      now = time;
+    }
+  }
+}
+
+TEST(ExpiryIndex, sim_timeline)
+{
+  enum { NumVictims = 500, };
+  RandEngine rng(9ULL);
+  // Narrow and wide spans of times take different sorting paths.
+  const int maxTimes[] = { 100, 1000000, };
+  for (int spanIdx = 0; spanIdx < 2; ++spanIdx)
+  {
+    VictimList victims(NumVictims);
+    for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+    {
+      victims[victimIdx].position = Point(0, 0);
+      victims[victimIdx].timeToLive = 1 + rng.Bound(maxTimes[spanIdx]);
+    }
+    SimVictimStore simVictims;
+    simVictims.Assign(victims);
+    // Rescued victims do not expire.
+    for (int victimIdx = 0; victimIdx < NumVictims; victimIdx += 7)
+    {
+      simVictims.status[victimIdx] = SimVictim::Status_Rescued;
+    }
+    ExpiryIndex expiryIndex;
+    expiryIndex.Build(simVictims);
+    int expiredTotal = 0;
+    for (int step = 1; step <= 10; ++step)
+    {
+      const int simTime = (step * maxTimes[spanIdx]) / 10;
+      expiredTotal += expiryIndex.Advance(simTime, &simVictims);
+      int expected = 0;
+      for (int victimIdx = 0; victimIdx < NumVictims; ++victimIdx)
+      {
+        const bool rescued = (0 == (victimIdx % 7));
+        const bool dead = victims[victimIdx].timeToLive <= simTime;
+        EXPECT_EQ(rescued ? SimVictim::Status_Rescued :
+                  (dead ? SimVictim::Status_Expired : SimVictim::Status_Bleeding),
+                  simVictims.status[victimIdx]);
+        expected += (!rescued && dead) ? 1 : 0;
+      }
+      EXPECT_EQ(expected, expiredTotal);
+    }
+  }
+}
+
+}
+
+#endif //_HPS_AMBULANCE_SIM_TIMELINE_GTEST_H_
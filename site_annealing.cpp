@@ -0,0 +1,196 @@
+#include "site_annealing.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <assert.h>
+#include <omp.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+const double SiteAnnealing::StartTemperature = 2.0;
+const double SiteAnnealing::EndTemperature = 0.05;
+
+SiteAnnealing::SiteAnnealing()
+: m_minCorner(),
+  m_maxCorner(),
+  m_cache(),
+  m_evaluations(0),
+  m_moves(),
+  m_misses(),
+  m_workspaces(),
+  m_actionSequences(),
+  m_hospitals()
+{}
+
+void SiteAnnealing::MakeKey(const HospitalList& hospitals, LayoutKey* key)
+{
+  key->resize(2 * hospitals.size());
+  for (size_t hospitalIdx = 0; hospitalIdx < hospitals.size(); ++hospitalIdx)
+  {
+    (*key)[2 * hospitalIdx] = hospitals[hospitalIdx].position.x;
+    (*key)[(2 * hospitalIdx) + 1] = hospitals[hospitalIdx].position.y;
+  }
+}
+
+void SiteAnnealing::DrawMove(const HospitalList& hospitals, RandEngine* rng,
+                             Move* move) const
+{
+  const int numHospitals = static_cast<int>(hospitals.size());
+  move->hospitalIdx = rng->Bound(numHospitals);
+  Point position = hospitals[move->hospitalIdx].position;
+  const int step = 1 + rng->Bound(MaxStep);
+  switch (rng->Bound(4))
+  {
+  case 0: position.x += step; break;
+  case 1: position.x -= step; break;
+  case 2: position.y += step; break;
+  default: position.y -= step; break;
+  }
+  position.x = std::min(std::max(position.x, m_minCorner.x), m_maxCorner.x);
+  position.y = std::min(std::max(position.y, m_minCorner.y), m_maxCorner.y);
+  move->position = position;
+}
+
+void SiteAnnealing::ScoreBatch(const VictimList& victims,
+                               const HospitalList& hospitals,
+                               const int numMoves)
+{
+  // Find the layouts not seen before, once each.
+  m_misses.clear();
+  for (int moveIdx = 0; moveIdx < numMoves; ++moveIdx)
+  {
+    Move& move = m_moves[moveIdx];
+    HospitalList& layout = m_hospitals.front();
+    layout = hospitals;
+    layout[move.hospitalIdx].position = move.position;
+    MakeKey(layout, &move.key);
+    const ScoreCache::const_iterator cached = m_cache.find(move.key);
+    if (cached != m_cache.end())
+    {
+      move.rescued = cached->second;
+      continue;
+    }
+    move.rescued = -1;
+    bool repeated = false;
+    for (std::vector<int>::const_iterator miss = m_misses.begin();
+         miss != m_misses.end();
+         ++miss)
+    {
+      repeated |= (m_moves[*miss].key == move.key);
+    }
+    if (!repeated)
+    {
+      m_misses.push_back(moveIdx);
+    }
+  }
+  const int numMisses = static_cast<int>(m_misses.size());
+#pragma omp parallel for schedule(dynamic, 1) if (numMisses > 1)
+  for (int missIdx = 0; missIdx < numMisses; ++missIdx)
+  {
+    const int threadIdx = omp_get_thread_num();
+    Move& move = m_moves[m_misses[missIdx]];
+    HospitalList& layout = m_hospitals[threadIdx];
+    layout = hospitals;
+    layout[move.hospitalIdx].position = move.position;
+    GreedyRescue::Run(victims, layout, &m_workspaces[threadIdx],
+                      &m_actionSequences[threadIdx], &move.rescued);
+  }
+  m_evaluations += numMisses;
+  for (int missIdx = 0; missIdx < numMisses; ++missIdx)
+  {
+    const Move& move = m_moves[m_misses[missIdx]];
+    m_cache.insert(std::make_pair(move.key, move.rescued));
+  }
+  // Fill in repeats from the cache.
+  for (int moveIdx = 0; moveIdx < numMoves; ++moveIdx)
+  {
+    if (m_moves[moveIdx].rescued < 0)
+    {
+      m_moves[moveIdx].rescued = m_cache[m_moves[moveIdx].key];
+    }
+  }
+}
+
+int SiteAnnealing::Run(const VictimList& victims,
+                       const int steps,
+                       const Deadline& deadline,
+                       RandEngine* rng,
+                       HospitalList* hospitals)
+{
+  assert(rng && hospitals);
+  const int numThreads = omp_get_max_threads();
+  m_workspaces.resize(numThreads);
+  m_actionSequences.resize(numThreads);
+  m_hospitals.resize(numThreads);
+  m_moves.resize(BatchSize);
+  m_cache.clear();
+  m_evaluations = 0;
+  int rescued = 0;
+  GreedyRescue::Run(victims, *hospitals, &m_workspaces.front(),
+                    &m_actionSequences.front(), &rescued);
+  ++m_evaluations;
+  if (victims.empty() || hospitals->empty())
+  {
+    return rescued;
+  }
+  LayoutKey key;
+  MakeKey(*hospitals, &key);
+  m_cache.insert(std::make_pair(key, rescued));
+  // Hospitals may go anywhere within the victims' bounding box.
+  m_minCorner = Point(std::numeric_limits<int>::max(),
+                      std::numeric_limits<int>::max());
+  m_maxCorner = Point(std::numeric_limits<int>::min(),
+                      std::numeric_limits<int>::min());
+  for (VictimList::const_iterator victim = victims.begin();
+       victim != victims.end();
+       ++victim)
+  {
+    m_minCorner.x = std::min(m_minCorner.x, victim->position.x);
+    m_minCorner.y = std::min(m_minCorner.y, victim->position.y);
+    m_maxCorner.x = std::max(m_maxCorner.x, victim->position.x);
+    m_maxCorner.y = std::max(m_maxCorner.y, victim->position.y);
+  }
+  HospitalList current = *hospitals;
+  int currentRescued = rescued;
+  const double cooling = (steps > 1) ?
+    std::pow(EndTemperature / StartTemperature, 1.0 / (steps - 1)) : 1.0;
+  double temperature = StartTemperature;
+  for (int step = 0; (step < steps) && !deadline.Expired(); ++step)
+  {
+    for (int moveIdx = 0; moveIdx < BatchSize; ++moveIdx)
+    {
+      DrawMove(current, rng, &m_moves[moveIdx]);
+    }
+    ScoreBatch(victims, current, BatchSize);
+    // Take the best neighbor, the first of equals.
+    const Move* bestMove = &m_moves.front();
+    for (int moveIdx = 1; moveIdx < BatchSize; ++moveIdx)
+    {
+      if (m_moves[moveIdx].rescued > bestMove->rescued)
+      {
+        bestMove = &m_moves[moveIdx];
+      }
+    }
+    const int delta = bestMove->rescued - currentRescued;
+    // Draw every step so that the engine advances the same way.
+    const double chance = rng->Uniform();
+    if ((delta >= 0) || (chance < std::exp(delta / temperature)))
+    {
+      current[bestMove->hospitalIdx].position = bestMove->position;
+      currentRescued = bestMove->rescued;
+      if (currentRescued > rescued)
+      {
+        rescued = currentRescued;
+        *hospitals = current;
+      }
+    }
+    temperature *= cooling;
+  }
+  return rescued;
+}
+
+}
+}
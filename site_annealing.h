@@ -0,0 +1,101 @@
+#ifndef _HPS_AMBULANCE_SITE_ANNEALING_H_
+#define _HPS_AMBULANCE_SITE_ANNEALING_H_
+#include "ambulance_core.h"
+#include "greedy.h"
+#include "rand_bound.h"
+#include "deadline.h"
+#include <vector>
+#include <map>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> Move hospitals over the grid by simulated annealing. </summary>
+/// <remarks>
+///   <para> Starting from given hospitals, such as k-means means, each step
+///     draws a batch of neighbors that each move one hospital by a few grid
+///     steps along x or y, staying within the victims' bounding box. The
+///     batch is scored by GreedyRescue in parallel, one workspace per thread,
+///     and its best neighbor is taken when it rescues as many as the current
+///     layout, or otherwise with chance exp(delta / temperature). The
+///     temperature falls geometrically from StartTemperature to
+///     EndTemperature over the steps, so the search ends as hill climbing.
+///   </para>
+///   <para> Scores are cached by the hospital positions in order, which are
+///     all a move changes, so layouts seen again are not rescored. Keying by
+///     the positions rather than a hash keeps two layouts from sharing a
+///     score. Moves are drawn and taken on one thread, so the result depends
+///     only on the engine and not on the number of threads.
+///   </para>
+/// </remarks>
+class SiteAnnealing
+{
+public:
+  enum { BatchSize = 8, };
+  enum { MaxStep = 4, };
+  static const double StartTemperature;
+  static const double EndTemperature;
+
+  SiteAnnealing();
+
+  /// <summary> Move the hospitals to the best layout found. </summary>
+  /// <remarks>
+  ///   <para> Runs the given number of steps or until the deadline expires.
+  ///   </para>
+  /// </remarks>
+  /// <returns> The number of victims rescued greedily. </returns>
+  int Run(const VictimList& victims,
+          const int steps,
+          const Deadline& deadline,
+          RandEngine* rng,
+          HospitalList* hospitals);
+
+  /// <summary> The number of layouts scored by the last run. </summary>
+  inline int Evaluations() const
+  {
+    return m_evaluations;
+  }
+
+private:
+  /// <summary> Hospital x and y coordinates in order. </summary>
+  typedef std::vector<int> LayoutKey;
+
+  /// <summary> One hospital moved to a new place. </summary>
+  struct Move
+  {
+    int hospitalIdx;
+    Point position;
+    LayoutKey key;
+    int rescued;
+  };
+
+  typedef std::map<LayoutKey, int> ScoreCache;
+
+  /// <summary> Make the cache key of a layout from its positions. </summary>
+  static void MakeKey(const HospitalList& hospitals, LayoutKey* key);
+
+  /// <summary> Draw a move of the current layout within the bounds. </summary>
+  void DrawMove(const HospitalList& hospitals, RandEngine* rng, Move* move) const;
+
+  /// <summary> Score the moves missing from the cache in parallel. </summary>
+  void ScoreBatch(const VictimList& victims, const HospitalList& hospitals,
+                  const int numMoves);
+
+  Point m_minCorner;
+  Point m_maxCorner;
+  ScoreCache m_cache;
+  int m_evaluations;
+  std::vector<Move> m_moves;
+  std::vector<int> m_misses;
+  std::vector<GreedyRescue::Workspace> m_workspaces;
+  std::vector<ActionSequenceList> m_actionSequences;
+  std::vector<HospitalList> m_hospitals;
+};
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_SITE_ANNEALING_H_
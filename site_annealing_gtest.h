@@ -0,0 +1,62 @@
+#ifndef _HPS_AMBULANCE_SITE_ANNEALING_GTEST_H_
+#define _HPS_AMBULANCE_SITE_ANNEALING_GTEST_H_
+#include "site_annealing.h"
+#include "evaluation_cache.h"
+#include "data_file.h"
+#include "validate_gtest.h"
+#include "gtest/gtest.h"
+#include <omp.h>
+
+namespace _hps_ambulance_site_annealing_gtest_h_
+{
+using namespace hps;
+
+TEST(RandomHospitals, site_annealing)
+{
+  enum { MaxHospitalCoord = 100, };
+  enum { Steps = 20, };
+
+  VictimList victims;
+  HospitalAmbulanceList hospitalAmbulances;
+  LoadDataFile("ambusamp2010", &victims, &hospitalAmbulances);
+  const int numHospitals = static_cast<int>(hospitalAmbulances.size());
+  RandEngine placeRng(13ULL);
+  HospitalList hospitals;
+  RandomLayout(hospitalAmbulances, MaxHospitalCoord, &placeRng, &hospitals);
+  GreedyRescue::Workspace workspace;
+  ActionSequenceList actionSequences;
+  int startRescued = 0;
+  GreedyRescue::Run(victims, hospitals, &workspace, &actionSequences,
+                    &startRescued);
+  SiteAnnealing annealing;
+  RandEngine rng(14ULL);
+  HospitalList best = hospitals;
+  const int rescued = annealing.Run(victims, Steps, Deadline(), &rng, &best);
+  EXPECT_GE(rescued, startRescued);
+  // Revisited layouts are not scored again.
+  EXPECT_LE(annealing.Evaluations(), 1 + (Steps * SiteAnnealing::BatchSize));
+  // The score is that of the layout given back.
+  int bestRescued = 0;
+  GreedyRescue::Run(victims, best, &workspace, &actionSequences, &bestRescued);
+  EXPECT_EQ(rescued, bestRescued);
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    EXPECT_EQ(hospitals[hospitalIdx].id, best[hospitalIdx].id);
+    EXPECT_EQ(hospitals[hospitalIdx].ambulances, best[hospitalIdx].ambulances);
+  }
+  // The result must not depend on the number of threads.
+  const int numThreads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  RandEngine serialRng(14ULL);
+  HospitalList serialBest = hospitals;
+  const int serialRescued = annealing.Run(victims, Steps, Deadline(),
+                                          &serialRng, &serialBest);
+  omp_set_num_threads(numThreads);
+  EXPECT_EQ(rescued, serialRescued);
+  EXPECT_EQ(EvaluationCache::LayoutHash(best),
+            EvaluationCache::LayoutHash(serialBest));
+}
+
+}
+
+#endif //_HPS_AMBULANCE_SITE_ANNEALING_GTEST_H_
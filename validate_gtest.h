@@ -2,6 +2,8 @@
 #define _HPS_AMBULANCE_VALIDATE_GTEST_H_
 #include "ambulance_core.h"
 #include "process.h"
+#include "rand_bound.h"
+#include "gtest/gtest.h"
 #include <fstream>
 #ifdef WIN32
 #include <time.h>
@@ -101,6 +103,41 @@ bool ValidateAmbulance(const VictimList& victims,
   return valid;
 }
 
+/// <summary> Make a layout of the given hospitals at random places. </summary>
+inline void RandomLayout(const HospitalAmbulanceList& hospitalAmbulances,
+                         const int maxCoord, RandEngine* rng,
+                         HospitalList* hospitals)
+{
+  const int numHospitals = static_cast<int>(hospitalAmbulances.size());
+  hospitals->resize(numHospitals);
+  for (int hospitalIdx = 0; hospitalIdx < numHospitals; ++hospitalIdx)
+  {
+    Hospital& hospital = (*hospitals)[hospitalIdx];
+    hospital.id = hospitalIdx + 1;
+    hospital.position.x = 1 + RandBound(rng, maxCoord);
+    hospital.position.y = 1 + RandBound(rng, maxCoord);
+    hospital.ambulances = hospitalAmbulances[hospitalIdx];
+  }
+}
+
+/// <summary> Expect two sets of routes to match node for node. </summary>
+inline void ExpectSameActionSequences(const ActionSequenceList& expected,
+                                      const ActionSequenceList& actual)
+{
+  ASSERT_EQ(expected.Size(), actual.Size());
+  ASSERT_EQ(expected.NumStops(), actual.NumStops());
+  for (int seqIdx = 0; seqIdx < expected.Size(); ++seqIdx)
+  {
+    const ActionSequence sequence = expected[seqIdx];
+    const ActionSequence actualSequence = actual[seqIdx];
+    ASSERT_EQ(sequence.Size(), actualSequence.Size());
+    for (int nodeIdx = 0; nodeIdx < sequence.Size(); ++nodeIdx)
+    {
+      EXPECT_TRUE(sequence[nodeIdx] == actualSequence[nodeIdx]);
+    }
+  }
+}
+
 }
 
 #endif //_HPS_AMBULANCE_VALIDATE_GTEST_H_
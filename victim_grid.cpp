@@ -0,0 +1,237 @@
+#include "victim_grid.h"
+#include "score_kernels.h"
+#include <math.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+namespace detail
+{
+/// <summary> Gather victims with distances for a k-nearest search. </summary>
+struct GatherVictimDistances
+{
+  GatherVictimDistances(const Point& point_,
+                        std::vector<std::pair<int, int> >* found_)
+    : point(point_),
+      distances(),
+      found(found_)
+  {}
+  inline void operator()(const VictimBlock& block)
+  {
+    distances.resize(block.count);
+    ManhattanDistanceKernel(point, block, &distances[0]);
+    for (int entry = 0; entry < block.count; ++entry)
+    {
+      found->push_back(std::make_pair(distances[entry], block.victimIdx[entry]));
+      std::push_heap(found->begin(), found->end());
+    }
+  }
+  Point point;
+  std::vector<int> distances;
+  std::vector<std::pair<int, int> >* found;
+};
+}
+
+VictimGrid::VictimGrid()
+: m_simVictims(NULL),
+  m_origin(),
+  m_cellSize(1),
+  m_cellsX(0),
+  m_cellsY(0),
+  m_size(0),
+  m_cellStart(),
+  m_cellCount(),
+  m_victimIdx(),
+  m_x(),
+  m_y(),
+  m_timeToLive()
+{}
+
+void VictimGrid::Build(const SimVictimStore& simVictims)
+{
+  m_simVictims = &simVictims;
+  m_size = 0;
+  // Find bounds of the bleeding victims.
+  const int numVictims = simVictims.Size();
+  Point lo(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+  Point hi(std::numeric_limits<int>::min(), std::numeric_limits<int>::min());
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    if (simVictims.IsBleeding(victimIdx))
+    {
+      lo.x = std::min(lo.x, simVictims.x[victimIdx]);
+      lo.y = std::min(lo.y, simVictims.y[victimIdx]);
+      hi.x = std::max(hi.x, simVictims.x[victimIdx]);
+      hi.y = std::max(hi.y, simVictims.y[victimIdx]);
+      ++m_size;
+    }
+  }
+  if (0 == m_size)
+  {
+    m_cellsX = m_cellsY = 0;
+    return;
+  }
+  // Size square cells to hold about TargetVictimsPerCell victims each.
+  const int extent = std::max(hi.x - lo.x, hi.y - lo.y) + 1;
+  const int cellsPerAxis =
+    std::max(1, static_cast<int>(sqrt(static_cast<double>(m_size) /
+                                      TargetVictimsPerCell)));
+  m_origin = lo;
+  m_cellSize = std::max(1, (extent + cellsPerAxis - 1) / cellsPerAxis);
+  m_cellsX = ((hi.x - lo.x) / m_cellSize) + 1;
+  m_cellsY = ((hi.y - lo.y) / m_cellSize) + 1;
+  // Counting sort victims into cells.
+  const int numCells = m_cellsX * m_cellsY;
+  m_cellStart.assign(numCells + 1, 0);
+  m_cellCount.assign(numCells, 0);
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    if (simVictims.IsBleeding(victimIdx))
+    {
+      const int cell = (CellY(simVictims.y[victimIdx]) * m_cellsX) +
+                       CellX(simVictims.x[victimIdx]);
+      ++m_cellStart[cell + 1];
+    }
+  }
+  for (int cell = 0; cell < numCells; ++cell)
+  {
+    m_cellStart[cell + 1] += m_cellStart[cell];
+  }
+  m_victimIdx.resize(m_size);
+  m_x.resize(m_size);
+  m_y.resize(m_size);
+  m_timeToLive.resize(m_size);
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    if (simVictims.IsBleeding(victimIdx))
+    {
+      const int cell = (CellY(simVictims.y[victimIdx]) * m_cellsX) +
+                       CellX(simVictims.x[victimIdx]);
+      const int entry = m_cellStart[cell] + m_cellCount[cell]++;
+      m_victimIdx[entry] = victimIdx;
+      m_x[entry] = simVictims.x[victimIdx];
+      m_y[entry] = simVictims.y[victimIdx];
+      m_timeToLive[entry] = simVictims.timeToLive[victimIdx];
+    }
+  }
+}
+
+void VictimGrid::Remove(const int victimIdx)
+{
+  assert(m_simVictims);
+  if (0 == m_cellsX)
+  {
+    return;
+  }
+  const int cell = (CellY(m_simVictims->y[victimIdx]) * m_cellsX) +
+                   CellX(m_simVictims->x[victimIdx]);
+  const int start = m_cellStart[cell];
+  for (int entry = start; entry < start + m_cellCount[cell]; ++entry)
+  {
+    if (m_victimIdx[entry] == victimIdx)
+    {
+      EraseEntry(cell, entry);
+      return;
+    }
+  }
+}
+
+int VictimGrid::DistanceToCells(const Point& point,
+                                const int cellXLo, const int cellXHi,
+                                const int cellYLo, const int cellYHi) const
+{
+  const int xLo = m_origin.x + (cellXLo * m_cellSize);
+  const int xHi = m_origin.x + ((cellXHi + 1) * m_cellSize) - 1;
+  const int yLo = m_origin.y + (cellYLo * m_cellSize);
+  const int yHi = m_origin.y + ((cellYHi + 1) * m_cellSize) - 1;
+  const int dx = std::max(0, std::max(xLo - point.x, point.x - xHi));
+  const int dy = std::max(0, std::max(yLo - point.y, point.y - yHi));
+  return dx + dy;
+}
+
+int VictimGrid::RingLowerBound(const Point& point, const int ring) const
+{
+  assert(ring >= 0);
+  if (ring > MaxRing(point))
+  {
+    return std::numeric_limits<int>::max();
+  }
+  if (0 == ring)
+  {
+    return DistanceToCells(point, 0, m_cellsX - 1, 0, m_cellsY - 1);
+  }
+  // Cells in this ring or beyond lie in strips outside of the box of the
+  // rings before it.
+  const int centerX = CellX(point.x);
+  const int centerY = CellY(point.y);
+  int lowerBound = std::numeric_limits<int>::max();
+  if (centerX - ring >= 0)
+  {
+    lowerBound = std::min(lowerBound,
+                          DistanceToCells(point, 0, centerX - ring,
+                                          0, m_cellsY - 1));
+  }
+  if (centerX + ring < m_cellsX)
+  {
+    lowerBound = std::min(lowerBound,
+                          DistanceToCells(point, centerX + ring, m_cellsX - 1,
+                                          0, m_cellsY - 1));
+  }
+  if (centerY - ring >= 0)
+  {
+    lowerBound = std::min(lowerBound,
+                          DistanceToCells(point, 0, m_cellsX - 1,
+                                          0, centerY - ring));
+  }
+  if (centerY + ring < m_cellsY)
+  {
+    lowerBound = std::min(lowerBound,
+                          DistanceToCells(point, 0, m_cellsX - 1,
+                                          centerY + ring, m_cellsY - 1));
+  }
+  return lowerBound;
+}
+
+void VictimGrid::KNearest(const Point& point, const int k,
+                          std::vector<int>* nearest)
+{
+  assert(nearest);
+  assert(k >= 0);
+  nearest->clear();
+  if (0 == k)
+  {
+    return;
+  }
+  // Keep a max heap of the k nearest found so far.
+  std::vector<std::pair<int, int> > found;
+  detail::GatherVictimDistances gather(point, &found);
+  const int maxRing = MaxRing(point);
+  for (int ring = 0; ring <= maxRing; ++ring)
+  {
+    VisitRing(point, ring, gather);
+    while (static_cast<int>(found.size()) > k)
+    {
+      std::pop_heap(found.begin(), found.end());
+      found.pop_back();
+    }
+    // Done when nothing further out may be closer.
+    if ((static_cast<int>(found.size()) == k) &&
+        (RingLowerBound(point, ring + 1) >= found.front().first))
+    {
+      break;
+    }
+  }
+  std::sort_heap(found.begin(), found.end());
+  nearest->reserve(found.size());
+  for (std::vector<std::pair<int, int> >::const_iterator record = found.begin();
+       record != found.end();
+       ++record)
+  {
+    nearest->push_back(record->second);
+  }
+}
+
+}
+}
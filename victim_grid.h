@@ -0,0 +1,203 @@
+#ifndef _HPS_AMBULANCE_VICTIM_GRID_H_
+#define _HPS_AMBULANCE_VICTIM_GRID_H_
+#include "ambulance_core.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+namespace hps
+{
+namespace ambulance
+{
+
+/// <summary> A uniform bucket grid over bleeding victim positions. </summary>
+/// <remarks>
+///   <para> Victims are stored as parallel arrays grouped by cell, so each
+///     cell is a VictimBlock for batch scoring. A search walks rings of cells
+///     outward from the cell nearest to a point. Ring r holds the cells whose
+///     Chebyshev cell distance from that cell is r, and RingLowerBound()
+///     gives the least Manhattan distance to any victim in ring r or beyond.
+///     Searches stop once that bound exceeds what they are looking for.
+///   </para>
+///   <para> Victims that are no longer bleeding in the store are dropped from
+///     their cell when a ring visit finds them, so rescues and expirations
+///     need no explicit bookkeeping. Remove() drops a victim eagerly.
+///   </para>
+/// </remarks>
+class VictimGrid
+{
+public:
+  enum { TargetVictimsPerCell = 4, };
+
+  VictimGrid();
+
+  /// <summary> Index the bleeding victims in the store. </summary>
+  /// <remarks>
+  ///   <para> The grid reads statuses from the store until it is rebuilt. </para>
+  /// </remarks>
+  void Build(const SimVictimStore& simVictims);
+
+  /// <summary> Drop a victim from the index. </summary>
+  void Remove(const int victimIdx);
+
+  /// <summary> Number of victims still indexed. </summary>
+  inline int Size() const
+  {
+    return m_size;
+  }
+
+  /// <summary> The last ring around point that holds any cells. </summary>
+  inline int MaxRing(const Point& point) const
+  {
+    if (0 == m_cellsX)
+    {
+      return -1;
+    }
+    const int cellX = CellX(point.x);
+    const int cellY = CellY(point.y);
+    return std::max(std::max(cellX, m_cellsX - 1 - cellX),
+                    std::max(cellY, m_cellsY - 1 - cellY));
+  }
+
+  /// <summary> Least Manhattan distance from point to a victim in the given
+  ///   ring or beyond.
+  /// </summary>
+  int RingLowerBound(const Point& point, const int ring) const;
+
+  /// <summary> Visit the bleeding victims in a ring around point. </summary>
+  /// <remarks>
+  ///   <para> The visitor is called as visitor(const VictimBlock&amp;) once
+  ///     for each cell in the ring that holds victims.
+  ///   </para>
+  /// </remarks>
+  template <typename Visitor>
+  void VisitRing(const Point& point, const int ring, Visitor& visitor);
+
+  /// <summary> Find the k bleeding victims nearest to point, closest first. </summary>
+  void KNearest(const Point& point, const int k, std::vector<int>* nearest);
+
+private:
+  inline int CellX(const int x) const
+  {
+    const int cellX = (x - m_origin.x) / m_cellSize;
+    return std::min(std::max(cellX, 0), m_cellsX - 1);
+  }
+
+  inline int CellY(const int y) const
+  {
+    const int cellY = (y - m_origin.y) / m_cellSize;
+    return std::min(std::max(cellY, 0), m_cellsY - 1);
+  }
+
+  /// <summary> Manhattan distance from point to a block of cells. </summary>
+  int DistanceToCells(const Point& point,
+                      const int cellXLo, const int cellXHi,
+                      const int cellYLo, const int cellYHi) const;
+
+  /// <summary> Move the last entry of a cell into the given slot. </summary>
+  inline void EraseEntry(const int cell, const int entry)
+  {
+    const int last = m_cellStart[cell] + --m_cellCount[cell];
+    m_victimIdx[entry] = m_victimIdx[last];
+    m_x[entry] = m_x[last];
+    m_y[entry] = m_y[last];
+    m_timeToLive[entry] = m_timeToLive[last];
+    --m_size;
+  }
+
+  /// <summary> Visit one cell, dropping victims that are not bleeding. </summary>
+  template <typename Visitor>
+  inline void VisitCell(const int cellX, const int cellY, Visitor& visitor)
+  {
+    const int cell = (cellY * m_cellsX) + cellX;
+    const int start = m_cellStart[cell];
+    for (int entry = start; entry < start + m_cellCount[cell];)
+    {
+      if (!m_simVictims->IsBleeding(m_victimIdx[entry]))
+      {
+        EraseEntry(cell, entry);
+      }
+      else
+      {
+        ++entry;
+      }
+    }
+    if (m_cellCount[cell] > 0)
+    {
+      VictimBlock block;
+      block.x = &m_x[start];
+      block.y = &m_y[start];
+      block.timeToLive = &m_timeToLive[start];
+      block.victimIdx = &m_victimIdx[start];
+      block.count = m_cellCount[cell];
+      visitor(block);
+    }
+  }
+
+  const SimVictimStore* m_simVictims;
+  Point m_origin;
+  int m_cellSize;
+  int m_cellsX;
+  int m_cellsY;
+  int m_size;
+  std::vector<int> m_cellStart;
+  std::vector<int> m_cellCount;
+  std::vector<int> m_victimIdx;
+  std::vector<int> m_x;
+  std::vector<int> m_y;
+  std::vector<int> m_timeToLive;
+};
+
+template <typename Visitor>
+void VictimGrid::VisitRing(const Point& point, const int ring, Visitor& visitor)
+{
+  assert(ring >= 0);
+  if (0 == m_cellsX)
+  {
+    return;
+  }
+  const int centerX = CellX(point.x);
+  const int centerY = CellY(point.y);
+  if (0 == ring)
+  {
+    VisitCell(centerX, centerY, visitor);
+    return;
+  }
+  const int xLo = std::max(centerX - ring, 0);
+  const int xHi = std::min(centerX + ring, m_cellsX - 1);
+  // Bottom and top rows.
+  const int rowYs[] = { centerY - ring, centerY + ring, };
+  for (int rowIdx = 0; rowIdx < 2; ++rowIdx)
+  {
+    const int cellY = rowYs[rowIdx];
+    if ((cellY >= 0) && (cellY < m_cellsY))
+    {
+      for (int cellX = xLo; cellX <= xHi; ++cellX)
+      {
+        VisitCell(cellX, cellY, visitor);
+      }
+    }
+  }
+  // Left and right columns without the corners.
+  const int yLo = std::max(centerY - ring + 1, 0);
+  const int yHi = std::min(centerY + ring - 1, m_cellsY - 1);
+  const int colXs[] = { centerX - ring, centerX + ring, };
+  for (int colIdx = 0; colIdx < 2; ++colIdx)
+  {
+    const int cellX = colXs[colIdx];
+    if ((cellX >= 0) && (cellX < m_cellsX))
+    {
+      for (int cellY = yLo; cellY <= yHi; ++cellY)
+      {
+        VisitCell(cellX, cellY, visitor);
+      }
+    }
+  }
+}
+
+}
+using namespace ambulance;
+}
+
+#endif //_HPS_AMBULANCE_VICTIM_GRID_H_
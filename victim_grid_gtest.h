@@ -0,0 +1,135 @@
+#ifndef _HPS_AMBULANCE_VICTIM_GRID_GTEST_H_
+#define _HPS_AMBULANCE_VICTIM_GRID_GTEST_H_
+#include "victim_grid.h"
+#include "rand_bound.h"
+#include "gtest/gtest.h"
+#include <vector>
+#include <algorithm>
+
+namespace _hps_ambulance_victim_grid_gtest_h_
+{
+using namespace hps;
+
+/// <summary> Make a store of random bleeding victims. </summary>
+void MakeRandomSimVictims(const int numVictims, const int maxCoord,
+                          RandEngine* rng, SimVictimStore* simVictims)
+{
+  VictimList victims(numVictims);
+  for (int victimIdx = 0; victimIdx < numVictims; ++victimIdx)
+  {
+    victims[victimIdx].position = Point(rng->Bound(maxCoord),
+                                        rng->Bound(maxCoord));
+    victims[victimIdx].timeToLive = 1 + rng->Bound(maxCoord);
+  }
+  simVictims->Assign(victims);
+}
+
+/// <summary> Order victims by distance from a point, then by index. </summary>
+struct DistanceOrder
+{
+  DistanceOrder(const SimVictimStore& simVictims_, const Point& point_)
+    : simVictims(&simVictims_),
+      point(point_)
+  {}
+  inline bool operator()(const int lhs, const int rhs) const
+  {
+    const int lhsDist = ManhattanDistance(point, simVictims->Position(lhs));
+    const int rhsDist = ManhattanDistance(point, simVictims->Position(rhs));
+    return (lhsDist < rhsDist) || ((lhsDist == rhsDist) && (lhs < rhs));
+  }
+  const SimVictimStore* simVictims;
+  Point point;
+};
+
+TEST(KNearest, VictimGrid)
+{
+  enum { NumVictims = 2000, };
+  enum { MaxCoord = 300, };
+  enum { NumQueries = 50, };
+  enum { K = 10, };
+  RandEngine rng(7ULL);
+  SimVictimStore simVictims;
+  MakeRandomSimVictims(NumVictims, MaxCoord, &rng, &simVictims);
+  VictimGrid grid;
+  grid.Build(simVictims);
+  ASSERT_EQ(static_cast<int>(NumVictims), grid.Size());
+  std::vector<int> nearest;
+  for (int query = 0; query < NumQueries; ++query)
+  {
+    // Queries may fall outside of the victims' bounds.
+    const Point point(rng.Bound(2 * MaxCoord) - (MaxCoord / 2),
+                      rng.Bound(2 * MaxCoord) - (MaxCoord / 2));
+    // Rescue some victims so that the grid drops them.
+    for (int rescue = 0; rescue < 10; ++rescue)
+    {
+      simVictims.status[rng.Bound(NumVictims)] = SimVictim::Status_Rescued;
+    }
+    // Expire one victim and remove it eagerly.
+    {
+      const int victimIdx = rng.Bound(NumVictims);
+      simVictims.status[victimIdx] = SimVictim::Status_Expired;
+      grid.Remove(victimIdx);
+    }
+    grid.KNearest(point, K, &nearest);
+    ASSERT_EQ(static_cast<int>(K), static_cast<int>(nearest.size()));
+    // Compare distances against a brute force search.
+    std::vector<int> expected;
+    for (int victimIdx = 0; victimIdx < simVictims.Size(); ++victimIdx)
+    {
+      if (simVictims.IsBleeding(victimIdx))
+      {
+        expected.push_back(victimIdx);
+      }
+    }
+    std::partial_sort(expected.begin(), expected.begin() + K, expected.end(),
+                      DistanceOrder(simVictims, point));
+    for (int rank = 0; rank < K; ++rank)
+    {
+      EXPECT_TRUE(simVictims.IsBleeding(nearest[rank]));
+      EXPECT_EQ(ManhattanDistance(point, simVictims.Position(expected[rank])),
+                ManhattanDistance(point, simVictims.Position(nearest[rank])));
+    }
+  }
+}
+
+TEST(RingLowerBound, VictimGrid)
+{
+  enum { NumVictims = 500, };
+  enum { MaxCoord = 100, };
+  RandEngine rng(11ULL);
+  SimVictimStore simVictims;
+  MakeRandomSimVictims(NumVictims, MaxCoord, &rng, &simVictims);
+  VictimGrid grid;
+  grid.Build(simVictims);
+  // Every victim visited in a ring must be at least as far as the bound.
+  struct CheckBound
+  {
+    inline void operator()(const VictimBlock& block)
+    {
+      for (int entry = 0; entry < block.count; ++entry)
+      {
+        EXPECT_LE(bound, ManhattanDistance(point, Point(block.x[entry],
+                                                        block.y[entry])));
+        ++visited;
+      }
+    }
+    Point point;
+    int bound;
+    int visited;
+  };
+  const Point point(MaxCoord / 3, MaxCoord + 10);
+  CheckBound checkBound;
+  checkBound.point = point;
+  checkBound.visited = 0;
+  const int maxRing = grid.MaxRing(point);
+  for (int ring = 0; ring <= maxRing; ++ring)
+  {
+    checkBound.bound = grid.RingLowerBound(point, ring);
+    grid.VisitRing(point, ring, checkBound);
+  }
+  EXPECT_EQ(static_cast<int>(NumVictims), checkBound.visited);
+}
+
+}
+
+#endif //_HPS_AMBULANCE_VICTIM_GRID_GTEST_H_